@@ -0,0 +1,67 @@
+#pragma once
+#include "http_client.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Non-blocking HTTP client on curl's multi interface. Each loop thread owns
+// one multi handle and drives all of its transfers from a single poll, so
+// thousands of requests can be in flight without a thread per request.
+// Requests are spread round-robin over the loops. With HTTP/2 enabled, the
+// requests of a loop that go to the same origin share its connections as
+// concurrent streams.
+//
+// Callbacks (and posted tasks) run on a loop thread and hold it up while
+// they run, so they should only do short work or hand off.
+class AsyncHttpClient {
+public:
+    using Callback = std::function<void(HttpResponse&&)>;
+
+    explicit AsyncHttpClient(size_t loop_count = 1, const HttpOptions& options = {});
+    // Stops the loops; transfers still running complete with an error
+    ~AsyncHttpClient();
+
+    AsyncHttpClient(const AsyncHttpClient&) = delete;
+    AsyncHttpClient& operator=(const AsyncHttpClient&) = delete;
+
+    // The transfer aborts as soon as *cancel_flag becomes true
+    void submit(HttpRequest request, Callback callback, const std::atomic<bool>* cancel_flag = nullptr);
+    std::future<HttpResponse> submit(HttpRequest request, const std::atomic<bool>* cancel_flag = nullptr);
+
+    // Runs a task on a loop thread after the delay; used for timers (delays,
+    // scheduled iterations) and to continue work without deepening the stack
+    void post(std::function<void()> task, std::chrono::milliseconds delay = std::chrono::milliseconds(0));
+
+    // Replaces request with that of a finished transfer, most recent first,
+    // so the caller renders its next request into strings that already
+    // have their capacity. Leaves request as it is when none is left.
+    void reuseRequest(HttpRequest& request);
+
+    size_t inFlight() const { return in_flight.load(std::memory_order_relaxed); }
+    const HttpOptions& options() const { return http_options; }
+
+private:
+    class Loop;
+
+    // Requests of finished transfers, handed back by reuseRequest
+    struct SpareRequests {
+        static constexpr size_t MAX_SPARE = 256;
+        std::mutex mutex;
+        std::vector<HttpRequest> requests;
+    };
+
+    HttpOptions http_options;
+    HttpVersionPolicy versions;
+    SpareRequests spares;
+    std::vector<std::unique_ptr<Loop>> loops;
+    std::atomic<size_t> next_loop{0};
+    std::atomic<size_t> in_flight{0};
+    // Set while shutting down; new work is refused instead of queued
+    std::atomic<bool> closed{false};
+
+    Loop& pickLoop();
+};
@@ -0,0 +1,91 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Immutable, reference-counted payload. Copying a BodyBuffer copies a
+// pointer, so a response body travels from the transfer to the context, to
+// forked branches and into variables without its bytes being duplicated.
+// The bytes never change once wrapped, which is what makes sharing them
+// between threads safe. They live either in memory or in a read-only
+// mapping of a spooled temp file; readers cannot tell the difference.
+class BodyBuffer {
+public:
+    BodyBuffer() = default;
+    explicit BodyBuffer(std::string bytes);
+
+    std::string_view view() const { return std::string_view(bytes, length); }
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    // Backed by a file mapping rather than heap memory
+    bool isMapped() const { return mapped; }
+    // Expires once no copy or slice of these bytes is left
+    std::weak_ptr<const void> lifetime() const { return owner; }
+    // Owned copy, for the few places that really need a std::string
+    std::string str() const { return std::string(bytes, length); }
+
+    // Shares the bytes of part, which must lie inside view()
+    BodyBuffer slice(std::string_view part) const {
+        BodyBuffer result(*this);
+        result.bytes = part.data();
+        result.length = part.size();
+        return result;
+    }
+
+    // Drops this reference; other holders keep the bytes
+    void clear() { *this = BodyBuffer(); }
+
+    // At most max_length bytes, with "..." appended when cut; for log lines
+    std::string preview(size_t max_length) const {
+        if (length <= max_length) return str();
+        return std::string(bytes, max_length) + "...";
+    }
+
+private:
+    friend class BodyBuilder;
+
+    // Keeps the string or the mapping alive; bytes points into it
+    std::shared_ptr<const void> owner;
+    const char* bytes = "";
+    size_t length = 0;
+    bool mapped = false;
+};
+
+// Accumulates a body while it is received and seals it into a BodyBuffer.
+// Bodies that grow past the spool threshold move to an unlinked temp file
+// and are mapped read-only by finish(), so memory stays bounded however
+// large a response gets. Not thread-safe; one per transfer.
+class BodyBuilder {
+public:
+    // Upper bound for reserve(): a bogus Content-Length must not be able to
+    // allocate gigabytes up front; bigger bodies still grow as they arrive
+    static constexpr size_t MAX_RESERVE = 64 * 1024 * 1024;
+
+    BodyBuilder() = default;
+    BodyBuilder(const BodyBuilder&) = delete;
+    BodyBuilder& operator=(const BodyBuilder&) = delete;
+    ~BodyBuilder();
+
+    // 0 keeps every body in memory
+    void setSpoolThreshold(size_t threshold) { spool_threshold = threshold; }
+
+    void reserve(size_t expected);
+    // False when the spool file could not be written
+    bool append(const char* data, size_t length);
+    void clear();
+
+    // Seals the body into body. False when a spooled body could neither be
+    // mapped nor read back; body is then empty and must not be used.
+    bool finish(BodyBuffer& body);
+
+private:
+    std::string bytes;
+    size_t spool_threshold = 0;
+    // Spool file once the body went over the threshold
+    int fd = -1;
+    size_t spooled = 0;
+
+    bool spool();
+    bool readBack(BodyBuffer& body);
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <curl/curl.h>
+#include <mutex>
+
+// Process-wide curl state. The first call to instance() runs
+// curl_global_init, before any handle exists and exactly once; the matching
+// cleanup runs at exit. It also owns a share handle that every easy handle
+// is attached to, so DNS answers and TLS sessions learned by one client or
+// thread are reused by all of them.
+//
+// Connections are not shared: libcurl does not support using one
+// connection cache from concurrently running threads. They are reused
+// across workers by passing idle easy handles around (HttpClient) and
+// within each multi handle (AsyncHttpClient).
+class CurlShare {
+public:
+    static CurlShare& instance();
+
+    CurlShare(const CurlShare&) = delete;
+    CurlShare& operator=(const CurlShare&) = delete;
+
+    // Must be called again after curl_easy_reset, which detaches the handle
+    void attach(CURL* curl) const;
+
+private:
+    CurlShare();
+    ~CurlShare();
+
+    CURLSH* share = nullptr;
+    std::mutex locks[CURL_LOCK_DATA_LAST];
+
+    static void lock(CURL* curl, curl_lock_data data, curl_lock_access access, void* user);
+    static void unlock(CURL* curl, curl_lock_data data, void* user);
+};
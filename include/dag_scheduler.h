@@ -0,0 +1,83 @@
+#pragma once
+#include "executor.h"
+#include "execution_plan.h"
+#include <functional>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+
+class ThreadPool;
+
+// Optional callbacks fired from pool threads as nodes start and finish
+struct DagHooks {
+    std::function<void(const Node&)> on_node_started;
+    std::function<void(const Node&, bool)> on_node_finished;
+};
+
+// Runs a compiled plan as a dependency graph: every link is an edge, a node
+// becomes ready once all of its (reachable) inputs have finished, and ready
+// nodes run concurrently on the pool. Independent branches after a fan-out
+// therefore overlap, and a node with several inputs acts as a join. After
+// an If or Assert node only the links from the output it took are
+// followed; nodes left without any followed input are skipped.
+class DagScheduler {
+public:
+    explicit DagScheduler(ThreadPool& pool) : pool(pool) {}
+
+    // Blocks until every node reachable from Start has run or been skipped,
+    // a node failed or the run was cancelled. Returns true only if
+    // everything succeeded.
+    bool run(const ExecutionPlan& plan, ExecutionContext& context, const DagHooks& hooks = {});
+
+private:
+    ThreadPool& pool;
+};
+
+// Runs a plan on the calling thread, one node at a time in topological order.
+// Used where the caller already provides the concurrency, e.g. one instance
+// per load-test virtual user. Each node sees the response of the input that
+// finished last, like a join in DagScheduler. Scratch buffers are kept
+// between runs, so an instance must not be shared between threads.
+class InlineScheduler {
+public:
+    bool run(const ExecutionPlan& plan, ExecutionContext& context);
+
+    // Same order and semantics as run(), but each node goes through
+    // Node::executeAsync, so a node waiting on I/O does not hold a thread.
+    // Returns right away; done is called exactly once, possibly on another
+    // thread. The scheduler, plan and context must outlive the run.
+    void runAsync(const ExecutionPlan& plan, ExecutionContext& context, std::function<void(bool)> done);
+
+private:
+    struct Output {
+        BodyBuffer body;
+        std::shared_ptr<const JsonStreamResult> streamed;
+        int status_code = 0;
+    };
+
+    std::vector<uint32_t> input_of;
+    std::vector<Output> outputs;
+
+    // Walk state, shared by run() and runAsync()
+    const ExecutionPlan* plan = nullptr;
+    ExecutionContext* context = nullptr;
+    size_t position = 0;
+    // Node whose output currently sits in the context
+    uint32_t current = 0;
+
+    // runAsync() only
+    enum Phase { Dispatching, Waiting, Completed };
+    std::function<void(bool)> done;
+    std::atomic<int> phase{Waiting};
+    bool node_result = false;
+    std::chrono::steady_clock::time_point node_started;
+
+    bool begin(const ExecutionPlan& plan, ExecutionContext& context);
+    void skipUntaken();
+    void restoreInput(uint32_t index);
+    void advance(uint32_t index);
+    void step();
+    bool completeNode();
+    void finish(bool success);
+};
@@ -22,14 +22,23 @@ struct LinkData {
     int end_attr;
 };
 
+// Key of a nodes or links row; ids are only unique within an orchestration
+struct RowKey {
+    int id;
+    int orchestration_id;
+};
+
 class Database {
 public:
     Database();
     ~Database();
 
-    bool initialize(const std::string& db_path = "untangle.db");
+    // Without create, fails when db_path does not exist yet
+    bool initialize(const std::string& db_path = "untangle.db", bool create = true);
     void close();
 
+    // Each writes the changes recorded since the last save; saveAll then
+    // marks them saved once the transaction commits
     bool saveProjects(ProjectManager& project_manager);
     bool saveNodes(NodeEditor& node_editor);
     bool saveLinks(NodeEditor& node_editor);
@@ -45,5 +54,11 @@ private:
     sqlite3* db = nullptr;
     bool createTables();
     
-    bool clearTable(const std::string& table_name);
+    // Schema version, kept in PRAGMA user_version
+    int schemaVersion();
+    bool tableExists(const char* table_name);
+    bool execute(const char* sql, const char* action);
+    bool prepare(const char* sql, sqlite3_stmt** stmt);
+    // Steps a write statement and resets it for the next row
+    bool step(sqlite3_stmt* stmt, const char* action);
 };
@@ -0,0 +1,116 @@
+#pragma once
+#include "executor.h"
+#include "thread_pool.h"
+#include "dag_scheduler.h"
+#include "execution_plan.h"
+#include "load_runner.h"
+#include "latency_histogram.h"
+#include <string>
+#include <memory>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+class Terminal;
+class AsyncHttpClient;
+
+enum class RunState {
+    Idle,
+    Running,
+    Succeeded,
+    Failed,
+    Cancelled
+};
+
+const char* runStateName(RunState state);
+
+// What the UI polls every frame to draw progress of the current/last run
+struct RunStatus {
+    int run_id = 0;
+    int orchestration_id = -1;
+    RunState state = RunState::Idle;
+    int current_node_id = -1;
+    int nodes_running = 0;
+    int nodes_executed = 0;
+    double elapsed_ms = 0.0;
+    bool load_test = false;
+    LoadTestStats load_stats;
+};
+
+struct RunRequest {
+    std::shared_ptr<const ExecutionPlan> plan;
+    // When set, only this node is executed instead of walking from Start
+    int single_node_id = -1;
+    // When set, the plan is run repeatedly by concurrent virtual users
+    bool load_test = false;
+    LoadTestConfig load_config;
+    Terminal* terminal = nullptr;
+};
+
+// Owns the execution thread. Runs are queued from the UI thread and executed
+// one at a time; progress is streamed to the terminal and to getStatus().
+// Within a run, independent branches are spread over the worker pool.
+class ExecutionEngine {
+public:
+    ExecutionEngine();
+    ~ExecutionEngine();
+
+    void start();
+    void stop();
+
+    int submit(RunRequest request);
+    // Cancels the running run and drops everything still queued
+    void cancel();
+
+    bool isBusy() const;
+    RunStatus getStatus() const;
+    // Blocks until the given run has finished or was dropped from the queue,
+    // or the timeout expires. Returns false on timeout.
+    bool waitForRun(int run_id, std::chrono::milliseconds timeout);
+    std::string getExecutionLog() const { return context.getLog(); }
+    // Takes effect from the next run on
+    void setHttpOptions(const HttpOptions& options);
+    HttpOptions getHttpOptions() const;
+    // Latency accumulated over every run of the orchestration so far
+    std::vector<NodeLatency> getNodeLatency(int orchestration_id) const { return latency.nodeSummaries(orchestration_id); }
+    LatencySummary getOrchestrationLatency(int orchestration_id) const { return latency.orchestrationSummary(orchestration_id); }
+
+private:
+    std::thread worker;
+    mutable std::mutex mutex;
+    std::condition_variable queue_cv;
+    std::condition_variable done_cv;
+    std::deque<std::pair<int, RunRequest>> queue;
+    bool stopping = false;
+    int next_run_id = 1;
+
+    RunStatus status;
+    std::atomic<bool> cancel_requested{false};
+
+    HttpClient http_client;
+    HttpOptions http_options;
+    // Options of the run in progress; worker thread only
+    HttpOptions active_http;
+    // Only exists while HTTP/2 is enabled: runs then send through it so
+    // parallel branches multiplex over shared connections
+    std::unique_ptr<AsyncHttpClient> async_http;
+    // Root context of the current run; branches fork from it
+    ExecutionContext context;
+
+    ThreadPool pool;
+    DagScheduler scheduler;
+    LatencyRegistry latency;
+
+    void workerLoop();
+    void applyHttpOptions(const HttpOptions& options);
+    bool runOrchestration(const ExecutionPlan& plan);
+    bool runSingleNode(const ExecutionPlan& plan, int node_id);
+    bool runLoadTest(const std::shared_ptr<const ExecutionPlan>& plan, const LoadTestConfig& config);
+    void nodeStarted(const Node& node);
+    void nodeFinished(const Node& node, bool success);
+    void report(const std::string& message);
+    void reportLatency(int orchestration_id);
+};
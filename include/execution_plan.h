@@ -0,0 +1,63 @@
+#pragma once
+#include "link.h"
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+
+class Node;
+
+// Orchestration compiled into flat arrays for the scheduler. Nodes are
+// detached clones owned by the plan, so a plan is immutable once built and
+// can be shared by any number of concurrent runs. The editor caches it per
+// orchestration and only recompiles after nodes, links or node data change.
+class ExecutionPlan {
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    static std::shared_ptr<const ExecutionPlan> compile(int orchestration_id,
+                                                        const std::vector<std::unique_ptr<Node>>& nodes,
+                                                        const std::vector<std::unique_ptr<Link>>& links);
+
+    int getOrchestrationId() const { return orchestration_id; }
+    size_t nodeCount() const { return nodes.size(); }
+    Node* node(uint32_t index) const { return nodes[index].get(); }
+    uint32_t findNode(int node_id) const;
+
+    // Index of the node owning a pin, or npos
+    uint32_t nodeForPin(int pin) const;
+
+    uint32_t startIndex() const { return start_index; }
+    const uint32_t* successorsBegin(uint32_t index) const { return successors.data() + successor_offsets[index]; }
+    const uint32_t* successorsEnd(uint32_t index) const { return successors.data() + successor_offsets[index + 1]; }
+    // Output pin each successor link leaves from, parallel to the successors
+    const int* successorPins(uint32_t index) const { return successor_pins.data() + successor_offsets[index]; }
+    // Number of inputs a node waits for (edges from nodes reachable from Start)
+    int32_t initialPending(uint32_t index) const { return initial_pending[index]; }
+
+    // Nodes reachable from Start in dependency order
+    const std::vector<uint32_t>& topologicalOrder() const { return topo_order; }
+    size_t reachableCount() const { return reachable_count; }
+    // Reachable nodes that sit on a cycle and can therefore never run
+    size_t blockedCount() const { return reachable_count - topo_order.size(); }
+
+private:
+    int orchestration_id = -1;
+    std::vector<std::unique_ptr<Node>> nodes;
+
+    // Pins are node id + small offset, so a dense table indexed by
+    // (pin - pin_base) is used; very sparse ids fall back to a hash map
+    int pin_base = 0;
+    std::vector<uint32_t> pin_table;
+    std::unordered_map<int, uint32_t> sparse_pins;
+
+    // Successors in CSR form: successors[successor_offsets[i] .. successor_offsets[i + 1])
+    std::vector<uint32_t> successor_offsets;
+    std::vector<uint32_t> successors;
+    std::vector<int> successor_pins;
+    std::vector<int32_t> initial_pending;
+
+    std::vector<uint32_t> topo_order;
+    uint32_t start_index = npos;
+    size_t reachable_count = 0;
+};
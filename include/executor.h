@@ -1,24 +1,109 @@
 #pragma once
 #include "http_client.h"
+#include "variables.h"
 #include <string>
-#include <map>
-#include <any>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
 
 class Node;
 class Terminal;
+class AsyncHttpClient;
+class JsonIndex;
+struct PlanLatency;
+
+// Compile-time verbosity of execution logs. Messages above the configured
+// level are compiled out, including building their strings:
+// 0 = errors only, 1 = requests, results and LOG nodes, 2 = every node and bodies
+#ifndef UNTANGLE_TRACE_LEVEL
+#define UNTANGLE_TRACE_LEVEL 1
+#endif
+
+#define TRACE_ERROR 0
+#define TRACE_INFO 1
+#define TRACE_DEBUG 2
+
+#define EXEC_TRACE(context, level, message) \
+    do { if constexpr ((level) <= UNTANGLE_TRACE_LEVEL) { (context).log(message); } } while (0)
 
 struct ExecutionContext {
-    std::map<std::string, std::any> variables;
-    HttpClient http_client;
-    std::string last_response_body;
+    HttpClient* http_client = nullptr;
+    // When set, nodes run through executeAsync() do their I/O on this client
+    AsyncHttpClient* async_http = nullptr;
+    // Shared with the response and any variable it was stored in
+    BodyBuffer last_response_body;
+    // Set instead of the body when the last response was streamed: what
+    // the paths of the JSON extract nodes reading it selected
+    std::shared_ptr<const JsonStreamResult> streamed_values;
     int last_status_code = 0;
+    // Timings of the last HTTP request on this branch
+    HttpTimings last_timings;
+    // Output pin a branching node (If, Assert) took; schedulers skip the
+    // links leaving from its other outputs. -1 while every output fires.
+    int taken_output = -1;
     std::string execution_log;
     Terminal* terminal = nullptr;
-    
-    void setVariable(const std::string& name, const std::any& value);
-    std::any getVariable(const std::string& name);
+    const std::atomic<bool>* cancel_flag = nullptr;
+    // Load-test users run muted; only aggregate counters are reported
+    bool log_enabled = true;
+    // Per-node latency histograms of the plan being run, if any
+    const PlanLatency* latency = nullptr;
+
+    // HTTP requests issued through this context (and its forks)
+    std::atomic<long long> requests_sent{0};
+    std::atomic<long long> requests_failed{0};
+
+    ExecutionContext() = default;
+    ExecutionContext(const ExecutionContext&) = delete;
+    ExecutionContext& operator=(const ExecutionContext&) = delete;
+
+    // Branch context for a parallel path: it carries its own copy of the last
+    // response, while variables and the log stay shared with the root context
+    std::unique_ptr<ExecutionContext> fork();
+
+    // Variables by slot (see VariableNames); an unset one reads as
+    // std::monostate. Copying a value out never copies text.
+    void setVariable(uint32_t slot, VariableValue value);
+    VariableValue getVariable(uint32_t slot);
+    bool hasVariable(uint32_t slot);
+    // By name, for callers that did not resolve a slot
+    void setVariable(const std::string& name, VariableValue value);
+    VariableValue getVariable(const std::string& name);
     bool hasVariable(const std::string& name);
+    // Unsets every variable but keeps the storage for the next run
+    void clearVariables();
+    // A request counts as failed on transport errors and on 4xx/5xx
+    void recordRequest(bool success);
+    // Structural index of body, shared by every node of the run (and its
+    // branches) that reads the same response. Null for bodies too small to
+    // be worth indexing; those are scanned directly.
+    std::shared_ptr<const JsonIndex> jsonIndex(const BodyBuffer& body);
     void log(const std::string& message);
+    std::string getLog() const;
+    void clearLog();
+    bool isCancelled() const { return cancel_flag && cancel_flag->load(std::memory_order_relaxed); }
+
+private:
+    ExecutionContext* root = nullptr;
+    // Indexed by slot; grows to the highest slot set so far
+    std::vector<VariableValue> variables;
+    mutable std::mutex variables_mutex;
+    mutable std::mutex log_mutex;
+
+    // Keyed by the body's bytes and lifetime; an entry goes away once its
+    // response is no longer held anywhere in the run
+    struct CachedIndex {
+        const char* bytes;
+        size_t length;
+        std::weak_ptr<const void> lifetime;
+        std::shared_ptr<const JsonIndex> index;
+    };
+    std::vector<CachedIndex> json_indexes;
+    std::mutex json_index_mutex;
+
+    ExecutionContext& scope() { return root ? *root : *this; }
+    const ExecutionContext& scope() const { return root ? *root : *this; }
 };
 
 class NodeExecutor {
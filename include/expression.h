@@ -0,0 +1,103 @@
+#pragma once
+#include "json_path.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct ExecutionContext;
+
+// Condition of an If or Assert node, compiled once into a postfix program so
+// that executions only run it on a small value stack and never re-parse the
+// text.
+//
+//   status_code == 200  $.data.id != null && response_time_ms < 500
+//   contains(body, 'ok')  $.total - $.used >= 10  user_id == '17'
+//   count($.users[*]) > 0  !(status_code >= 400) || retries < 3
+//
+// Operands are numbers, 'strings' or "strings", true, false, null, JSON
+// paths into the last response ($...), the built-ins status_code, body and
+// response_time_ms, and any other name as a variable (null while unset).
+// Operators, loosest first: || or, && and, == !=, < <= > >=, + -, * / %,
+// and the unary ! not -. A numeric string compares and calculates as its
+// number; + concatenates two strings, or a non-numeric string and a value.
+// Functions: len, contains, starts_with, ends_with, lower, upper, num, str,
+// exists, and count(path) for the number of values a path selects.
+class Expression {
+public:
+    enum class Op {
+        Constant,      // constants()[operand]
+        Variable,      // names()[operand]
+        Path,          // paths()[operand]; null when nothing matches
+        PathCount,     // paths()[operand]
+        StatusCode, Body, ResponseTime,
+        Not, Negate, Truth,
+        Add, Subtract, Multiply, Divide, Modulo,
+        Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual,
+        // Short circuit: when the top of the stack decides, it becomes the
+        // result and execution jumps to operand; otherwise it is popped
+        And, Or,
+        Length, Contains, StartsWith, EndsWith, Lower, Upper, ToNumber, ToString
+    };
+
+    struct Instruction {
+        Op op;
+        int operand = -1;
+    };
+
+    struct Value {
+        enum class Type { Null, Bool, Number, String };
+        Type type = Type::Null;
+        bool boolean = false;
+        double number = 0;
+        // Bytes of a constant, the response or a buffer of the evaluation
+        std::string_view text;
+    };
+
+    struct Constant {
+        Value::Type type = Value::Type::Null;
+        bool boolean = false;
+        double number = 0;
+        std::string text;
+    };
+
+    // Deepest stack a program may need
+    static constexpr int MAX_DEPTH = 32;
+
+    // On failure the expression is left empty and error says what was wrong
+    bool compile(const std::string& text, std::string& error);
+
+    const std::string& getText() const { return text; }
+    const std::vector<Instruction>& program() const { return code; }
+    const std::vector<Constant>& constants() const { return constant_values; }
+    const std::vector<std::string>& names() const { return variable_names; }
+    // Slots of names(), once resolved
+    const std::vector<uint32_t>& slots() const { return variable_slots; }
+    const std::vector<std::shared_ptr<const JsonPath>>& paths() const { return json_paths; }
+
+    // Resolves the variable names to slots (see VariableNames); until then
+    // each evaluation looks them up by name
+    void resolveVariables();
+
+    // Evaluates against the last response and the variables of context;
+    // true when the result is truthy (not null, false, 0 or "")
+    bool test(ExecutionContext& context) const;
+    // Result as text, e.g. for logs: strings as they are, null as "null"
+    std::string evaluateToString(ExecutionContext& context) const;
+
+    // Scratch state of one evaluation
+    struct Evaluation;
+
+private:
+    std::string text;
+    std::vector<Instruction> code;
+    std::vector<Constant> constant_values;
+    std::vector<std::string> variable_names;
+    std::vector<uint32_t> variable_slots;
+    std::vector<std::shared_ptr<const JsonPath>> json_paths;
+
+    Value evaluate(Evaluation& evaluation) const;
+
+    friend class ExpressionParser;
+};
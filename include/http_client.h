@@ -1,14 +1,202 @@
 #pragma once
+#include "body_buffer.h"
+#include "json_scanner.h"
+#include <curl/curl.h>
 #include <string>
 #include <map>
+#include <memory>
+#include <set>
+#include <vector>
+#include <mutex>
 #include <functional>
+#include <atomic>
+
+// Transfer timings as reported by libcurl, in microseconds since the request
+// started (so each one includes the phases before it)
+struct HttpTimings {
+    long long name_lookup_us = 0;
+    long long connect_us = 0;
+    // TLS handshake done; 0 for plain HTTP
+    long long app_connect_us = 0;
+    long long pre_transfer_us = 0;
+    // First response byte received
+    long long start_transfer_us = 0;
+    long long total_us = 0;
+
+    long long bytes_sent = 0;
+    // On the wire: headers plus the body as sent, i.e. still compressed
+    long long bytes_received = 0;
+    // Body after content decoding; equals the wire body when uncompressed
+    long long bytes_decoded = 0;
+    bool connection_reused = false;
+    // Response came back over HTTP/2
+    bool http2 = false;
+
+    // Durations of the individual phases
+    long long dnsUs() const { return name_lookup_us; }
+    long long connectUs() const { return connect_us > name_lookup_us ? connect_us - name_lookup_us : 0; }
+    long long tlsUs() const { return app_connect_us > connect_us ? app_connect_us - connect_us : 0; }
+    long long serverUs() const { return start_transfer_us > pre_transfer_us ? start_transfer_us - pre_transfer_us : 0; }
+    long long transferUs() const { return start_transfer_us > 0 && total_us > start_transfer_us ? total_us - start_transfer_us : 0; }
+};
 
 struct HttpResponse {
-    int status_code;
-    std::string body;
+    int status_code = 0;
+    // Empty when the request streamed its body into JSON paths
+    BodyBuffer body;
+    // What the request's stream paths selected
+    std::shared_ptr<const JsonStreamResult> streamed;
     std::map<std::string, std::string> headers;
     std::string error_message;
-    bool success;
+    bool success = false;
+    HttpTimings timings;
+};
+
+// Request headers parsed once, together with the curl_slist that carries
+// them. Immutable after construction, so one instance can be attached to any
+// number of concurrent transfers; nodes keep theirs until their text changes.
+class HeaderList {
+public:
+    HeaderList() = default;
+    // One "Name: value" per line; lines without a colon are ignored
+    explicit HeaderList(const std::string& text);
+    explicit HeaderList(const std::map<std::string, std::string>& headers);
+    ~HeaderList();
+
+    HeaderList(const HeaderList&) = delete;
+    HeaderList& operator=(const HeaderList&) = delete;
+
+    const std::map<std::string, std::string>& entries() const { return headers; }
+    // curl only reads the list, it is safe to hand out to several handles
+    struct curl_slist* slist() const { return list; }
+    bool empty() const { return headers.empty(); }
+
+private:
+    std::map<std::string, std::string> headers;
+    struct curl_slist* list = nullptr;
+
+    void build();
+};
+
+struct HttpRequest {
+    std::string method = "GET";
+    std::string url;
+    std::string body;
+    std::map<std::string, std::string> headers;
+    // Pre-built headers; when set, used instead of the map
+    std::shared_ptr<const HeaderList> header_list;
+    // When set, the body is not kept: these paths are evaluated while it
+    // arrives (see JsonStreamExtractor), and the transfer ends as soon as
+    // they have selected everything they can
+    std::shared_ptr<const JsonPathSet> stream_paths;
+};
+
+enum class HttpVersion {
+    Http1,
+    // HTTP/2 negotiated through TLS ALPN; plain http:// stays on HTTP/1.1
+    Http2,
+    // HTTP/2 without negotiation, also over plain http:// (h2c)
+    Http2PriorKnowledge
+};
+
+struct HttpOptions {
+    HttpVersion version = HttpVersion::Http1;
+    // Requests sharing one HTTP/2 connection at a time; further requests to
+    // the same origin open another connection. Only the event-driven client
+    // runs requests side by side on a connection.
+    long max_concurrent_streams = 100;
+    // Advertise every content encoding libcurl was built with (gzip,
+    // deflate, br, zstd) and decode responses while they stream in
+    bool compression = false;
+    // Bodies larger than this are spooled to a temp file and memory-mapped
+    // instead of held on the heap; 0 keeps everything in memory
+    size_t spool_threshold = 32 * 1024 * 1024;
+
+    bool operator==(const HttpOptions& other) const {
+        return version == other.version && max_concurrent_streams == other.max_concurrent_streams &&
+               compression == other.compression && spool_threshold == other.spool_threshold;
+    }
+    bool operator!=(const HttpOptions& other) const { return !(*this == other); }
+};
+
+// Picks the protocol version for each request. Origins that answered HTTP/2
+// prior knowledge like an HTTP/1.1-only server are remembered and get
+// HTTP/1.1 from then on. Thread-safe.
+class HttpVersionPolicy {
+public:
+    // Send or receive errors on fresh connections an origin may give
+    // before it is taken for an HTTP/1.1 server; one such error is as
+    // likely a dropped connection as a rejected preface
+    static constexpr int FALLBACK_STRIKES = 3;
+
+    void setVersion(HttpVersion requested);
+    HttpVersion versionFor(const std::string& url) const;
+    // Called with a failed transfer; true when it may have failed because
+    // the origin does not speak HTTP/2 and the request is safe to repeat
+    // over HTTP/1.1. Requests with other methods fail instead. The origin
+    // itself moves to HTTP/1.1 on proof, or after FALLBACK_STRIKES.
+    bool fallBack(CURL* curl, const HttpRequest& request, CURLcode result);
+    // Called with a successful transfer; forgets the strikes of its origin
+    void succeeded(const std::string& url);
+
+private:
+    mutable std::mutex mutex;
+    HttpVersion version = HttpVersion::Http1;
+    std::set<std::string> http1_origins;
+    std::map<std::string, int> strikes;
+    // Set while strikes is not empty, so successes skip the lock
+    std::atomic<bool> has_strikes{false};
+};
+
+// State of one request on an easy handle: configures the handle and owns
+// what curl points into while the transfer runs. The request passed to
+// prepare() must stay alive until finish(). Shared by the blocking and the
+// asynchronous client.
+class HttpTransfer {
+public:
+    HttpTransfer() = default;
+    HttpTransfer(const HttpTransfer&) = delete;
+    HttpTransfer& operator=(const HttpTransfer&) = delete;
+    ~HttpTransfer();
+
+    void prepare(CURL* curl, const HttpRequest& request, const std::atomic<bool>* cancel_flag,
+                 HttpVersion version = HttpVersion::Http1, const HttpOptions& options = {});
+    // Fills in status, timings and error from the finished handle
+    void finish(CURL* curl, CURLcode result);
+    // Forgets the response and the header list so the request can be
+    // prepared again on a reset handle
+    void reset();
+
+    HttpResponse response;
+
+private:
+    // Built from the request's map when it has no shared HeaderList
+    std::unique_ptr<HeaderList> own_headers;
+    // Keeps a shared list alive while curl points into it
+    std::shared_ptr<const HeaderList> shared_headers;
+    // Body bytes until finish() seals them into response.body
+    BodyBuilder received;
+
+    // Requests with stream paths feed the body through this instead
+    std::unique_ptr<JsonStreamExtractor> stream;
+    CURL* handle = nullptr;
+    size_t streamed_bytes = 0;
+    // Content-Length, or -1 when the response has none
+    long long expected_length = -1;
+    bool content_encoded = false;
+    // The extractor has what it needs; the rest of the body is read and dropped
+    bool draining = false;
+    // The transfer was cut short on purpose, so its write error is not a failure
+    bool stream_stopped = false;
+
+    // Once the paths are satisfied, up to this much of the body is still read
+    // so that an HTTP/1.1 connection stays reusable; with more left the
+    // transfer is aborted instead
+    static constexpr long long DRAIN_LIMIT = 64 * 1024;
+
+    size_t streamBody(const char* data, size_t length);
+    static size_t writeCallback(void* contents, size_t size, size_t nmemb, void* userp);
+    static size_t headerCallback(char* buffer, size_t size, size_t nitems, void* userdata);
 };
 
 class HttpClient {
@@ -20,11 +208,32 @@ public:
     HttpResponse post(const std::string& url, const std::string& body, const std::map<std::string, std::string>& headers = {});
     HttpResponse put(const std::string& url, const std::string& body, const std::map<std::string, std::string>& headers = {});
     HttpResponse del(const std::string& url, const std::map<std::string, std::string>& headers = {});
+    HttpResponse send(const HttpRequest& request);
+
+    // In-flight transfers abort as soon as *flag becomes true
+    void setCancelFlag(const std::atomic<bool>* flag) { cancel_flag = flag; }
+    // Requests are sent one at a time per call, so HTTP/2 here only saves
+    // handshakes; multiplexing needs the event-driven client
+    void setOptions(const HttpOptions& http_options) {
+        versions.setVersion(http_options.version);
+        options = http_options;
+    }
 
 private:
-    static size_t writeCallback(void* contents, size_t size, size_t nmemb, void* userp);
-    static size_t headerCallback(char* buffer, size_t size, size_t nitems, void* userdata);
-    
-    HttpResponse performRequest(const std::string& method, const std::string& url, 
-                                const std::string& body, const std::map<std::string, std::string>& headers);
+    const std::atomic<bool>* cancel_flag = nullptr;
+    HttpVersionPolicy versions;
+    HttpOptions options;
+
+    // Idle easy handles keyed by the origin they last talked to. A handle
+    // keeps its open connections across requests, so handing it back to the
+    // same origin skips the handshakes; DNS entries and TLS sessions live in
+    // CurlShare and are shared by every handle.
+    static constexpr size_t MAX_IDLE_HANDLES = 64;
+    std::mutex pool_mutex;
+    std::map<std::string, std::vector<CURL*>> idle_handles;
+    size_t idle_count = 0;
+
+    CURL* acquireHandle(const std::string& origin);
+    void releaseHandle(const std::string& origin, CURL* curl);
+
 };
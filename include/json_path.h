@@ -0,0 +1,75 @@
+#pragma once
+#include "json_scanner.h"
+#include <string>
+#include <vector>
+
+// A JSONPath expression compiled into a list of steps, so that executions
+// only run the matcher (see extractJson) and never re-parse the text.
+//
+//   $.data.id  $['odd key']  $.users[0]  $.users[*].name  $.items.*
+//   $.items[2:10:2]  $.users[?(@.age >= 18 && @.name != 'bob')].id
+//
+// Filters compare paths relative to the element (@.age, @) with literals
+// using == != < <= > >=, and combine them with && || ! and parentheses; a
+// bare @.key tests for existence. Indices and slice bounds cannot be
+// negative: the document is matched in a single forward pass, which never
+// knows an array's length before reaching its end.
+class JsonPath {
+public:
+    enum class StepKind { Key, Index, Wildcard, Slice, Filter };
+
+    struct Step {
+        StepKind kind = StepKind::Key;
+        std::string key;
+        // Index or slice bounds; a negative end means "to the end"
+        long start = 0;
+        long end = -1;
+        long step = 1;
+        // Filter: index into filters()
+        int filter = -1;
+    };
+
+    // Postfix program of a filter, evaluated on a small stack of booleans
+    enum class Op { Exists, Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual, And, Or, Not };
+
+    struct Instruction {
+        Op op;
+        // Exists and comparisons: index into relativePaths() and literals()
+        int path = -1;
+        int literal = -1;
+    };
+
+    struct Literal {
+        JsonType type = JsonType::Null;
+        // Strings unescaped, true/false/null spelled out
+        std::string text;
+        double number = 0;
+    };
+
+    // Deepest stack a filter may need
+    static constexpr int MAX_FILTER_DEPTH = 32;
+
+    // On failure the path is left empty and error says what was wrong
+    bool compile(const std::string& text, std::string& error);
+
+    const std::string& getText() const { return text; }
+    const std::vector<Step>& getSteps() const { return steps; }
+    const std::vector<std::vector<Instruction>>& filters() const { return filter_code; }
+    // Paths below @ inside filters; keys and indices only
+    const std::vector<std::vector<Step>>& relativePaths() const { return relative_paths; }
+    const std::vector<Literal>& literals() const { return literal_values; }
+
+    // Selects at most one value: no wildcards, slices or filters
+    bool isSingular() const { return singular; }
+    bool hasFilters() const { return !filter_code.empty(); }
+
+private:
+    std::string text;
+    std::vector<Step> steps;
+    std::vector<std::vector<Instruction>> filter_code;
+    std::vector<std::vector<Step>> relative_paths;
+    std::vector<Literal> literal_values;
+    bool singular = true;
+
+    friend class JsonPathParser;
+};
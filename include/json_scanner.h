@@ -0,0 +1,122 @@
+#pragma once
+#include "body_buffer.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// On-demand JSON access. Instead of building a DOM, the document is walked
+// through its structural characters (braces, brackets, colons, commas and
+// quotes outside strings), which are found 64 bytes at a time with SIMD
+// compares. Only values on the requested path are looked at; everything
+// else is skipped by bracket depth, and scanning stops as soon as the
+// value is found. Parts of the document off the path are not validated.
+
+enum class JsonType { Invalid, Null, Bool, Number, String, Object, Array };
+
+struct JsonValue {
+    JsonType type = JsonType::Invalid;
+    // Exact bytes of the value inside the document, quotes included
+    std::string_view raw;
+
+    // String contents without quotes or escapes; other values as written
+    std::string text() const;
+    // Contents of a string that has no escapes, else raw; no copy needed
+    std::string_view unquoted() const;
+    bool hasEscapes() const;
+};
+
+class JsonPath;
+
+// Paths evaluated together over one document
+using JsonPathSet = std::vector<std::shared_ptr<const JsonPath>>;
+
+// Structural index of one document, for several lookups into the same
+// response. It records the structural positions a scan finds, and for each
+// bracket where its partner is, so later lookups replay positions and jump
+// over containers instead of classifying the bytes again. It is filled
+// lazily, only as far as some lookup has needed, and may be shared by
+// threads. The document must outlive it.
+class JsonIndex {
+public:
+    // Smaller documents are cheaper to rescan than to index; positions are
+    // stored in 32 bits
+    static constexpr size_t MIN_SIZE = 4096;
+    static constexpr size_t MAX_SIZE = UINT32_MAX;
+
+    explicit JsonIndex(std::string_view json);
+    ~JsonIndex();
+    JsonIndex(const JsonIndex&) = delete;
+    JsonIndex& operator=(const JsonIndex&) = delete;
+
+    std::string_view document() const;
+    // Structural characters found so far
+    size_t size() const;
+
+    struct State;
+
+private:
+    std::unique_ptr<State> state;
+
+    friend bool extractJson(const JsonIndex& index, const JsonPath& path, JsonValue& value);
+    friend bool extractJsonAll(const JsonIndex& index, const JsonPath& path, std::vector<JsonValue>& values);
+};
+
+// First value the path selects; scanning stops as soon as it is found.
+// False when nothing matches or the document is malformed along the way.
+bool extractJson(std::string_view json, const JsonPath& path, JsonValue& value);
+bool extractJson(const JsonIndex& index, const JsonPath& path, JsonValue& value);
+// Every value the path selects, in document order. False when the document
+// turned out malformed; values found before that point are kept.
+bool extractJsonAll(std::string_view json, const JsonPath& path, std::vector<JsonValue>& values);
+bool extractJsonAll(const JsonIndex& index, const JsonPath& path, std::vector<JsonValue>& values);
+
+// What a JsonStreamExtractor selected: for each path of its set, the values
+// in document order
+struct JsonStreamResult {
+    std::shared_ptr<const JsonPathSet> paths;
+    std::vector<std::vector<JsonValue>> values;
+    // Holds the bytes of every value; the rest of the document is gone
+    BodyBuffer bytes;
+    // Well-formed as far as it was read, and read far enough for every path
+    bool valid = false;
+
+    // Values of a path of the set (the same object), or null
+    const std::vector<JsonValue>* find(const JsonPath* path) const;
+};
+
+// Evaluates paths over a document that arrives in pieces, e.g. a response
+// while it downloads. Only the selected values are kept, so memory does not
+// grow with the document, and done() tells when the rest of it can no
+// longer select anything. Paths with filters are not supported: they would
+// need every element buffered before it can be tested.
+class JsonStreamExtractor {
+public:
+    static constexpr size_t MAX_PATHS = 64;
+
+    // At most MAX_PATHS paths, none with a filter
+    explicit JsonStreamExtractor(std::shared_ptr<const JsonPathSet> paths);
+    ~JsonStreamExtractor();
+    JsonStreamExtractor(const JsonStreamExtractor&) = delete;
+    JsonStreamExtractor& operator=(const JsonStreamExtractor&) = delete;
+
+    // Next piece of the document; false once it turned out malformed
+    bool feed(std::string_view chunk);
+    // Every path has selected all it can
+    bool done() const;
+    // Ends the document, which may stop early once done()
+    std::shared_ptr<const JsonStreamResult> finish();
+
+    struct State;
+
+private:
+    std::unique_ptr<State> state;
+};
+
+// Block classifier picked for this CPU: "avx2", "sse2" or "scalar"
+const char* jsonScannerKernel();
+// Forces a classifier by name, for tests and benchmarks; false when it is
+// not available in this build or on this CPU. Must not be called while
+// another thread scans.
+bool setJsonScannerKernel(std::string_view name);
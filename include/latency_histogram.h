@@ -0,0 +1,145 @@
+#pragma once
+#include "http_client.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ExecutionPlan;
+
+struct LatencySummary {
+    uint64_t count = 0;
+    double mean_us = 0.0;
+    uint64_t p50_us = 0;
+    uint64_t p90_us = 0;
+    uint64_t p99_us = 0;
+    uint64_t p999_us = 0;
+    uint64_t max_us = 0;
+};
+
+// Fixed-size latency histogram in microseconds with HDR-style buckets: values
+// below 128 get a bucket each, above that every power of two is split into
+// 64 linear sub-buckets, so any recorded value is off by less than 1.6%.
+// Recording is a few relaxed atomic adds and never allocates, so one
+// instance can be shared by any number of threads; instances can also be
+// kept per thread and merged afterwards.
+class LatencyHistogram {
+public:
+    // Largest trackable value is 2^(MAX_EXPONENT + 7) - 1 us (about 19 hours);
+    // anything above lands in the last bucket
+    static constexpr int MAX_EXPONENT = 29;
+    static constexpr int BUCKET_COUNT = (MAX_EXPONENT + 2) * 64;
+
+    LatencyHistogram() = default;
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(uint64_t value_us);
+    void merge(const LatencyHistogram& other);
+    void reset();
+
+    uint64_t count() const { return total_count.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_value.load(std::memory_order_relaxed); }
+    // Highest value equivalent to the given percentile (0-100)
+    uint64_t valueAtPercentile(double percentile) const;
+    LatencySummary summary() const;
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts{};
+    std::atomic<uint64_t> total_count{0};
+    std::atomic<uint64_t> total_sum{0};
+    std::atomic<uint64_t> max_value{0};
+
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketValue(int index);
+};
+
+// Average time spent in each phase of a request, in microseconds
+struct HttpPhaseSummary {
+    uint64_t count = 0;
+    double dns_us = 0.0;
+    double connect_us = 0.0;
+    double tls_us = 0.0;
+    double server_us = 0.0;
+    double transfer_us = 0.0;
+    double bytes_sent = 0.0;
+    double bytes_received = 0.0;
+    double bytes_decoded = 0.0;
+    // Fraction of requests that went out on an already open connection
+    double reused = 0.0;
+};
+
+// Running totals of HttpTimings, lock-free like LatencyHistogram
+class HttpPhaseStats {
+public:
+    void record(const HttpTimings& timings);
+    void reset();
+    HttpPhaseSummary summary() const;
+
+private:
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> dns_us{0};
+    std::atomic<uint64_t> connect_us{0};
+    std::atomic<uint64_t> tls_us{0};
+    std::atomic<uint64_t> server_us{0};
+    std::atomic<uint64_t> transfer_us{0};
+    std::atomic<uint64_t> bytes_sent{0};
+    std::atomic<uint64_t> bytes_received{0};
+    std::atomic<uint64_t> bytes_decoded{0};
+    std::atomic<uint64_t> reused{0};
+};
+
+// Histograms for one plan, indexed like the plan's nodes. Only HTTP nodes get
+// them; the rest stay null so recording them is a single branch.
+struct PlanLatency {
+    std::vector<LatencyHistogram*> nodes;
+    std::vector<HttpPhaseStats*> phases;
+    LatencyHistogram* orchestration = nullptr;
+
+    void recordNode(uint32_t index, uint64_t value_us) const {
+        if (index < nodes.size() && nodes[index]) nodes[index]->record(value_us);
+    }
+    void recordTransfer(uint32_t index, const HttpTimings& timings) const {
+        if (index < phases.size() && phases[index]) phases[index]->record(timings);
+    }
+};
+
+struct NodeLatency {
+    int node_id;
+    std::string type;
+    LatencySummary summary;
+    HttpPhaseSummary phases;
+};
+
+// Long-lived histograms keyed by orchestration and node id, so numbers keep
+// accumulating across runs and plan recompiles. Histograms are never freed
+// before the registry, which lets runs hold plain pointers to them.
+class LatencyRegistry {
+public:
+    // Resolves the histograms of every node in the plan. Takes the lock once
+    // per run; recording afterwards is lock-free.
+    PlanLatency bind(const ExecutionPlan& plan);
+
+    LatencySummary orchestrationSummary(int orchestration_id) const;
+    std::vector<NodeLatency> nodeSummaries(int orchestration_id) const;
+    void reset(int orchestration_id);
+
+private:
+    struct NodeEntry {
+        std::string type;
+        LatencyHistogram histogram;
+        HttpPhaseStats phases;
+    };
+
+    struct OrchestrationLatency {
+        LatencyHistogram total;
+        std::map<int, std::unique_ptr<NodeEntry>> nodes;
+    };
+
+    mutable std::mutex mutex;
+    std::map<int, std::unique_ptr<OrchestrationLatency>> orchestrations;
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include "execution_plan.h"
+#include "latency_histogram.h"
+#include <atomic>
+#include <functional>
+
+enum class LoadMode {
+    // Every virtual user starts its next iteration as soon as the last one
+    // finished
+    ClosedLoop,
+    // Iterations are started on a fixed schedule regardless of how long
+    // earlier ones take
+    ArrivalRate
+};
+
+struct LoadTestConfig {
+    LoadMode mode = LoadMode::ClosedLoop;
+    int virtual_users = 10;
+    // Total iterations across all users; 0 runs for duration_s instead
+    long long iterations = 0;
+    double duration_s = 10.0;
+
+    // ArrivalRate only: target iterations per second and the most iterations
+    // allowed to run at once
+    double arrival_rate = 100.0;
+    int max_in_flight = 100;
+
+    // 0 runs every virtual user (or in-flight slot) on its own thread with a
+    // blocking client. Above 0, all iterations share this many curl multi
+    // loops instead, which is what makes thousands of users practical.
+    int io_threads = 0;
+
+    HttpOptions http;
+};
+
+struct LoadTestStats {
+    long long iterations = 0;
+    long long failed_iterations = 0;
+    // ArrivalRate only: scheduled iterations that never got a free slot
+    // before the run ended
+    long long dropped_iterations = 0;
+    long long requests = 0;
+    long long failed_requests = 0;
+    int active_users = 0;
+    double elapsed_s = 0.0;
+
+    // Iteration latency; in ArrivalRate mode measured from the time the
+    // iteration was scheduled to start, so queueing delay is included
+    LatencySummary latency;
+
+    double iterationsPerSecond() const { return elapsed_s > 0 ? iterations / elapsed_s : 0.0; }
+    double requestsPerSecond() const { return elapsed_s > 0 ? requests / elapsed_s : 0.0; }
+    double iterationErrorRate() const { return iterations > 0 ? double(failed_iterations) / iterations : 0.0; }
+    double requestErrorRate() const { return requests > 0 ? double(failed_requests) / requests : 0.0; }
+};
+
+// Runs the plan repeatedly from many threads. Every worker has its own
+// ExecutionContext and HttpClient and shares only the immutable plan.
+//
+// ClosedLoop: virtual_users workers run iterations back to back.
+// ArrivalRate: max_in_flight workers claim iteration slots from a fixed
+// schedule (start + k / arrival_rate). A worker that claims a slot late
+// still measures from the slot's intended start, so a slow server shows up
+// as latency instead of silently lowering the request rate.
+//
+// With io_threads set, users and slots are contexts rather than threads:
+// iterations run through InlineScheduler::runAsync on an AsyncHttpClient
+// and an idle user costs a few kilobytes instead of a thread.
+class LoadRunner {
+public:
+    // When latency is given, node timings and iteration latencies are also
+    // recorded into those (shared) histograms
+    LoadRunner(std::shared_ptr<const ExecutionPlan> plan, const LoadTestConfig& config,
+               const std::atomic<bool>* cancel_flag = nullptr, const PlanLatency* latency = nullptr);
+
+    // Blocks until the iteration budget or duration is used up, or the run
+    // is cancelled. on_progress is called from the calling thread about once
+    // per second and once more with the final numbers.
+    LoadTestStats run(const std::function<void(const LoadTestStats&)>& on_progress = {});
+
+private:
+    std::shared_ptr<const ExecutionPlan> plan;
+    LoadTestConfig config;
+    const std::atomic<bool>* cancel_flag;
+    const PlanLatency* latency;
+
+    LoadTestStats runThreaded(const std::function<void(const LoadTestStats&)>& on_progress);
+    LoadTestStats runEventDriven(const std::function<void(const LoadTestStats&)>& on_progress);
+};
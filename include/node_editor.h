@@ -4,20 +4,42 @@
 #include "nodes.h"
 #include "link.h"
 #include "executor.h"
+#include "execution_engine.h"
+#include "execution_plan.h"
 #include "sidebar.h"
 #include <vector>
 #include <memory>
 #include <map>
+#include <set>
 
 class Terminal;
 struct NodeData;
 struct LinkData;
+struct RowKey;
 
 struct OrchestrationData {
   std::vector<std::unique_ptr<Node>> nodes;
   std::vector<std::unique_ptr<Link>> links;
   int next_node_id = 1;
   int next_link_id = 10000;
+
+  // Bumped on every change that affects execution (nodes, links, node data);
+  // the cached plan is recompiled only when it was built for an older revision
+  unsigned int revision = 0;
+  unsigned int plan_revision = 0;
+  std::shared_ptr<const ExecutionPlan> plan;
+
+  // Rows to write on the next save (new, edited or moved) and ids deleted
+  // since the last one, so saving touches only what changed
+  std::set<int> dirty_nodes;
+  std::set<int> removed_nodes;
+  std::set<int> dirty_links;
+  std::set<int> removed_links;
+
+  void nodeChanged(int node_id) { dirty_nodes.insert(node_id); removed_nodes.erase(node_id); }
+  void nodeRemoved(int node_id) { removed_nodes.insert(node_id); dirty_nodes.erase(node_id); }
+  void linkChanged(int link_id) { dirty_links.insert(link_id); removed_links.erase(link_id); }
+  void linkRemoved(int link_id) { removed_links.insert(link_id); dirty_links.erase(link_id); }
 };
 
 class NodeEditor {
@@ -31,18 +53,44 @@ class NodeEditor {
 
     std::vector<NodeData> getAllNodesData() const;
     std::vector<LinkData> getAllLinksData() const;
+
+    // Rows changed or removed since the last markSaved()
+    std::vector<NodeData> getChangedNodesData() const;
+    std::vector<LinkData> getChangedLinksData() const;
+    std::vector<RowKey> getRemovedNodes() const;
+    std::vector<RowKey> getRemovedLinks() const;
+    // Called once the database holds the current state
+    void markSaved();
     
     void loadNodesData(const std::vector<NodeData>& nodes_data);
     void loadLinksData(const std::vector<LinkData>& links_data);
 
     void executeSelectedNode(Terminal* terminal = nullptr);
     void executeOrchestration(int orchestration_id, Terminal* terminal = nullptr);
-    std::string getExecutionLog() const { return execution_context.execution_log; }
+    void executeLoadTest(int orchestration_id, Terminal* terminal = nullptr);
+    void cancelExecution();
+    std::string getExecutionLog() const { return engine.getExecutionLog(); }
+
+    // Plan of an orchestration as it currently stands, or null if it has no
+    // nodes loaded
+    std::shared_ptr<const ExecutionPlan> getPlan(int orchestration_id);
+    ExecutionEngine& getEngine() { return engine; }
 
   private:
     std::map<int, std::unique_ptr<OrchestrationData>> orchestration_data;
     bool initialized = false;
-    ExecutionContext execution_context;
+    ExecutionEngine engine;
+
+    LoadTestConfig load_config;
+    bool load_by_iterations = false;
+    long long load_iterations = 100;
+    bool load_event_driven = false;
+    int load_io_threads = 2;
+
+    std::shared_ptr<const ExecutionPlan> getPlan(int orchestration_id, OrchestrationData& data);
+    void drawRunStatus();
+    void drawLoadTestPopup(int orchestration_id, Terminal* terminal);
+    void drawHttpSettingsPopup();
 
     void handleContextMenu(OrchestrationData& data);
     void handleRightClick();
@@ -52,7 +100,7 @@ class NodeEditor {
     void createNode(const std::string& nodeType, ImVec2 position, OrchestrationData& data);
     void createNodeWithId(int node_id, const std::string& nodeType, ImVec2 position, OrchestrationData& data);
     void deleteNodes(OrchestrationData& data);
-    void drawNodes(const OrchestrationData& data) const;
+    void drawNodes(OrchestrationData& data);
 
     void createLinks(OrchestrationData& data);
     void deleteLinks(OrchestrationData& data);
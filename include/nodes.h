@@ -1,8 +1,16 @@
 #pragma once
 #include "imnodes.h"
 #include "imgui.h"
+#include "json_scanner.h"
+#include "variables.h"
 #include <string>
 #include <vector>
+#include <memory>
+#include <functional>
+
+struct ExecutionContext;
+class RequestTemplate;
+class Expression;
 
 class Node {
 protected:
@@ -10,6 +18,10 @@ protected:
     int orchestration_id;
     std::string title;
     ImVec2 position;
+    unsigned int revision = 0;
+
+    // Called from draw() whenever an input field was edited
+    void markModified() { revision++; }
 
 public:
     Node(int nodeId, const std::string& nodeTitle);
@@ -20,8 +32,31 @@ public:
     virtual std::string getType() const = 0;
     virtual std::string serializeData() const { return ""; }
     virtual void deserializeData(const std::string& data) {}
+    // Runs the node against a context; implemented in executor.cpp. Nodes
+    // without an implementation log a warning and succeed.
+    virtual bool execute(ExecutionContext& context);
+    // Continuation form of execute(): done receives the result, possibly later
+    // and on another thread. The default calls execute() inline; HTTP and
+    // Delay nodes finish from the context's AsyncHttpClient when it has one.
+    virtual void executeAsync(ExecutionContext& context, std::function<void(bool)> done);
+    // HTTP nodes evaluate these paths while their response arrives instead
+    // of keeping the body. Set by ExecutionPlan on its own copies, and only
+    // when nothing but JSON extract nodes reads the response.
+    virtual void setStreamPaths(std::shared_ptr<const JsonPathSet>) {}
+    // Resolves the variable names the node uses to slots (see
+    // VariableNames). Called by ExecutionPlan on its own copies; unresolved
+    // nodes look their names up on every execution.
+    virtual void resolveVariables() {}
     
     int getId() const;
+    // Bumped on every edit of the node's data, used to invalidate compiled plans
+    unsigned int getRevision() const { return revision; }
+
+    // Builds an empty node of the given serialized type, or nullptr if unknown
+    static std::unique_ptr<Node> create(const std::string& type, int nodeId);
+    // Detached copy (same id, data and position) that never touches ImNodes,
+    // so it can be handed to the execution thread
+    std::unique_ptr<Node> clone() const;
 
     void setPosition(ImVec2 pos);
     ImVec2 getPosition() const;
@@ -34,19 +69,30 @@ public:
     std::vector<int> getAttributeIds() const override;
     void draw() override;
     std::string getType() const override { return "Start"; }
+    bool execute(ExecutionContext& context) override;
 };
 
 class HttpGetNode : public Node {
 private:
     char url[512] = "https://jsonplaceholder.typicode.com/posts/1";
     char headers[256] = "";
+    // Parsed from url, headers and body whenever they change, shared by
+    // every request
+    std::shared_ptr<const RequestTemplate> request_template;
+    std::shared_ptr<const JsonPathSet> stream_paths;
+    void updateRequestTemplate();
 public:
     HttpGetNode(int nodeId);
     std::vector<int> getAttributeIds() const override;
     void draw() override;
     std::string getType() const override { return "HTTP_GET"; }
+    bool execute(ExecutionContext& context) override;
+    void executeAsync(ExecutionContext& context, std::function<void(bool)> done) override;
+    void setStreamPaths(std::shared_ptr<const JsonPathSet> paths) override { stream_paths = std::move(paths); }
+    void resolveVariables() override;
     std::string getUrl() const { return std::string(url); }
     std::string getHeaders() const { return std::string(headers); }
+    const std::shared_ptr<const RequestTemplate>& getRequestTemplate() const { return request_template; }
     std::string serializeData() const override;
     void deserializeData(const std::string& data) override;
 };
@@ -56,13 +102,23 @@ private:
     char url[512] = "https://jsonplaceholder.typicode.com/posts";
     char headers[256] = "Content-Type: application/json";
     char body[512] = "{\n\"title\": \"hello world\",\n\"body\": \"this is a test post\",\n\"userId\": 1\n}";
+    // Parsed from url, headers and body whenever they change, shared by
+    // every request
+    std::shared_ptr<const RequestTemplate> request_template;
+    std::shared_ptr<const JsonPathSet> stream_paths;
+    void updateRequestTemplate();
 public:
     HttpPostNode(int nodeId);
     std::vector<int> getAttributeIds() const override;
     void draw() override;
     std::string getType() const override { return "HTTP_POST"; }
+    bool execute(ExecutionContext& context) override;
+    void executeAsync(ExecutionContext& context, std::function<void(bool)> done) override;
+    void setStreamPaths(std::shared_ptr<const JsonPathSet> paths) override { stream_paths = std::move(paths); }
+    void resolveVariables() override;
     std::string getUrl() const { return std::string(url); }
     std::string getHeaders() const { return std::string(headers); }
+    const std::shared_ptr<const RequestTemplate>& getRequestTemplate() const { return request_template; }
     std::string getBody() const { return std::string(body); }
     std::string serializeData() const override;
     void deserializeData(const std::string& data) override;
@@ -73,13 +129,23 @@ private:
     char url[512] = "https://jsonplaceholder.typicode.com/posts/1";
     char headers[256] = "Content-Type: application/json";
     char body[512] = "{\n\"id\": 1,\n\"title\": \"updated title\",\n\"body\": \"this post has been updated\",\n\"userId\": 1\n}";
+    // Parsed from url, headers and body whenever they change, shared by
+    // every request
+    std::shared_ptr<const RequestTemplate> request_template;
+    std::shared_ptr<const JsonPathSet> stream_paths;
+    void updateRequestTemplate();
 public:
     HttpPutNode(int nodeId);
     std::vector<int> getAttributeIds() const override;
     void draw() override;
     std::string getType() const override { return "HTTP_PUT"; }
+    bool execute(ExecutionContext& context) override;
+    void executeAsync(ExecutionContext& context, std::function<void(bool)> done) override;
+    void setStreamPaths(std::shared_ptr<const JsonPathSet> paths) override { stream_paths = std::move(paths); }
+    void resolveVariables() override;
     std::string getUrl() const { return std::string(url); }
     std::string getHeaders() const { return std::string(headers); }
+    const std::shared_ptr<const RequestTemplate>& getRequestTemplate() const { return request_template; }
     std::string getBody() const { return std::string(body); }
     std::string serializeData() const override;
     void deserializeData(const std::string& data) override;
@@ -89,13 +155,23 @@ class HttpDeleteNode : public Node {
 private:
     char url[512] = "https://jsonplaceholder.typicode.com/posts/1";
     char headers[256] = "";
+    // Parsed from url, headers and body whenever they change, shared by
+    // every request
+    std::shared_ptr<const RequestTemplate> request_template;
+    std::shared_ptr<const JsonPathSet> stream_paths;
+    void updateRequestTemplate();
 public:
     HttpDeleteNode(int nodeId);
     std::vector<int> getAttributeIds() const override;
     void draw() override;
     std::string getType() const override { return "HTTP_DELETE"; }
+    bool execute(ExecutionContext& context) override;
+    void executeAsync(ExecutionContext& context, std::function<void(bool)> done) override;
+    void setStreamPaths(std::shared_ptr<const JsonPathSet> paths) override { stream_paths = std::move(paths); }
+    void resolveVariables() override;
     std::string getUrl() const { return std::string(url); }
     std::string getHeaders() const { return std::string(headers); }
+    const std::shared_ptr<const RequestTemplate>& getRequestTemplate() const { return request_template; }
     std::string serializeData() const override;
     void deserializeData(const std::string& data) override;
 };
@@ -103,11 +179,19 @@ public:
 class JsonExtractNode : public Node {
 private:
     char json_path[256] = "$.data.id";
+    // Compiled whenever the text changes; null while it does not compile
+    std::shared_ptr<const JsonPath> compiled_path;
+    std::string path_error;
+    void compilePath();
 public:
     JsonExtractNode(int nodeId);
     std::vector<int> getAttributeIds() const override;
     void draw() override;
     std::string getType() const override { return "JSON_EXTRACT"; }
+    bool execute(ExecutionContext& context) override;
+    std::string getJsonPath() const { return std::string(json_path); }
+    const std::shared_ptr<const JsonPath>& getCompiledPath() const { return compiled_path; }
+    const std::string& getPathError() const { return path_error; }
     std::string serializeData() const override;
     void deserializeData(const std::string& data) override;
 };
@@ -115,11 +199,14 @@ public:
 class SetVariableNode : public Node {
 private:
     char var_name[128] = "user_id";
+    uint32_t var_slot = VariableNames::npos;
 public:
     SetVariableNode(int nodeId);
     std::vector<int> getAttributeIds() const override;
     void draw() override;
     std::string getType() const override { return "SET_VARIABLE"; }
+    bool execute(ExecutionContext& context) override;
+    void resolveVariables() override;
     std::string getVarName() const { return std::string(var_name); }
     std::string serializeData() const override;
     void deserializeData(const std::string& data) override;
@@ -128,11 +215,14 @@ public:
 class GetVariableNode : public Node {
 private:
     char var_name[128] = "user_id";
+    uint32_t var_slot = VariableNames::npos;
 public:
     GetVariableNode(int nodeId);
     std::vector<int> getAttributeIds() const override;
     void draw() override;
     std::string getType() const override { return "GET_VARIABLE"; }
+    bool execute(ExecutionContext& context) override;
+    void resolveVariables() override;
     std::string getVarName() const { return std::string(var_name); }
     std::string serializeData() const override;
     void deserializeData(const std::string& data) override;
@@ -141,11 +231,21 @@ public:
 class IfConditionNode : public Node {
 private:
     char condition[256] = "status_code == 200";
+    // Compiled whenever the text changes; null while it does not compile
+    std::shared_ptr<const Expression> compiled_condition;
+    std::string condition_error;
+    void compileCondition();
 public:
     IfConditionNode(int nodeId);
     std::vector<int> getAttributeIds() const override;
     void draw() override;
     std::string getType() const override { return "IF_CONDITION"; }
+    // Takes the True or the False output; the other branch is skipped
+    bool execute(ExecutionContext& context) override;
+    void resolveVariables() override;
+    std::string getCondition() const { return std::string(condition); }
+    const std::shared_ptr<const Expression>& getCompiledCondition() const { return compiled_condition; }
+    const std::string& getConditionError() const { return condition_error; }
     std::string serializeData() const override;
     void deserializeData(const std::string& data) override;
 };
@@ -158,6 +258,8 @@ public:
     std::vector<int> getAttributeIds() const override;
     void draw() override;
     std::string getType() const override { return "DELAY"; }
+    bool execute(ExecutionContext& context) override;
+    void executeAsync(ExecutionContext& context, std::function<void(bool)> done) override;
     std::string getDelayMs() const { return std::string(delay_ms); }
     std::string serializeData() const override;
     void deserializeData(const std::string& data) override;
@@ -166,11 +268,25 @@ public:
 class AssertNode : public Node {
 private:
     char assertion[256] = "status_code == 200";
+    // Compiled whenever the text changes; null while it does not compile
+    std::shared_ptr<const Expression> compiled_assertion;
+    std::string assertion_error;
+    bool fail_linked = false;
+    void compileAssertion();
 public:
     AssertNode(int nodeId);
     std::vector<int> getAttributeIds() const override;
     void draw() override;
     std::string getType() const override { return "ASSERT"; }
+    // Takes the Pass or the Fail output. A failed assertion fails the node
+    // unless its Fail output leads somewhere.
+    bool execute(ExecutionContext& context) override;
+    void resolveVariables() override;
+    // Set by ExecutionPlan on its own copies
+    void setFailLinked(bool linked) { fail_linked = linked; }
+    std::string getAssertion() const { return std::string(assertion); }
+    const std::shared_ptr<const Expression>& getCompiledAssertion() const { return compiled_assertion; }
+    const std::string& getAssertionError() const { return assertion_error; }
     std::string serializeData() const override;
     void deserializeData(const std::string& data) override;
 };
@@ -183,6 +299,7 @@ public:
     std::vector<int> getAttributeIds() const override;
     void draw() override;
     std::string getType() const override { return "LOG"; }
+    bool execute(ExecutionContext& context) override;
     std::string getMessage() const { return std::string(message); }
     std::string serializeData() const override;
     void deserializeData(const std::string& data) override;
@@ -7,6 +7,8 @@ class Orchestration {
   public:
     int id;
     std::string name;
+    // Set while the database row is missing or out of date
+    bool dirty = true;
 
     Orchestration(int id, const std::string& name);
 };
@@ -16,6 +18,10 @@ class Project {
     int id;
     std::string name;
     std::vector<std::unique_ptr<Orchestration>> orchestrations;
+    // Set while the database row is missing or out of date
+    bool dirty = true;
+    // Orchestrations removed since the last save, whose rows are still stored
+    std::vector<int> removed_orchestrations;
 
     Project(int id, const std::string& name);
 
@@ -23,6 +29,8 @@ class Project {
     void addOrchestrationWithId(int id, const std::string& name);
     void removeOrchestration(int orchestration_id);
     Orchestration* getOrchestration(int orchestration_id);
+    // Clears the change tracking of the project and its orchestrations
+    void markSaved();
   private:
     int next_orchestration_id = 1000;
 };
@@ -37,8 +45,13 @@ class ProjectManager {
     Project* getProject(int project_id);
 
     const std::vector<std::unique_ptr<Project>>& getProjects() const { return projects; }
+    // Projects removed since the last save, whose rows are still stored
+    const std::vector<int>& getRemovedProjects() const { return removed_projects; }
+    // Called once the database holds the current state
+    void markSaved();
 
   private:
     std::vector<std::unique_ptr<Project>> projects;
+    std::vector<int> removed_projects;
     int next_project_id = 1;
 };
@@ -0,0 +1,73 @@
+#pragma once
+#include "http_client.h"
+#include "variables.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct ExecutionContext;
+
+// Text with {{name}} placeholders, split once into literal and variable
+// segments. Rendering first adds up the exact length of the result, then
+// writes it in a single pass, so a reused buffer stops reallocating once it
+// has grown to fit. Unset variables render as nothing; a "{{" not followed
+// by a name and "}}" stays as it is.
+class TextTemplate {
+public:
+    TextTemplate() = default;
+    explicit TextTemplate(std::string_view text);
+
+    const std::string& getText() const { return text; }
+    bool hasVariables() const { return !names.empty(); }
+    const std::vector<std::string>& variables() const { return names; }
+
+    // Resolves the names to slots (see VariableNames); until then each
+    // render looks them up by name
+    void resolveVariables();
+
+    // values is scratch space, kept by the caller between renders
+    void render(ExecutionContext& context, std::vector<VariableValue>& values, std::string& out) const;
+
+private:
+    struct Segment {
+        uint32_t offset;
+        uint32_t length;
+        // Index into names, or npos for literal text
+        uint32_t variable;
+    };
+
+    std::string text;
+    std::vector<Segment> segments;
+    // Length of the text without its placeholders
+    size_t literal_length = 0;
+    std::vector<std::string> names;
+    std::vector<uint32_t> slots;
+};
+
+// URL, headers and body of an HTTP node as templates. Immutable once built,
+// like HeaderList, so one instance serves every request of the node.
+class RequestTemplate {
+public:
+    RequestTemplate(std::string method, std::string_view url, std::string_view headers, std::string_view body);
+
+    const TextTemplate& url() const { return url_template; }
+    const TextTemplate& headers() const { return headers_template; }
+    const TextTemplate& body() const { return body_template; }
+
+    void resolveVariables();
+
+    // Fills request for one execution on context. The strings of request
+    // keep their capacity, so rendering into the same request again does
+    // not allocate; headers with placeholders are parsed per request.
+    void render(ExecutionContext& context, HttpRequest& request) const;
+
+private:
+    std::string method;
+    TextTemplate url_template;
+    TextTemplate headers_template;
+    TextTemplate body_template;
+    // Headers without placeholders, parsed once
+    std::shared_ptr<const HeaderList> header_list;
+};
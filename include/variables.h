@@ -0,0 +1,49 @@
+#pragma once
+#include "body_buffer.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+// JSON kept as its text, e.g. an object or array taken from a response
+struct JsonText {
+    BodyBuffer bytes;
+};
+
+// Value of a variable. Strings and JSON share their bytes (see BodyBuffer),
+// so copying a value never copies text; std::monostate means unset.
+using VariableValue = std::variant<std::monostate, BodyBuffer, int64_t, double, bool, JsonText>;
+
+// Process-wide table of variable names. Nodes resolve the names they use
+// to dense slots when a plan is built, so executions index an array instead
+// of looking names up. Slots are never reused or renumbered, which lets a
+// context run any number of plans, one after another, with the same store.
+class VariableNames {
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    static VariableNames& instance();
+
+    VariableNames(const VariableNames&) = delete;
+    VariableNames& operator=(const VariableNames&) = delete;
+
+    // Slot of name, added on first use
+    uint32_t intern(std::string_view name);
+    // Slot of name, or npos when no node ever used it
+    uint32_t find(std::string_view name) const;
+    std::string name(uint32_t slot) const;
+
+private:
+    VariableNames() = default;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, uint32_t> slots;
+    std::vector<std::string> names;
+};
+
+// Value as text: strings and JSON as they are, numbers shortest round-trip,
+// bools as true/false; empty when unset
+BodyBuffer variableText(const VariableValue& value);
@@ -0,0 +1,346 @@
+#include "async_http_client.h"
+#include "curl_share.h"
+#include <curl/curl.h>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <algorithm>
+#include <unordered_set>
+#include <stdio.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Idle easy handles kept per loop; the connections themselves live in the
+// multi handle's cache, so these only save the allocation
+constexpr size_t MAX_IDLE_HANDLES = 256;
+
+struct Transfer {
+    HttpRequest request;
+    HttpTransfer state;
+    AsyncHttpClient::Callback callback;
+    const std::atomic<bool>* cancel_flag = nullptr;
+    CURL* curl = nullptr;
+};
+
+struct Timer {
+    Clock::time_point due;
+    // Keeps timers with the same deadline in posting order
+    uint64_t sequence;
+    std::function<void()> task;
+
+    bool operator>(const Timer& other) const {
+        return due != other.due ? due > other.due : sequence > other.sequence;
+    }
+};
+
+} // namespace
+
+class AsyncHttpClient::Loop {
+public:
+    Loop(std::atomic<size_t>& in_flight, const HttpOptions& options, HttpVersionPolicy& versions,
+         SpareRequests& spares);
+    // Fails whatever is still queued or running; stop() must have been called
+    ~Loop();
+
+    void stop();
+
+    void submit(std::unique_ptr<Transfer> transfer);
+    void post(std::function<void()> task, Clock::time_point due);
+
+private:
+    CURLM* multi = nullptr;
+    std::thread thread;
+    std::atomic<size_t>& in_flight;
+    HttpVersionPolicy& versions;
+    SpareRequests& spares;
+    const HttpOptions options;
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Transfer>> incoming;
+    std::vector<Timer> incoming_timers;
+    uint64_t next_sequence = 0;
+    bool stopping = false;
+
+    // Only touched by the loop thread (and by the destructor after joining)
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    std::unordered_set<Transfer*> active;
+    std::vector<CURL*> idle_handles;
+
+    void run();
+    void start(std::unique_ptr<Transfer> transfer);
+    bool add(Transfer* transfer, HttpVersion version);
+    void complete(Transfer* transfer, CURLcode result);
+    void fail(std::unique_ptr<Transfer> transfer, const std::string& message);
+    void recycle(Transfer& transfer);
+    int runDueTimers();
+};
+
+AsyncHttpClient::Loop::Loop(std::atomic<size_t>& in_flight, const HttpOptions& options, HttpVersionPolicy& versions,
+                            SpareRequests& spares)
+    : in_flight(in_flight), versions(versions), spares(spares), options(options) {
+    multi = curl_multi_init();
+    if (!multi) {
+        printf("Failed to initialize CURL multi handle\n");
+    } else if (options.version != HttpVersion::Http1) {
+        curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(multi, CURLMOPT_MAX_CONCURRENT_STREAMS, std::max(1L, options.max_concurrent_streams));
+    }
+    thread = std::thread(&Loop::run, this);
+}
+
+void AsyncHttpClient::Loop::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    if (multi) curl_multi_wakeup(multi);
+    if (thread.joinable()) thread.join();
+}
+
+AsyncHttpClient::Loop::~Loop() {
+    stop();
+
+    // Nothing runs concurrently any more; fail whatever is left so every
+    // callback (and future) still fires exactly once
+    std::vector<Transfer*> remaining(active.begin(), active.end());
+    for (Transfer* transfer : remaining) {
+        transfer->state.response.error_message = "HTTP client shut down";
+        complete(transfer, CURLE_ABORTED_BY_CALLBACK);
+    }
+    std::vector<std::unique_ptr<Transfer>> queued;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.swap(incoming);
+    }
+    for (auto& transfer : queued) {
+        fail(std::move(transfer), "HTTP client shut down");
+    }
+
+    for (CURL* curl : idle_handles) {
+        curl_easy_cleanup(curl);
+    }
+    if (multi) curl_multi_cleanup(multi);
+}
+
+void AsyncHttpClient::Loop::submit(std::unique_ptr<Transfer> transfer) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!stopping) {
+            incoming.push_back(std::move(transfer));
+        }
+    }
+    if (transfer) {
+        fail(std::move(transfer), "HTTP client shut down");
+        return;
+    }
+    curl_multi_wakeup(multi);
+}
+
+void AsyncHttpClient::Loop::post(std::function<void()> task, Clock::time_point due) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) return;
+        incoming_timers.push_back({due, next_sequence++, std::move(task)});
+    }
+    curl_multi_wakeup(multi);
+}
+
+void AsyncHttpClient::Loop::run() {
+    if (!multi) return;
+
+    std::vector<std::unique_ptr<Transfer>> adding;
+    std::vector<Timer> new_timers;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return;
+            adding.swap(incoming);
+            new_timers.swap(incoming_timers);
+        }
+        for (auto& timer : new_timers) {
+            timers.push(std::move(timer));
+        }
+        new_timers.clear();
+        for (auto& transfer : adding) {
+            start(std::move(transfer));
+        }
+        adding.clear();
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        int queued = 0;
+        while (CURLMsg* message = curl_multi_info_read(multi, &queued)) {
+            if (message->msg != CURLMSG_DONE) continue;
+            // The message is invalid once its handle is removed
+            CURL* curl = message->easy_handle;
+            CURLcode result = message->data.result;
+            Transfer* transfer = nullptr;
+            curl_easy_getinfo(curl, CURLINFO_PRIVATE, &transfer);
+            complete(transfer, result);
+        }
+
+        int timeout_ms = runDueTimers();
+        curl_multi_poll(multi, nullptr, 0, timeout_ms, nullptr);
+    }
+}
+
+void AsyncHttpClient::Loop::start(std::unique_ptr<Transfer> transfer) {
+    CURL* curl = nullptr;
+    if (!idle_handles.empty()) {
+        curl = idle_handles.back();
+        idle_handles.pop_back();
+    } else {
+        curl = curl_easy_init();
+    }
+    if (!curl) {
+        fail(std::move(transfer), "Failed to initialize CURL");
+        return;
+    }
+
+    transfer->curl = curl;
+    if (!add(transfer.get(), versions.versionFor(transfer->request.url))) {
+        curl_easy_reset(curl);
+        idle_handles.push_back(curl);
+        fail(std::move(transfer), "Failed to add transfer to CURL multi handle");
+        return;
+    }
+    active.insert(transfer.release());
+}
+
+bool AsyncHttpClient::Loop::add(Transfer* transfer, HttpVersion version) {
+    transfer->state.prepare(transfer->curl, transfer->request, transfer->cancel_flag, version, options);
+    curl_easy_setopt(transfer->curl, CURLOPT_PRIVATE, transfer);
+    return curl_multi_add_handle(multi, transfer->curl) == CURLM_OK;
+}
+
+void AsyncHttpClient::Loop::complete(Transfer* raw, CURLcode result) {
+    CURL* curl = raw->curl;
+    curl_multi_remove_handle(multi, curl);
+
+    // Same request again over HTTP/1.1; it stays in the active set
+    if (result != CURLE_OK && versions.fallBack(curl, raw->request, result)) {
+        curl_easy_reset(curl);
+        raw->state.reset();
+        if (add(raw, HttpVersion::Http1)) return;
+        result = CURLE_FAILED_INIT;
+    }
+    if (result == CURLE_OK) versions.succeeded(raw->request.url);
+
+    std::unique_ptr<Transfer> transfer(raw);
+    active.erase(raw);
+    std::string shutdown_message = transfer->state.response.error_message;
+    transfer->state.finish(curl, result);
+    if (!shutdown_message.empty()) {
+        transfer->state.response.error_message = shutdown_message;
+    }
+
+    // Drops the options but keeps the handle for the next request
+    curl_easy_reset(curl);
+    if (idle_handles.size() < MAX_IDLE_HANDLES) {
+        idle_handles.push_back(curl);
+    } else {
+        curl_easy_cleanup(curl);
+    }
+
+    // Before the callback, so that a caller waiting on it finds its own
+    // request back
+    recycle(*transfer);
+    in_flight.fetch_sub(1, std::memory_order_relaxed);
+    transfer->callback(std::move(transfer->state.response));
+}
+
+// Keeps the request's strings for reuseRequest; the shared parts go, so
+// that a spare does not hold on to headers or paths of a removed node
+void AsyncHttpClient::Loop::recycle(Transfer& transfer) {
+    HttpRequest& request = transfer.request;
+    request.header_list.reset();
+    request.stream_paths.reset();
+    request.headers.clear();
+    std::lock_guard<std::mutex> lock(spares.mutex);
+    if (spares.requests.size() < SpareRequests::MAX_SPARE) {
+        spares.requests.push_back(std::move(request));
+    }
+}
+
+void AsyncHttpClient::Loop::fail(std::unique_ptr<Transfer> transfer, const std::string& message) {
+    HttpResponse response;
+    response.error_message = message;
+    in_flight.fetch_sub(1, std::memory_order_relaxed);
+    transfer->callback(std::move(response));
+}
+
+// Runs every timer that is due and returns how long the loop may sleep
+int AsyncHttpClient::Loop::runDueTimers() {
+    while (!timers.empty()) {
+        auto now = Clock::now();
+        const Timer& next = timers.top();
+        if (next.due > now) {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next.due - now).count() + 1;
+            return static_cast<int>(std::min<long long>(wait, 1000));
+        }
+        // Move the task out before popping; it may post new timers
+        std::function<void()> task = std::move(const_cast<Timer&>(next).task);
+        timers.pop();
+        task();
+    }
+    return 1000;
+}
+
+AsyncHttpClient::AsyncHttpClient(size_t loop_count, const HttpOptions& options) : http_options(options) {
+    CurlShare::instance();
+    versions.setVersion(options.version);
+    if (loop_count == 0) loop_count = 1;
+    loops.reserve(loop_count);
+    for (size_t i = 0; i < loop_count; i++) {
+        loops.push_back(std::make_unique<Loop>(in_flight, http_options, versions, spares));
+    }
+}
+
+AsyncHttpClient::~AsyncHttpClient() {
+    closed = true;
+    for (auto& loop : loops) {
+        loop->stop();
+    }
+    loops.clear();
+}
+
+AsyncHttpClient::Loop& AsyncHttpClient::pickLoop() {
+    return *loops[next_loop.fetch_add(1, std::memory_order_relaxed) % loops.size()];
+}
+
+void AsyncHttpClient::submit(HttpRequest request, Callback callback, const std::atomic<bool>* cancel_flag) {
+    auto transfer = std::make_unique<Transfer>();
+    transfer->request = std::move(request);
+    transfer->callback = std::move(callback);
+    transfer->cancel_flag = cancel_flag;
+    if (closed) {
+        HttpResponse response;
+        response.error_message = "HTTP client shut down";
+        transfer->callback(std::move(response));
+        return;
+    }
+    in_flight.fetch_add(1, std::memory_order_relaxed);
+    pickLoop().submit(std::move(transfer));
+}
+
+std::future<HttpResponse> AsyncHttpClient::submit(HttpRequest request, const std::atomic<bool>* cancel_flag) {
+    auto promise = std::make_shared<std::promise<HttpResponse>>();
+    std::future<HttpResponse> future = promise->get_future();
+    submit(std::move(request), [promise](HttpResponse&& response) { promise->set_value(std::move(response)); }, cancel_flag);
+    return future;
+}
+
+void AsyncHttpClient::reuseRequest(HttpRequest& request) {
+    std::lock_guard<std::mutex> lock(spares.mutex);
+    if (spares.requests.empty()) return;
+    request = std::move(spares.requests.back());
+    spares.requests.pop_back();
+}
+
+void AsyncHttpClient::post(std::function<void()> task, std::chrono::milliseconds delay) {
+    if (closed) return;
+    pickLoop().post(std::move(task), Clock::now() + delay);
+}
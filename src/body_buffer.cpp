@@ -0,0 +1,142 @@
+#include "body_buffer.h"
+#include <cstdlib>
+#include <new>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+BodyBuffer::BodyBuffer(std::string text) {
+    if (text.empty()) return;
+    auto owned = std::make_shared<const std::string>(std::move(text));
+    bytes = owned->data();
+    length = owned->size();
+    owner = std::move(owned);
+}
+
+BodyBuilder::~BodyBuilder() {
+    clear();
+}
+
+void BodyBuilder::reserve(size_t expected) {
+    // A body announced above the threshold goes to disk from the first byte
+    if (spool_threshold > 0 && expected > spool_threshold) {
+        if (fd < 0) spool();
+        return;
+    }
+    bytes.reserve(expected < MAX_RESERVE ? expected : MAX_RESERVE);
+}
+
+bool BodyBuilder::append(const char* data, size_t length) {
+    if (fd < 0 && spool_threshold > 0 && bytes.size() + length > spool_threshold) {
+        spool();
+    }
+    if (fd < 0) {
+        bytes.append(data, length);
+        return true;
+    }
+
+    while (length > 0) {
+        ssize_t written = ::write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            printf("Failed to write response spool file: %s\n", strerror(errno));
+            return false;
+        }
+        data += written;
+        length -= static_cast<size_t>(written);
+        spooled += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+void BodyBuilder::clear() {
+    std::string().swap(bytes);
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    spooled = 0;
+}
+
+// Moves what was received so far into an anonymous temp file. On failure
+// the body simply stays in memory.
+bool BodyBuilder::spool() {
+    const char* dir = std::getenv("TMPDIR");
+    std::string path = std::string(dir && *dir ? dir : "/tmp") + "/untangle-body-XXXXXX";
+    int file = ::mkstemp(path.data());
+    if (file < 0) {
+        printf("Failed to create response spool file: %s\n", strerror(errno));
+        return false;
+    }
+    // Gone from the directory right away; the space is freed with the last
+    // mapping even if the process crashes
+    ::unlink(path.c_str());
+
+    fd = file;
+    std::string pending;
+    pending.swap(bytes);
+    if (!pending.empty() && !append(pending.data(), pending.size())) {
+        ::close(fd);
+        fd = -1;
+        bytes.swap(pending);
+        return false;
+    }
+    return true;
+}
+
+bool BodyBuilder::finish(BodyBuffer& body) {
+    body = BodyBuffer();
+    if (fd < 0) {
+        body = BodyBuffer(std::move(bytes));
+        return true;
+    }
+
+    bool success = true;
+    if (spooled > 0) {
+        void* mapping = ::mmap(nullptr, spooled, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            ::madvise(mapping, spooled, MADV_SEQUENTIAL);
+            size_t size = spooled;
+            body.owner = std::shared_ptr<const void>(mapping, [size](const void* address) {
+                ::munmap(const_cast<void*>(address), size);
+            });
+            body.bytes = static_cast<const char*>(mapping);
+            body.length = spooled;
+            body.mapped = true;
+        } else {
+            printf("Failed to map response spool file: %s\n", strerror(errno));
+            success = readBack(body);
+        }
+    }
+    // The mapping keeps the file alive on its own
+    clear();
+    return success;
+}
+
+// Fallback when the spool file cannot be mapped: its bytes are read back
+// into memory
+bool BodyBuilder::readBack(BodyBuffer& body) {
+    std::string text;
+    try {
+        text.resize(spooled);
+    } catch (const std::bad_alloc&) {
+        printf("Failed to read back response spool file: %zu bytes do not fit in memory\n", spooled);
+        return false;
+    }
+
+    size_t offset = 0;
+    while (offset < spooled) {
+        ssize_t count = ::pread(fd, text.data() + offset, spooled - offset, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            printf("Failed to read back response spool file: %s\n", count < 0 ? strerror(errno) : "unexpected end of file");
+            return false;
+        }
+        offset += static_cast<size_t>(count);
+    }
+    body = BodyBuffer(std::move(text));
+    return true;
+}
@@ -0,0 +1,422 @@
+// Headless runner: loads untangle.db and executes one orchestration without
+// SDL/OpenGL. Results go to stdout as JSON lines; everything the engine and
+// database print for humans is moved to stderr.
+#include "imgui.h"
+#include "node_editor.h"
+#include "project.h"
+#include "database.h"
+#include "json_path.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+
+FILE* out = stdout;
+
+std::string jsonString(const std::string& value) {
+  std::string result = "\"";
+  for (unsigned char c : value) {
+    switch (c) {
+      case '"': result += "\\\""; break;
+      case '\\': result += "\\\\"; break;
+      case '\n': result += "\\n"; break;
+      case '\r': result += "\\r"; break;
+      case '\t': result += "\\t"; break;
+      default:
+        if (c < 0x20) {
+          char buffer[8];
+          snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+          result += buffer;
+        } else {
+          result += static_cast<char>(c);
+        }
+    }
+  }
+  return result + "\"";
+}
+
+// Builds one JSON object field by field and writes it as a single line
+class JsonLine {
+  public:
+    explicit JsonLine(const char* event) { text = "{\"event\":" + jsonString(event); }
+
+    JsonLine& add(const char* key, const std::string& value) { return raw(key, jsonString(value)); }
+    JsonLine& add(const char* key, const char* value) { return raw(key, jsonString(value)); }
+    JsonLine& add(const char* key, bool value) { return raw(key, value ? "true" : "false"); }
+    JsonLine& add(const char* key, int value) { return raw(key, std::to_string(value)); }
+    JsonLine& add(const char* key, long long value) { return raw(key, std::to_string(value)); }
+    JsonLine& add(const char* key, uint64_t value) { return raw(key, std::to_string(value)); }
+    JsonLine& add(const char* key, double value) {
+      char buffer[32];
+      snprintf(buffer, sizeof(buffer), "%.3f", value);
+      return raw(key, buffer);
+    }
+
+    void emit() {
+      fprintf(out, "%s}\n", text.c_str());
+      fflush(out);
+    }
+
+  private:
+    std::string text;
+
+    JsonLine& raw(const char* key, const std::string& value) {
+      text += ",";
+      text += jsonString(key);
+      text += ":";
+      text += value;
+      return *this;
+    }
+};
+
+struct Options {
+  std::string db_path = "untangle.db";
+  std::string project;
+  std::string orchestration;
+  bool list = false;
+  bool load_test = false;
+  LoadTestConfig load;
+  HttpOptions http;
+  // --bench-jsonpath FILE PATH
+  std::string bench_file;
+  std::string bench_path;
+};
+
+void printUsage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options] <project> <orchestration>\n"
+          "       %s --bench-jsonpath FILE PATH [--iterations N]\n"
+          "\n"
+          "Options:\n"
+          "  --db PATH            database file (default: untangle.db)\n"
+          "  --list               list projects and orchestrations, then exit\n"
+          "  --users N            load test with N closed-loop virtual users\n"
+          "  --rate R             load test at R iterations/s (open loop)\n"
+          "  --max-in-flight N    concurrency cap for --rate (default: 100)\n"
+          "  --duration S         load test duration in seconds (default: 10)\n"
+          "  --iterations N       run N iterations instead of a duration\n"
+          "  --io-threads N       run the load test event-driven on N I/O threads\n"
+          "  --http2              use HTTP/2 where TLS negotiates it\n"
+          "  --h2c                use HTTP/2 with prior knowledge, also over http://\n"
+          "  --max-streams N      concurrent streams per HTTP/2 connection (default: 100)\n"
+          "  --compressed         request gzip/deflate/br/zstd responses\n"
+          "  --spool-mb N         map bodies above N MiB from a temp file (0: never, default: 32)\n"
+          "  --bench-jsonpath F P time JSON path P against file F (default: 1000 iterations)\n",
+          program, program);
+}
+
+bool parseArgs(int argc, char** argv, Options& options) {
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+
+    if (arg == "--list") {
+      options.list = true;
+    } else if (arg == "--db") {
+      const char* v = value();
+      if (!v) return false;
+      options.db_path = v;
+    } else if (arg == "--users") {
+      const char* v = value();
+      if (!v) return false;
+      options.load_test = true;
+      options.load.mode = LoadMode::ClosedLoop;
+      options.load.virtual_users = atoi(v);
+    } else if (arg == "--rate") {
+      const char* v = value();
+      if (!v) return false;
+      options.load_test = true;
+      options.load.mode = LoadMode::ArrivalRate;
+      options.load.arrival_rate = atof(v);
+    } else if (arg == "--max-in-flight") {
+      const char* v = value();
+      if (!v) return false;
+      options.load.max_in_flight = atoi(v);
+    } else if (arg == "--duration") {
+      const char* v = value();
+      if (!v) return false;
+      options.load.duration_s = atof(v);
+    } else if (arg == "--iterations") {
+      const char* v = value();
+      if (!v) return false;
+      options.load.iterations = atoll(v);
+    } else if (arg == "--http2") {
+      options.http.version = HttpVersion::Http2;
+    } else if (arg == "--h2c") {
+      options.http.version = HttpVersion::Http2PriorKnowledge;
+    } else if (arg == "--compressed") {
+      options.http.compression = true;
+    } else if (arg == "--spool-mb") {
+      const char* v = value();
+      if (!v) return false;
+      options.http.spool_threshold = static_cast<size_t>(atol(v)) << 20;
+    } else if (arg == "--max-streams") {
+      const char* v = value();
+      if (!v) return false;
+      options.http.max_concurrent_streams = atol(v);
+    } else if (arg == "--io-threads") {
+      const char* v = value();
+      if (!v) return false;
+      options.load.io_threads = atoi(v);
+    } else if (arg == "--bench-jsonpath") {
+      const char* file = value();
+      const char* path = value();
+      if (!file || !path) return false;
+      options.bench_file = file;
+      options.bench_path = path;
+    } else if (arg.rfind("--", 0) == 0) {
+      return false;
+    } else {
+      positional.push_back(arg);
+    }
+  }
+
+  if (options.list) return true;
+  if (!options.bench_file.empty()) return positional.empty();
+  if (positional.size() != 2) return false;
+  options.project = positional[0];
+  options.orchestration = positional[1];
+  return true;
+}
+
+const Orchestration* findOrchestration(const ProjectManager& projects, const Options& options) {
+  for (const auto& project : projects.getProjects()) {
+    if (project->name != options.project) continue;
+    for (const auto& orchestration : project->orchestrations) {
+      if (orchestration->name == options.orchestration) return orchestration.get();
+    }
+  }
+  return nullptr;
+}
+
+void emitLoadStats(JsonLine& line, const LoadTestStats& stats) {
+  line.add("iterations", stats.iterations)
+      .add("failed_iterations", stats.failed_iterations)
+      .add("dropped_iterations", stats.dropped_iterations)
+      .add("requests", stats.requests)
+      .add("failed_requests", stats.failed_requests)
+      .add("in_flight", stats.active_users)
+      .add("elapsed_s", stats.elapsed_s)
+      .add("iterations_per_s", stats.iterationsPerSecond())
+      .add("requests_per_s", stats.requestsPerSecond())
+      .add("request_error_rate", stats.requestErrorRate());
+}
+
+void emitLatency(JsonLine& line, const LatencySummary& latency) {
+  line.add("count", latency.count)
+      .add("mean_us", latency.mean_us)
+      .add("p50_us", latency.p50_us)
+      .add("p90_us", latency.p90_us)
+      .add("p99_us", latency.p99_us)
+      .add("p999_us", latency.p999_us)
+      .add("max_us", latency.max_us);
+}
+
+// Times a JSON path against a file the way JSON Extract nodes use it:
+// compiled once, then matched on every run. Compiling on every run is
+// reported too, as the cost the cached program saves.
+int benchJsonPath(const Options& options) {
+  std::ifstream file(options.bench_file, std::ios::binary);
+  if (!file) {
+    JsonLine("error").add("message", "cannot read file").add("path", options.bench_file).emit();
+    return 2;
+  }
+  std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  JsonPath path;
+  std::string error;
+  if (!path.compile(options.bench_path, error)) {
+    JsonLine("error").add("message", "invalid JSON path: " + error).add("path", options.bench_path).emit();
+    return 2;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  long long iterations = options.load.iterations > 0 ? options.load.iterations : 1000;
+  auto nanosPerRun = [&](Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+  };
+
+  Clock::time_point start = Clock::now();
+  for (long long i = 0; i < iterations; i++) {
+    JsonPath compiled;
+    compiled.compile(options.bench_path, error);
+  }
+  double compile_ns = nanosPerRun(start);
+
+  // Same calls as the node: first match for singular paths, all otherwise
+  std::vector<JsonValue> values;
+  JsonValue value;
+  long long matches = 0;
+  start = Clock::now();
+  for (long long i = 0; i < iterations; i++) {
+    if (path.isSingular()) {
+      matches += extractJson(json, path, value) ? 1 : 0;
+    } else {
+      values.clear();
+      extractJsonAll(json, path, values);
+      matches += static_cast<long long>(values.size());
+    }
+  }
+  double extract_ns = nanosPerRun(start);
+
+  JsonLine("jsonpath_bench")
+      .add("path", options.bench_path)
+      .add("kernel", jsonScannerKernel())
+      .add("bytes", static_cast<uint64_t>(json.size()))
+      .add("iterations", iterations)
+      .add("matches_per_run", static_cast<double>(matches) / iterations)
+      .add("compile_ns", compile_ns)
+      .add("extract_ns", extract_ns)
+      .add("compile_and_extract_ns", compile_ns + extract_ns)
+      .add("mb_per_s", extract_ns > 0 ? json.size() / extract_ns * 1000.0 : 0.0)
+      .emit();
+  return 0;
+}
+
+int run(const Options& options) {
+  ProjectManager project_manager;
+  NodeEditor node_editor;
+  Database database;
+
+  if (!node_editor.initialize() || !database.initialize(options.db_path, false)) {
+    JsonLine("error").add("message", "failed to open database").add("path", options.db_path).emit();
+    return 2;
+  }
+  if (!database.loadAll(project_manager, node_editor)) {
+    JsonLine("error").add("message", "failed to load database").add("path", options.db_path).emit();
+    return 2;
+  }
+
+  if (options.list) {
+    for (const auto& project : project_manager.getProjects()) {
+      for (const auto& orchestration : project->orchestrations) {
+        JsonLine("orchestration")
+            .add("project", project->name)
+            .add("orchestration", orchestration->name)
+            .add("orchestration_id", orchestration->id)
+            .emit();
+      }
+    }
+    return 0;
+  }
+
+  const Orchestration* orchestration = findOrchestration(project_manager, options);
+  if (!orchestration) {
+    JsonLine("error")
+        .add("message", "orchestration not found")
+        .add("project", options.project)
+        .add("orchestration", options.orchestration)
+        .emit();
+    return 2;
+  }
+
+  RunRequest request;
+  request.plan = node_editor.getPlan(orchestration->id);
+  if (!request.plan) {
+    JsonLine("error").add("message", "orchestration has no nodes").add("orchestration_id", orchestration->id).emit();
+    return 1;
+  }
+  request.load_test = options.load_test;
+  request.load_config = options.load;
+
+  const char* mode = !options.load_test ? "single"
+      : options.load.mode == LoadMode::ArrivalRate ? "arrival_rate" : "closed_loop";
+  JsonLine("run")
+      .add("project", options.project)
+      .add("orchestration", options.orchestration)
+      .add("orchestration_id", orchestration->id)
+      .add("mode", mode)
+      .emit();
+
+  ExecutionEngine& engine = node_editor.getEngine();
+  engine.setHttpOptions(options.http);
+  int run_id = engine.submit(std::move(request));
+  while (!engine.waitForRun(run_id, std::chrono::seconds(1))) {
+    RunStatus status = engine.getStatus();
+    if (options.load_test && status.run_id == run_id && status.load_stats.elapsed_s > 0) {
+      JsonLine line("progress");
+      emitLoadStats(line, status.load_stats);
+      line.emit();
+    }
+  }
+  RunStatus status = engine.getStatus();
+
+  if (!options.load_test) {
+    std::istringstream log(engine.getExecutionLog());
+    std::string message;
+    while (std::getline(log, message)) {
+      JsonLine("log").add("message", message).emit();
+    }
+  }
+
+  for (const NodeLatency& node : engine.getNodeLatency(orchestration->id)) {
+    JsonLine line("node");
+    line.add("node_id", node.node_id).add("type", node.type);
+    emitLatency(line, node.summary);
+    line.add("dns_us", node.phases.dns_us)
+        .add("connect_us", node.phases.connect_us)
+        .add("tls_us", node.phases.tls_us)
+        .add("server_us", node.phases.server_us)
+        .add("transfer_us", node.phases.transfer_us)
+        .add("bytes_sent", node.phases.bytes_sent)
+        .add("bytes_received", node.phases.bytes_received)
+        .add("bytes_decoded", node.phases.bytes_decoded)
+        .add("reused", node.phases.reused)
+        .emit();
+  }
+
+  bool success = status.run_id == run_id && status.state == RunState::Succeeded;
+  JsonLine result("result");
+  result.add("state", runStateName(status.state))
+      .add("success", success)
+      .add("elapsed_ms", status.elapsed_ms)
+      .add("nodes_executed", status.nodes_executed);
+  if (options.load_test) {
+    emitLoadStats(result, status.load_stats);
+    JsonLine latency("latency");
+    emitLatency(latency, status.load_stats.latency);
+    latency.emit();
+  }
+  result.emit();
+
+  return success ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseArgs(argc, argv, options)) {
+    printUsage(argv[0]);
+    return 2;
+  }
+
+  // Keep the real stdout for JSON and send the human-oriented printf/cout
+  // output of the engine and database to stderr
+  int json_fd = dup(STDOUT_FILENO);
+  if (json_fd >= 0) {
+    if (FILE* json = fdopen(json_fd, "w")) {
+      out = json;
+      fflush(stdout);
+      dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+  }
+
+  // ImNodes keeps node positions in its own context even when nothing is
+  // drawn, so the contexts exist but no frame is ever rendered
+  ImGui::CreateContext();
+  int exit_code = options.bench_file.empty() ? run(options) : benchJsonPath(options);
+  ImGui::DestroyContext();
+
+  fflush(out);
+  return exit_code;
+}
@@ -0,0 +1,44 @@
+#include "curl_share.h"
+#include <stdio.h>
+
+CurlShare& CurlShare::instance() {
+    // Function-local static: initialized once even when the first clients
+    // are created on several threads at the same time
+    static CurlShare global;
+    return global;
+}
+
+CurlShare::CurlShare() {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    share = curl_share_init();
+    if (!share) {
+        printf("Failed to initialize CURL share handle\n");
+        return;
+    }
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, &CurlShare::lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, &CurlShare::unlock);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_PSL);
+}
+
+CurlShare::~CurlShare() {
+    if (share) curl_share_cleanup(share);
+    curl_global_cleanup();
+}
+
+void CurlShare::attach(CURL* curl) const {
+    if (share) curl_easy_setopt(curl, CURLOPT_SHARE, share);
+}
+
+// Every kind of shared data has its own lock, so a DNS lookup never waits
+// on a TLS session update
+void CurlShare::lock(CURL*, curl_lock_data data, curl_lock_access, void* user) {
+    static_cast<CurlShare*>(user)->locks[data].lock();
+}
+
+void CurlShare::unlock(CURL*, curl_lock_data data, void* user) {
+    static_cast<CurlShare*>(user)->locks[data].unlock();
+}
@@ -0,0 +1,316 @@
+#include "dag_scheduler.h"
+#include "thread_pool.h"
+#include "nodes.h"
+#include "latency_histogram.h"
+#include <condition_variable>
+#include <chrono>
+
+namespace {
+
+// Times one node and records it into its latency histogram, if it has one
+bool executeTimed(Node* node, uint32_t index, ExecutionContext& context) {
+    if (!context.latency) return NodeExecutor::execute(node, context);
+
+    auto started = std::chrono::steady_clock::now();
+    bool success = NodeExecutor::execute(node, context);
+    if (!context.isCancelled()) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+        context.latency->recordNode(index, static_cast<uint64_t>(elapsed.count()));
+        context.latency->recordTransfer(index, context.last_timings);
+    }
+    return success;
+}
+
+// State shared by all tasks of one run. It lives on the stack of
+// DagScheduler::run, which only returns once the last task has signalled.
+struct DagRun {
+    const ExecutionPlan& plan;
+    ThreadPool& pool;
+    const DagHooks& hooks;
+
+    std::unique_ptr<std::atomic<int32_t>[]> pending;
+    // Last taken input of each join still waiting on others, so a join whose
+    // final input comes from a skipped branch still runs with a response
+    std::unique_ptr<std::shared_ptr<ExecutionContext>[]> joined;
+    std::mutex joined_mutex;
+
+    std::atomic<int> outstanding{0};
+    // Nodes that ran or were skipped
+    std::atomic<size_t> completed{0};
+    std::atomic<bool> failed{false};
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+
+    DagRun(const ExecutionPlan& plan, ThreadPool& pool, const DagHooks& hooks)
+        : plan(plan), pool(pool), hooks(hooks),
+          pending(std::make_unique<std::atomic<int32_t>[]>(plan.nodeCount())),
+          joined(std::make_unique<std::shared_ptr<ExecutionContext>[]>(plan.nodeCount())) {
+        for (uint32_t i = 0; i < plan.nodeCount(); i++) {
+            pending[i].store(plan.initialPending(i), std::memory_order_relaxed);
+        }
+    }
+
+    void schedule(uint32_t index, std::shared_ptr<ExecutionContext> input);
+    void execute(uint32_t index, const std::shared_ptr<ExecutionContext>& input);
+    void release(uint32_t index, std::shared_ptr<ExecutionContext> output, int taken_output);
+    void finishTask();
+};
+
+void DagRun::schedule(uint32_t index, std::shared_ptr<ExecutionContext> input) {
+    outstanding.fetch_add(1, std::memory_order_relaxed);
+    pool.submit([this, index, input = std::move(input)] {
+        execute(index, input);
+        finishTask();
+    });
+}
+
+void DagRun::execute(uint32_t index, const std::shared_ptr<ExecutionContext>& input) {
+    if (failed.load(std::memory_order_relaxed) || input->isCancelled()) return;
+
+    Node* node = plan.node(index);
+    std::shared_ptr<ExecutionContext> context = input->fork();
+
+    if (hooks.on_node_started) hooks.on_node_started(*node);
+    bool success = executeTimed(node, index, *context);
+    if (hooks.on_node_finished) hooks.on_node_finished(*node, success);
+
+    completed.fetch_add(1, std::memory_order_relaxed);
+    if (!success) {
+        failed = true;
+        return;
+    }
+
+    int taken_output = context->taken_output;
+    release(index, std::move(context), taken_output);
+}
+
+// Hands a finished node's output to its successors. Links leaving from an
+// output other than the one a branching node took are not followed. A node
+// none of whose inputs were followed is skipped, and so, in turn, are the
+// nodes only it leads to.
+void DagRun::release(uint32_t index, std::shared_ptr<ExecutionContext> output, int taken_output) {
+    std::vector<uint32_t> skipped;
+    for (;;) {
+        const uint32_t* begin = plan.successorsBegin(index);
+        const int* pins = plan.successorPins(index);
+        for (const uint32_t* it = begin; it != plan.successorsEnd(index); ++it) {
+            uint32_t next = *it;
+            bool taken = output && (taken_output < 0 || pins[it - begin] == taken_output);
+            bool join = plan.initialPending(next) > 1;
+            if (taken && join) {
+                std::lock_guard<std::mutex> lock(joined_mutex);
+                joined[next] = output;
+            }
+            if (pending[next].fetch_sub(1, std::memory_order_acq_rel) != 1) continue;
+
+            // The input that completes a join last is the one whose response
+            // the joined node sees, unless that input was skipped
+            std::shared_ptr<ExecutionContext> input = taken ? output : nullptr;
+            if (join) {
+                std::lock_guard<std::mutex> lock(joined_mutex);
+                if (!input) input = std::move(joined[next]);
+                joined[next].reset();
+            }
+            if (input) {
+                schedule(next, std::move(input));
+            } else {
+                completed.fetch_add(1, std::memory_order_relaxed);
+                skipped.push_back(next);
+            }
+        }
+
+        if (skipped.empty()) return;
+        index = skipped.back();
+        skipped.pop_back();
+        output.reset();
+    }
+}
+
+void DagRun::finishTask() {
+    // Decrement under the lock so run() cannot return (and destroy this
+    // object) between the last decrement and the notify
+    std::lock_guard<std::mutex> lock(done_mutex);
+    if (outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        done_cv.notify_all();
+    }
+}
+
+} // namespace
+
+bool DagScheduler::run(const ExecutionPlan& plan, ExecutionContext& context, const DagHooks& hooks) {
+    if (plan.startIndex() == ExecutionPlan::npos) {
+        context.log("ERROR: No Start node found in orchestration");
+        return false;
+    }
+
+    if (plan.blockedCount() > 0) {
+        context.log("WARNING: " + std::to_string(plan.blockedCount()) +
+                    " node(s) are on a cycle and will never run");
+    }
+
+    DagRun run(plan, pool, hooks);
+
+    // The caller's context is not owned by the run, so hand it in through a
+    // non-owning shared_ptr
+    std::shared_ptr<ExecutionContext> root(std::shared_ptr<ExecutionContext>(), &context);
+    run.schedule(plan.startIndex(), root);
+
+    {
+        std::unique_lock<std::mutex> lock(run.done_mutex);
+        run.done_cv.wait(lock, [&run] { return run.outstanding.load(std::memory_order_acquire) == 0; });
+    }
+
+    if (run.failed || context.isCancelled()) {
+        return false;
+    }
+
+    size_t completed = run.completed.load();
+    if (completed < plan.reachableCount()) {
+        context.log("ERROR: " + std::to_string(plan.reachableCount() - completed) +
+                    " node(s) never became ready, check the graph for cycles");
+        return false;
+    }
+
+    return true;
+}
+
+bool InlineScheduler::begin(const ExecutionPlan& run_plan, ExecutionContext& run_context) {
+    if (run_plan.startIndex() == ExecutionPlan::npos) {
+        EXEC_TRACE(run_context, TRACE_ERROR, "ERROR: No Start node found in orchestration");
+        return false;
+    }
+
+    plan = &run_plan;
+    context = &run_context;
+    position = 0;
+    current = ExecutionPlan::npos;
+    input_of.assign(run_plan.nodeCount(), ExecutionPlan::npos);
+    outputs.resize(run_plan.nodeCount());
+    return true;
+}
+
+// Moves past nodes none of whose inputs were taken, i.e. those on a branch
+// an If or Assert node did not take
+void InlineScheduler::skipUntaken() {
+    const std::vector<uint32_t>& order = plan->topologicalOrder();
+    while (position < order.size() && input_of[order[position]] == ExecutionPlan::npos &&
+           order[position] != plan->startIndex()) {
+        position++;
+    }
+}
+
+// In a plain chain the next node's input is exactly what sits in the
+// context, so nothing has to be restored
+void InlineScheduler::restoreInput(uint32_t index) {
+    context->taken_output = -1;
+    uint32_t input = input_of[index];
+    if (input != ExecutionPlan::npos && input != current) {
+        context->last_response_body = outputs[input].body;
+        context->streamed_values = outputs[input].streamed;
+        context->last_status_code = outputs[input].status_code;
+    }
+}
+
+void InlineScheduler::advance(uint32_t index) {
+    current = index;
+    const std::vector<uint32_t>& order = plan->topologicalOrder();
+    position++;
+
+    const uint32_t* begin = plan->successorsBegin(index);
+    const uint32_t* end = plan->successorsEnd(index);
+    if (begin == end) return;
+
+    const int* pins = plan->successorPins(index);
+    int taken_output = context->taken_output;
+    for (const uint32_t* it = begin; it != end; ++it) {
+        if (taken_output < 0 || pins[it - begin] == taken_output) {
+            input_of[*it] = index;
+        }
+    }
+    // A saved copy is only needed when the output is not consumed right
+    // away by the next node in order (fan-outs, interleaved branches)
+    uint32_t next = position < order.size() ? order[position] : ExecutionPlan::npos;
+    if (end - begin > 1 || *begin != next) {
+        outputs[index].body = context->last_response_body;
+        outputs[index].streamed = context->streamed_values;
+        outputs[index].status_code = context->last_status_code;
+    }
+}
+
+bool InlineScheduler::run(const ExecutionPlan& run_plan, ExecutionContext& run_context) {
+    if (!begin(run_plan, run_context)) return false;
+
+    const std::vector<uint32_t>& order = plan->topologicalOrder();
+    while (skipUntaken(), position < order.size()) {
+        if (context->isCancelled()) return false;
+
+        uint32_t index = order[position];
+        restoreInput(index);
+        if (!executeTimed(plan->node(index), index, *context)) {
+            return false;
+        }
+        advance(index);
+    }
+
+    return true;
+}
+
+void InlineScheduler::runAsync(const ExecutionPlan& run_plan, ExecutionContext& run_context,
+                               std::function<void(bool)> on_done) {
+    if (!begin(run_plan, run_context)) {
+        on_done(false);
+        return;
+    }
+    done = std::move(on_done);
+    step();
+}
+
+// Runs nodes until one has to wait. Nodes that complete inline are handled
+// in this loop rather than from their callback, so long chains of quick
+// nodes do not grow the stack.
+void InlineScheduler::step() {
+    const std::vector<uint32_t>& order = plan->topologicalOrder();
+    while (true) {
+        skipUntaken();
+        if (position >= order.size()) return finish(true);
+        if (context->isCancelled()) return finish(false);
+
+        uint32_t index = order[position];
+        restoreInput(index);
+
+        node_started = std::chrono::steady_clock::now();
+        phase.store(Dispatching);
+        plan->node(index)->executeAsync(*context, [this](bool success) {
+            node_result = success;
+            // Still inside executeAsync: the loop below picks it up
+            if (phase.exchange(Completed) == Dispatching) return;
+            if (completeNode()) step();
+        });
+        // Not finished yet: the callback continues the walk
+        if (phase.exchange(Waiting) == Dispatching) return;
+        if (!completeNode()) return;
+    }
+}
+
+bool InlineScheduler::completeNode() {
+    uint32_t index = plan->topologicalOrder()[position];
+    if (context->latency && !context->isCancelled()) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - node_started);
+        context->latency->recordNode(index, static_cast<uint64_t>(elapsed.count()));
+        context->latency->recordTransfer(index, context->last_timings);
+    }
+
+    if (!node_result) {
+        finish(false);
+        return false;
+    }
+    advance(index);
+    return true;
+}
+
+void InlineScheduler::finish(bool success) {
+    // The callback may start the next run on this scheduler right away
+    std::function<void(bool)> callback = std::move(done);
+    done = nullptr;
+    if (callback) callback(success);
+}
@@ -10,8 +10,9 @@ Database::~Database() {
     close();
 }
 
-bool Database::initialize(const std::string& db_path) {
-    int rc = sqlite3_open(db_path.c_str(), &db);
+bool Database::initialize(const std::string& db_path, bool create) {
+    int flags = SQLITE_OPEN_READWRITE | (create ? SQLITE_OPEN_CREATE : 0);
+    int rc = sqlite3_open_v2(db_path.c_str(), &db, flags, nullptr);
     if (rc != SQLITE_OK) {
         printf("Failed to open database: %s\n", sqlite3_errmsg(db));
         return false;
@@ -44,24 +45,28 @@ bool Database::createTables() {
         );
     )";
     
+    // Node and link ids restart in every orchestration, so rows are keyed
+    // by both
     const char* sql_nodes = R"(
         CREATE TABLE IF NOT EXISTS nodes (
-            id INTEGER PRIMARY KEY,
+            id INTEGER NOT NULL,
             orchestration_id INTEGER NOT NULL,
             type TEXT NOT NULL,
             pos_x REAL NOT NULL,
             pos_y REAL NOT NULL,
             data TEXT,
+            PRIMARY KEY (orchestration_id, id),
             FOREIGN KEY (orchestration_id) REFERENCES orchestrations(id) ON DELETE CASCADE
         );
     )";
     
     const char* sql_links = R"(
         CREATE TABLE IF NOT EXISTS links (
-            id INTEGER PRIMARY KEY,
+            id INTEGER NOT NULL,
             orchestration_id INTEGER NOT NULL,
             start_attr INTEGER NOT NULL,
             end_attr INTEGER NOT NULL,
+            PRIMARY KEY (orchestration_id, id),
             FOREIGN KEY (orchestration_id) REFERENCES orchestrations(id) ON DELETE CASCADE
         );
     )";
@@ -80,27 +85,82 @@ bool Database::createTables() {
         return false;
     }
     
+    // Databases from before schema version 1 keyed nodes and links by id
+    // alone; their tables are moved aside and copied into the new ones
+    bool migrate_row_keys = schemaVersion() < 1 && tableExists("nodes");
+    if (migrate_row_keys) {
+        if (!execute("BEGIN TRANSACTION;", "start migration") ||
+            !execute("ALTER TABLE nodes RENAME TO nodes_v0;", "migrate nodes table") ||
+            !execute("ALTER TABLE links RENAME TO links_v0;", "migrate links table")) {
+            execute("ROLLBACK;", "roll back migration");
+            return false;
+        }
+    }
+    
     if (sqlite3_exec(db, sql_nodes, nullptr, nullptr, &err_msg) != SQLITE_OK) {
         printf("Failed to create nodes table: %s\n", err_msg);
         sqlite3_free(err_msg);
+        if (migrate_row_keys) execute("ROLLBACK;", "roll back migration");
         return false;
     }
     
     if (sqlite3_exec(db, sql_links, nullptr, nullptr, &err_msg) != SQLITE_OK) {
         printf("Failed to create links table: %s\n", err_msg);
         sqlite3_free(err_msg);
+        if (migrate_row_keys) execute("ROLLBACK;", "roll back migration");
         return false;
     }
     
+    if (migrate_row_keys) {
+        if (!execute("INSERT OR IGNORE INTO nodes (id, orchestration_id, type, pos_x, pos_y, data) "
+                     "SELECT id, orchestration_id, type, pos_x, pos_y, data FROM nodes_v0;", "migrate nodes") ||
+            !execute("INSERT OR IGNORE INTO links (id, orchestration_id, start_attr, end_attr) "
+                     "SELECT id, orchestration_id, start_attr, end_attr FROM links_v0;", "migrate links") ||
+            !execute("DROP TABLE nodes_v0; DROP TABLE links_v0;", "drop old tables") ||
+            !execute("PRAGMA user_version = 1;", "set schema version") ||
+            !execute("COMMIT;", "commit migration")) {
+            execute("ROLLBACK;", "roll back migration");
+            return false;
+        }
+    } else if (schemaVersion() < 1) {
+        execute("PRAGMA user_version = 1;", "set schema version");
+    }
+    
     return true;
 }
 
-bool Database::clearTable(const std::string& table_name) {
-    std::string sql = "DELETE FROM " + table_name + ";";
+int Database::schemaVersion() {
+    sqlite3_stmt* stmt = nullptr;
+    int version = 0;
+    
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        version = sqlite3_column_int(stmt, 0);
+    }
+    
+    sqlite3_finalize(stmt);
+    return version;
+}
+
+bool Database::tableExists(const char* table_name) {
+    const char* sql = "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ?;";
+    sqlite3_stmt* stmt = nullptr;
+    bool exists = false;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, table_name, -1, SQLITE_STATIC);
+        exists = sqlite3_step(stmt) == SQLITE_ROW;
+    }
+    
+    sqlite3_finalize(stmt);
+    return exists;
+}
+
+bool Database::execute(const char* sql, const char* action) {
     char* err_msg = nullptr;
     
-    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &err_msg) != SQLITE_OK) {
-        printf("Failed to clear table %s: %s\n", table_name.c_str(), err_msg);
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err_msg) != SQLITE_OK) {
+        printf("Failed to %s: %s\n", action, err_msg);
         sqlite3_free(err_msg);
         return false;
     }
@@ -108,104 +168,173 @@ bool Database::clearTable(const std::string& table_name) {
     return true;
 }
 
+bool Database::prepare(const char* sql, sqlite3_stmt** stmt) {
+    if (sqlite3_prepare_v2(db, sql, -1, stmt, nullptr) != SQLITE_OK) {
+        printf("Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return false;
+    }
+    
+    return true;
+}
+
+bool Database::step(sqlite3_stmt* stmt, const char* action) {
+    bool done = sqlite3_step(stmt) == SQLITE_DONE;
+    if (!done) {
+        printf("Failed to %s: %s\n", action, sqlite3_errmsg(db));
+    }
+    
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return done;
+}
+
+// Writes only what changed since the last save: new or changed projects and
+// orchestrations are upserted, and removed ones are deleted together with
+// their nodes and links (foreign keys are not enforced, so the cascade is
+// done here)
 bool Database::saveProjects(ProjectManager& project_manager) {
     if (!db) return false;
     
-    clearTable("links");
-    clearTable("nodes");
-    clearTable("orchestrations");
-    clearTable("projects");
-    
-    const char* sql_project = "INSERT INTO projects (id, name) VALUES (?, ?);";
-    const char* sql_orch = "INSERT INTO orchestrations (id, project_id, name) VALUES (?, ?, ?);";
+    const char* sql_project = "INSERT INTO projects (id, name) VALUES (?, ?) "
+                              "ON CONFLICT(id) DO UPDATE SET name = excluded.name;";
+    const char* sql_orch = "INSERT INTO orchestrations (id, project_id, name) VALUES (?, ?, ?) "
+                           "ON CONFLICT(id) DO UPDATE SET project_id = excluded.project_id, name = excluded.name;";
+    const char* sql_delete_project[] = {
+        "DELETE FROM links WHERE orchestration_id IN (SELECT id FROM orchestrations WHERE project_id = ?);",
+        "DELETE FROM nodes WHERE orchestration_id IN (SELECT id FROM orchestrations WHERE project_id = ?);",
+        "DELETE FROM orchestrations WHERE project_id = ?;",
+        "DELETE FROM projects WHERE id = ?;",
+    };
+    const char* sql_delete_orch[] = {
+        "DELETE FROM links WHERE orchestration_id = ?;",
+        "DELETE FROM nodes WHERE orchestration_id = ?;",
+        "DELETE FROM orchestrations WHERE id = ?;",
+    };
     
     sqlite3_stmt* stmt_project = nullptr;
     sqlite3_stmt* stmt_orch = nullptr;
-    
-    sqlite3_prepare_v2(db, sql_project, -1, &stmt_project, nullptr);
-    sqlite3_prepare_v2(db, sql_orch, -1, &stmt_orch, nullptr);
+    sqlite3_stmt* stmt_delete_project[4] = {};
+    sqlite3_stmt* stmt_delete_orch[3] = {};
+    
+    bool success = prepare(sql_project, &stmt_project) && prepare(sql_orch, &stmt_orch);
+    for (int i = 0; success && i < 4; i++) success = prepare(sql_delete_project[i], &stmt_delete_project[i]);
+    for (int i = 0; success && i < 3; i++) success = prepare(sql_delete_orch[i], &stmt_delete_orch[i]);
+    
+    for (int project_id : project_manager.getRemovedProjects()) {
+        if (!success) break;
+        for (sqlite3_stmt* stmt : stmt_delete_project) {
+            sqlite3_bind_int(stmt, 1, project_id);
+            success &= step(stmt, "delete project");
+        }
+    }
     
     for (const auto& project : project_manager.getProjects()) {
-        sqlite3_bind_int(stmt_project, 1, project->id);
-        sqlite3_bind_text(stmt_project, 2, project->name.c_str(), -1, SQLITE_TRANSIENT);
+        if (!success) break;
         
-        if (sqlite3_step(stmt_project) != SQLITE_DONE) {
-            printf("Failed to save project: %s\n", sqlite3_errmsg(db));
+        if (project->dirty) {
+            sqlite3_bind_int(stmt_project, 1, project->id);
+            sqlite3_bind_text(stmt_project, 2, project->name.c_str(), -1, SQLITE_TRANSIENT);
+            success &= step(stmt_project, "save project");
+        }
+        
+        for (int orch_id : project->removed_orchestrations) {
+            for (sqlite3_stmt* stmt : stmt_delete_orch) {
+                sqlite3_bind_int(stmt, 1, orch_id);
+                success &= step(stmt, "delete orchestration");
+            }
         }
-        sqlite3_reset(stmt_project);
         
         for (const auto& orch : project->orchestrations) {
+            if (!orch->dirty) continue;
             sqlite3_bind_int(stmt_orch, 1, orch->id);
             sqlite3_bind_int(stmt_orch, 2, project->id);
             sqlite3_bind_text(stmt_orch, 3, orch->name.c_str(), -1, SQLITE_TRANSIENT);
-            
-            if (sqlite3_step(stmt_orch) != SQLITE_DONE) {
-                printf("Failed to save orchestration: %s\n", sqlite3_errmsg(db));
-            }
-            sqlite3_reset(stmt_orch);
+            success &= step(stmt_orch, "save orchestration");
         }
     }
     
     sqlite3_finalize(stmt_project);
     sqlite3_finalize(stmt_orch);
+    for (sqlite3_stmt* stmt : stmt_delete_project) sqlite3_finalize(stmt);
+    for (sqlite3_stmt* stmt : stmt_delete_orch) sqlite3_finalize(stmt);
     
-    return true;
+    return success;
 }
 
 bool Database::saveNodes(NodeEditor& node_editor) {
     if (!db) return false;
     
-    clearTable("nodes");
-    
-    const char* sql = "INSERT INTO nodes (id, orchestration_id, type, pos_x, pos_y, data) VALUES (?, ?, ?, ?, ?, ?);";
+    const char* sql = "INSERT INTO nodes (id, orchestration_id, type, pos_x, pos_y, data) VALUES (?, ?, ?, ?, ?, ?) "
+                      "ON CONFLICT(orchestration_id, id) DO UPDATE SET "
+                      "type = excluded.type, pos_x = excluded.pos_x, pos_y = excluded.pos_y, data = excluded.data;";
+    const char* sql_delete = "DELETE FROM nodes WHERE orchestration_id = ? AND id = ?;";
     sqlite3_stmt* stmt = nullptr;
+    sqlite3_stmt* stmt_delete = nullptr;
     
-    sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    bool success = prepare(sql, &stmt) && prepare(sql_delete, &stmt_delete);
     
-    auto nodes_data = node_editor.getAllNodesData();
-    for (const auto& node_data : nodes_data) {
-        sqlite3_bind_int(stmt, 1, node_data.id);
-        sqlite3_bind_int(stmt, 2, node_data.orchestration_id);
-        sqlite3_bind_text(stmt, 3, node_data.type.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_double(stmt, 4, node_data.pos_x);
-        sqlite3_bind_double(stmt, 5, node_data.pos_y);
-        sqlite3_bind_text(stmt, 6, node_data.data.c_str(), -1, SQLITE_TRANSIENT);
-        
-        if (sqlite3_step(stmt) != SQLITE_DONE) {
-            printf("Failed to save node: %s\n", sqlite3_errmsg(db));
+    if (success) {
+        for (const RowKey& key : node_editor.getRemovedNodes()) {
+            sqlite3_bind_int(stmt_delete, 1, key.orchestration_id);
+            sqlite3_bind_int(stmt_delete, 2, key.id);
+            success &= step(stmt_delete, "delete node");
+        }
+    }
+    
+    if (success) {
+        auto nodes_data = node_editor.getChangedNodesData();
+        for (const auto& node_data : nodes_data) {
+            sqlite3_bind_int(stmt, 1, node_data.id);
+            sqlite3_bind_int(stmt, 2, node_data.orchestration_id);
+            sqlite3_bind_text(stmt, 3, node_data.type.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_double(stmt, 4, node_data.pos_x);
+            sqlite3_bind_double(stmt, 5, node_data.pos_y);
+            sqlite3_bind_text(stmt, 6, node_data.data.c_str(), -1, SQLITE_TRANSIENT);
+            
+            if (!(success &= step(stmt, "save node"))) break;
         }
-        sqlite3_reset(stmt);
     }
     
     sqlite3_finalize(stmt);
-    return true;
+    sqlite3_finalize(stmt_delete);
+    return success;
 }
 
 bool Database::saveLinks(NodeEditor& node_editor) {
     if (!db) return false;
     
-    clearTable("links");
-    
-    const char* sql = "INSERT INTO links (id, orchestration_id, start_attr, end_attr) VALUES (?, ?, ?, ?);";
+    const char* sql = "INSERT INTO links (id, orchestration_id, start_attr, end_attr) VALUES (?, ?, ?, ?) "
+                      "ON CONFLICT(orchestration_id, id) DO UPDATE SET "
+                      "start_attr = excluded.start_attr, end_attr = excluded.end_attr;";
+    const char* sql_delete = "DELETE FROM links WHERE orchestration_id = ? AND id = ?;";
     sqlite3_stmt* stmt = nullptr;
+    sqlite3_stmt* stmt_delete = nullptr;
     
-    sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    bool success = prepare(sql, &stmt) && prepare(sql_delete, &stmt_delete);
     
-    auto links_data = node_editor.getAllLinksData();
-    for (const auto& link_data : links_data) {
-        sqlite3_bind_int(stmt, 1, link_data.id);
-        sqlite3_bind_int(stmt, 2, link_data.orchestration_id);
-        sqlite3_bind_int(stmt, 3, link_data.start_attr);
-        sqlite3_bind_int(stmt, 4, link_data.end_attr);
-        
-        if (sqlite3_step(stmt) != SQLITE_DONE) {
-            printf("Failed to save link: %s\n", sqlite3_errmsg(db));
+    if (success) {
+        for (const RowKey& key : node_editor.getRemovedLinks()) {
+            sqlite3_bind_int(stmt_delete, 1, key.orchestration_id);
+            sqlite3_bind_int(stmt_delete, 2, key.id);
+            success &= step(stmt_delete, "delete link");
+        }
+    }
+    
+    if (success) {
+        auto links_data = node_editor.getChangedLinksData();
+        for (const auto& link_data : links_data) {
+            sqlite3_bind_int(stmt, 1, link_data.id);
+            sqlite3_bind_int(stmt, 2, link_data.orchestration_id);
+            sqlite3_bind_int(stmt, 3, link_data.start_attr);
+            sqlite3_bind_int(stmt, 4, link_data.end_attr);
+            
+            if (!(success &= step(stmt, "save link"))) break;
         }
-        sqlite3_reset(stmt);
     }
     
     sqlite3_finalize(stmt);
-    return true;
+    sqlite3_finalize(stmt_delete);
+    return success;
 }
 
 bool Database::loadProjects(ProjectManager& project_manager) {
@@ -217,10 +346,14 @@ bool Database::loadProjects(ProjectManager& project_manager) {
     sqlite3_stmt* stmt_proj = nullptr;
     sqlite3_stmt* stmt_orch = nullptr;
     
-    sqlite3_prepare_v2(db, sql_projects, -1, &stmt_proj, nullptr);
-    sqlite3_prepare_v2(db, sql_orchs, -1, &stmt_orch, nullptr);
+    if (!prepare(sql_projects, &stmt_proj) || !prepare(sql_orchs, &stmt_orch)) {
+        sqlite3_finalize(stmt_proj);
+        return false;
+    }
     
-    while (sqlite3_step(stmt_proj) == SQLITE_ROW) {
+    int rc;
+    bool success = true;
+    while ((rc = sqlite3_step(stmt_proj)) == SQLITE_ROW) {
         int proj_id = sqlite3_column_int(stmt_proj, 0);
         const char* proj_name = reinterpret_cast<const char*>(sqlite3_column_text(stmt_proj, 1));
         
@@ -228,7 +361,8 @@ bool Database::loadProjects(ProjectManager& project_manager) {
         
         sqlite3_bind_int(stmt_orch, 1, proj_id);
         
-        while (sqlite3_step(stmt_orch) == SQLITE_ROW) {
+        int orch_rc;
+        while ((orch_rc = sqlite3_step(stmt_orch)) == SQLITE_ROW) {
             int orch_id = sqlite3_column_int(stmt_orch, 0);
             const char* orch_name = reinterpret_cast<const char*>(sqlite3_column_text(stmt_orch, 1));
             
@@ -237,14 +371,19 @@ bool Database::loadProjects(ProjectManager& project_manager) {
                 proj->addOrchestrationWithId(orch_id, orch_name);
             }
         }
+        success &= orch_rc == SQLITE_DONE;
         
         sqlite3_reset(stmt_orch);
     }
+    success &= rc == SQLITE_DONE;
+    if (!success) {
+        printf("Failed to load projects: %s\n", sqlite3_errmsg(db));
+    }
     
     sqlite3_finalize(stmt_proj);
     sqlite3_finalize(stmt_orch);
     
-    return true;
+    return success;
 }
 
 bool Database::loadNodes(NodeEditor& node_editor) {
@@ -253,11 +392,12 @@ bool Database::loadNodes(NodeEditor& node_editor) {
     const char* sql = "SELECT id, orchestration_id, type, pos_x, pos_y, data FROM nodes ORDER BY orchestration_id, id;";
     sqlite3_stmt* stmt = nullptr;
     
-    sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    if (!prepare(sql, &stmt)) return false;
     
     std::vector<NodeData> nodes_data;
     
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
         NodeData node_data;
         node_data.id = sqlite3_column_int(stmt, 0);
         node_data.orchestration_id = sqlite3_column_int(stmt, 1);
@@ -273,6 +413,11 @@ bool Database::loadNodes(NodeEditor& node_editor) {
         nodes_data.push_back(node_data);
     }
     
+    if (rc != SQLITE_DONE) {
+        printf("Failed to load nodes: %s\n", sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        return false;
+    }
     sqlite3_finalize(stmt);
     
     node_editor.loadNodesData(nodes_data);
@@ -285,11 +430,12 @@ bool Database::loadLinks(NodeEditor& node_editor) {
     const char* sql = "SELECT id, orchestration_id, start_attr, end_attr FROM links ORDER BY orchestration_id, id;";
     sqlite3_stmt* stmt = nullptr;
     
-    sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    if (!prepare(sql, &stmt)) return false;
     
     std::vector<LinkData> links_data;
     
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
         LinkData link_data;
         link_data.id = sqlite3_column_int(stmt, 0);
         link_data.orchestration_id = sqlite3_column_int(stmt, 1);
@@ -299,6 +445,11 @@ bool Database::loadLinks(NodeEditor& node_editor) {
         links_data.push_back(link_data);
     }
     
+    if (rc != SQLITE_DONE) {
+        printf("Failed to load links: %s\n", sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        return false;
+    }
     sqlite3_finalize(stmt);
     
     node_editor.loadLinksData(links_data);
@@ -311,12 +462,18 @@ bool Database::saveAll(ProjectManager& project_manager, NodeEditor& node_editor)
     char* err_msg = nullptr;
     sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, &err_msg);
     
-    bool success = saveProjects(project_manager);
-    success &= saveNodes(node_editor);
-    success &= saveLinks(node_editor);
+    // Projects go last: removing an orchestration deletes its rows, which
+    // must win over edits made to its nodes before it was removed
+    bool success = saveNodes(node_editor);
+    success = success && saveLinks(node_editor);
+    success = success && saveProjects(project_manager);
     
     if (success) {
         sqlite3_exec(db, "COMMIT;", nullptr, nullptr, &err_msg);
+        // Changes are only forgotten once written; after a rollback the
+        // next save tries them again
+        project_manager.markSaved();
+        node_editor.markSaved();
         printf("Data saved successfully!\n");
     } else {
         sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, &err_msg);
@@ -333,6 +490,10 @@ bool Database::loadAll(ProjectManager& project_manager, NodeEditor& node_editor)
     success &= loadNodes(node_editor);
     success &= loadLinks(node_editor);
     
+    // What was just loaded matches the database
+    project_manager.markSaved();
+    node_editor.markSaved();
+    
     if (success) {
         printf("Data loaded successfully!\n");
     }
@@ -0,0 +1,349 @@
+#include "execution_engine.h"
+#include "async_http_client.h"
+#include "nodes.h"
+#include "terminal.h"
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
+
+// Blocking HTTP calls hold a worker for the whole request, so the pool is
+// sized for outstanding I/O rather than for CPU cores
+static size_t executionPoolSize() {
+    return std::max<size_t>(32, std::thread::hardware_concurrency() * 4);
+}
+
+static std::string formatRate(double value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.1f", value);
+    return buffer;
+}
+
+static std::string formatLatency(const LatencySummary& summary) {
+    char buffer[160];
+    snprintf(buffer, sizeof(buffer),
+             "n=%llu p50=%llu p90=%llu p99=%llu p99.9=%llu max=%llu us",
+             (unsigned long long)summary.count, (unsigned long long)summary.p50_us,
+             (unsigned long long)summary.p90_us, (unsigned long long)summary.p99_us,
+             (unsigned long long)summary.p999_us, (unsigned long long)summary.max_us);
+    return buffer;
+}
+
+static std::string formatPhases(const HttpPhaseSummary& phases) {
+    char buffer[224];
+    snprintf(buffer, sizeof(buffer),
+             "avg dns %.0f, connect %.0f, tls %.0f, server %.0f, transfer %.0f us; "
+             "%.0f B up, %.0f B down (%.0f B body decoded); %.0f%% reused connections",
+             phases.dns_us, phases.connect_us, phases.tls_us, phases.server_us, phases.transfer_us,
+             phases.bytes_sent, phases.bytes_received, phases.bytes_decoded, phases.reused * 100.0);
+    return buffer;
+}
+
+static std::string describeHttp(const HttpOptions& options) {
+    std::string description;
+    switch (options.version) {
+        case HttpVersion::Http1: description = "HTTP/1.1"; break;
+        case HttpVersion::Http2: description = "HTTP/2 over TLS"; break;
+        case HttpVersion::Http2PriorKnowledge: description = "HTTP/2 prior knowledge"; break;
+    }
+    if (options.version != HttpVersion::Http1) {
+        description += ", up to " + std::to_string(options.max_concurrent_streams) + " streams per connection";
+    }
+    if (options.compression) {
+        description += ", compressed responses";
+    }
+    return description;
+}
+
+const char* runStateName(RunState state) {
+    switch (state) {
+        case RunState::Idle: return "Idle";
+        case RunState::Running: return "Running";
+        case RunState::Succeeded: return "Succeeded";
+        case RunState::Failed: return "Failed";
+        case RunState::Cancelled: return "Cancelled";
+    }
+    return "Unknown";
+}
+
+ExecutionEngine::ExecutionEngine() : pool(executionPoolSize()), scheduler(pool) {
+    http_client.setCancelFlag(&cancel_requested);
+    context.http_client = &http_client;
+    context.cancel_flag = &cancel_requested;
+}
+
+ExecutionEngine::~ExecutionEngine() {
+    stop();
+}
+
+void ExecutionEngine::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (worker.joinable()) return;
+    stopping = false;
+    worker = std::thread(&ExecutionEngine::workerLoop, this);
+}
+
+void ExecutionEngine::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!worker.joinable()) return;
+        stopping = true;
+        queue.clear();
+    }
+    cancel_requested = true;
+    queue_cv.notify_all();
+    done_cv.notify_all();
+    worker.join();
+}
+
+int ExecutionEngine::submit(RunRequest request) {
+    int run_id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        run_id = next_run_id++;
+        queue.emplace_back(run_id, std::move(request));
+    }
+    queue_cv.notify_one();
+    return run_id;
+}
+
+void ExecutionEngine::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.clear();
+        if (status.state == RunState::Running) {
+            cancel_requested = true;
+        }
+    }
+    done_cv.notify_all();
+}
+
+bool ExecutionEngine::isBusy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return status.state == RunState::Running || !queue.empty();
+}
+
+void ExecutionEngine::setHttpOptions(const HttpOptions& options) {
+    std::lock_guard<std::mutex> lock(mutex);
+    http_options = options;
+}
+
+HttpOptions ExecutionEngine::getHttpOptions() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return http_options;
+}
+
+// Called on the worker thread between runs, so nothing uses the clients
+void ExecutionEngine::applyHttpOptions(const HttpOptions& options) {
+    active_http = options;
+    http_client.setOptions(options);
+    if (options.version == HttpVersion::Http1) {
+        async_http.reset();
+    } else if (!async_http || async_http->options() != options) {
+        async_http = std::make_unique<AsyncHttpClient>(1, options);
+    }
+    context.async_http = async_http.get();
+}
+
+RunStatus ExecutionEngine::getStatus() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return status;
+}
+
+bool ExecutionEngine::waitForRun(int run_id, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return done_cv.wait_for(lock, timeout, [this, run_id] {
+        if (stopping) return true;
+        if (status.run_id == run_id) return status.state != RunState::Running;
+        if (status.run_id > run_id) return true;
+        return std::none_of(queue.begin(), queue.end(), [run_id](const auto& item) { return item.first == run_id; });
+    });
+}
+
+void ExecutionEngine::report(const std::string& message) {
+    printf("%s\n", message.c_str());
+    if (context.terminal) context.terminal->log(message);
+}
+
+void ExecutionEngine::workerLoop() {
+    while (true) {
+        std::pair<int, RunRequest> item;
+        HttpOptions options;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queue_cv.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) return;
+
+            options = http_options;
+            item = std::move(queue.front());
+            queue.pop_front();
+
+            cancel_requested = false;
+            status = RunStatus();
+            status.run_id = item.first;
+            status.orchestration_id = item.second.plan->getOrchestrationId();
+            status.state = RunState::Running;
+            status.load_test = item.second.load_test;
+        }
+
+        const RunRequest& request = item.second;
+        context.terminal = request.terminal;
+        context.clearLog();
+        applyHttpOptions(options);
+
+        auto started = std::chrono::steady_clock::now();
+        bool success;
+        if (request.load_test) {
+            LoadTestConfig load_config = request.load_config;
+            load_config.http = options;
+            success = runLoadTest(request.plan, load_config);
+        } else if (request.single_node_id >= 0) {
+            success = runSingleNode(*request.plan, request.single_node_id);
+        } else {
+            success = runOrchestration(*request.plan);
+        }
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            status.elapsed_ms = elapsed.count();
+            status.current_node_id = -1;
+            if (cancel_requested) {
+                status.state = RunState::Cancelled;
+            } else {
+                status.state = success ? RunState::Succeeded : RunState::Failed;
+            }
+        }
+        done_cv.notify_all();
+    }
+}
+
+void ExecutionEngine::nodeStarted(const Node& node) {
+    std::lock_guard<std::mutex> lock(mutex);
+    status.current_node_id = node.getId();
+    status.nodes_running++;
+}
+
+void ExecutionEngine::nodeFinished(const Node&, bool) {
+    std::lock_guard<std::mutex> lock(mutex);
+    status.nodes_running--;
+    status.nodes_executed++;
+}
+
+bool ExecutionEngine::runSingleNode(const ExecutionPlan& plan, int node_id) {
+    uint32_t index = plan.findNode(node_id);
+    if (index == ExecutionPlan::npos) {
+        report("Selected node not found");
+        return false;
+    }
+
+    Node* node = plan.node(index);
+    report("\n=== Executing Single Node ===");
+    nodeStarted(*node);
+    bool success = NodeExecutor::execute(node, context);
+    nodeFinished(*node, success);
+    report("Execution " + std::string(success ? "SUCCESS" : "FAILED"));
+    report("=== End Execution ===\n");
+    return success;
+}
+
+bool ExecutionEngine::runOrchestration(const ExecutionPlan& plan) {
+    report("\n=== Executing Full Orchestration ===");
+    if (active_http != HttpOptions()) {
+        report(describeHttp(active_http));
+    }
+
+    context.clearVariables();
+    context.last_response_body.clear();
+    context.streamed_values.reset();
+    context.last_status_code = 0;
+
+    DagHooks hooks;
+    hooks.on_node_started = [this](const Node& node) { nodeStarted(node); };
+    hooks.on_node_finished = [this](const Node& node, bool success) { nodeFinished(node, success); };
+
+    PlanLatency plan_latency = latency.bind(plan);
+    context.latency = &plan_latency;
+    auto started = std::chrono::steady_clock::now();
+    bool success = scheduler.run(plan, context, hooks);
+    if (!cancel_requested) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+        plan_latency.orchestration->record(static_cast<uint64_t>(elapsed.count()));
+    }
+    context.latency = nullptr;
+
+    if (cancel_requested) {
+        report("Execution cancelled");
+    } else if (success) {
+        report("All connected nodes executed, execution complete");
+    } else {
+        report("Node execution failed, stopping");
+    }
+
+    report("=== End Orchestration Execution ===\n");
+    return success;
+}
+
+
+bool ExecutionEngine::runLoadTest(const std::shared_ptr<const ExecutionPlan>& plan, const LoadTestConfig& config) {
+    report("\n=== Load Test ===");
+    std::string budget = config.iterations > 0
+        ? std::to_string(config.iterations) + " iteration(s)"
+        : formatRate(config.duration_s) + " s";
+    if (config.mode == LoadMode::ArrivalRate) {
+        report(formatRate(config.arrival_rate) + " iteration(s)/s, at most " +
+               std::to_string(config.max_in_flight) + " in flight, " + budget);
+    } else {
+        report(std::to_string(config.virtual_users) + " virtual user(s), " + budget);
+    }
+    if (config.io_threads > 0) {
+        report("Event-driven on " + std::to_string(config.io_threads) + " I/O thread(s)");
+    }
+    if (config.http != HttpOptions()) {
+        report(describeHttp(config.http));
+    }
+
+    if (plan->startIndex() == ExecutionPlan::npos) {
+        report("ERROR: No Start node found in orchestration");
+        report("=== End Load Test ===\n");
+        return false;
+    }
+
+    // A load test reports on its own samples only
+    latency.reset(plan->getOrchestrationId());
+    PlanLatency plan_latency = latency.bind(*plan);
+
+    LoadRunner runner(plan, config, &cancel_requested, &plan_latency);
+    LoadTestStats stats = runner.run([this](const LoadTestStats& progress) {
+        std::lock_guard<std::mutex> lock(mutex);
+        status.load_stats = progress;
+        status.elapsed_ms = progress.elapsed_s * 1000.0;
+    });
+
+    report("Iterations: " + std::to_string(stats.iterations) + " (" +
+           formatRate(stats.iterationsPerSecond()) + "/s, " +
+           formatRate(stats.iterationErrorRate() * 100.0) + "% failed)");
+    report("Requests: " + std::to_string(stats.requests) + " (" +
+           formatRate(stats.requestsPerSecond()) + "/s, " +
+           formatRate(stats.requestErrorRate() * 100.0) + "% errors)");
+    if (stats.dropped_iterations > 0) {
+        report("Dropped: " + std::to_string(stats.dropped_iterations) +
+               " iteration(s) found no free slot, raise the in-flight limit");
+    }
+    reportLatency(plan->getOrchestrationId());
+    if (cancel_requested) {
+        report("Load test cancelled");
+    }
+    report("=== End Load Test ===\n");
+    return stats.failed_iterations == 0;
+}
+
+void ExecutionEngine::reportLatency(int orchestration_id) {
+    LatencySummary total = latency.orchestrationSummary(orchestration_id);
+    if (total.count == 0) return;
+
+    report("Latency (iteration): " + formatLatency(total));
+    for (const NodeLatency& node : latency.nodeSummaries(orchestration_id)) {
+        report("Latency (" + node.type + " #" + std::to_string(node.node_id) + "): " + formatLatency(node.summary));
+        report("  " + formatPhases(node.phases));
+    }
+}
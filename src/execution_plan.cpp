@@ -0,0 +1,166 @@
+#include "execution_plan.h"
+#include "nodes.h"
+#include "json_path.h"
+#include <algorithm>
+
+std::shared_ptr<const ExecutionPlan> ExecutionPlan::compile(int orchestration_id,
+                                                            const std::vector<std::unique_ptr<Node>>& source_nodes,
+                                                            const std::vector<std::unique_ptr<Link>>& links) {
+    auto plan = std::make_shared<ExecutionPlan>();
+    plan->orchestration_id = orchestration_id;
+    plan->nodes.reserve(source_nodes.size());
+    for (const auto& node : source_nodes) {
+        if (auto copy = node->clone()) {
+            copy->resolveVariables();
+            plan->nodes.push_back(std::move(copy));
+        }
+    }
+
+    const uint32_t node_count = static_cast<uint32_t>(plan->nodes.size());
+
+    // ---- Pin -> node table ----
+    std::vector<std::pair<int, uint32_t>> pins;
+    for (uint32_t i = 0; i < node_count; i++) {
+        if (plan->start_index == npos && plan->nodes[i]->getType() == "Start") {
+            plan->start_index = i;
+        }
+        for (int attr : plan->nodes[i]->getAttributeIds()) {
+            pins.emplace_back(attr, i);
+        }
+    }
+
+    if (!pins.empty()) {
+        auto [min_it, max_it] = std::minmax_element(pins.begin(), pins.end());
+        long long range = static_cast<long long>(max_it->first) - min_it->first + 1;
+        if (range <= static_cast<long long>(pins.size()) * 16) {
+            plan->pin_base = min_it->first;
+            plan->pin_table.assign(static_cast<size_t>(range), npos);
+            for (const auto& [pin, index] : pins) {
+                plan->pin_table[pin - plan->pin_base] = index;
+            }
+        } else {
+            for (const auto& [pin, index] : pins) {
+                plan->sparse_pins[pin] = index;
+            }
+        }
+    }
+
+    // ---- Successor arrays (CSR) ----
+    struct Edge {
+        uint32_t from;
+        uint32_t to;
+        int pin;
+    };
+    std::vector<Edge> edges;
+    edges.reserve(links.size());
+    for (const auto& link : links) {
+        uint32_t from = plan->nodeForPin(link->start_attr);
+        uint32_t to = plan->nodeForPin(link->end_attr);
+        if (from == npos || to == npos) continue;
+        edges.push_back({from, to, link->start_attr});
+    }
+    std::stable_sort(edges.begin(), edges.end(),
+                     [](const Edge& a, const Edge& b) { return a.from < b.from; });
+
+    plan->successor_offsets.assign(node_count + 1, 0);
+    plan->successors.reserve(edges.size());
+    plan->successor_pins.reserve(edges.size());
+    for (const Edge& edge : edges) {
+        plan->successor_offsets[edge.from + 1]++;
+        plan->successors.push_back(edge.to);
+        plan->successor_pins.push_back(edge.pin);
+    }
+    for (uint32_t i = 0; i < node_count; i++) {
+        plan->successor_offsets[i + 1] += plan->successor_offsets[i];
+    }
+
+    // ---- Assertions ----
+    // A failed assertion only fails the run when nothing handles it
+    for (const Edge& edge : edges) {
+        if (auto* check = dynamic_cast<AssertNode*>(plan->nodes[edge.from].get())) {
+            if (edge.pin == check->getId() + 3) check->setFailLinked(true);
+        }
+    }
+
+    // ---- Reachability, input counts and topological order ----
+    plan->initial_pending.assign(node_count, 0);
+    if (plan->start_index == npos) return plan;
+
+    // Only inputs coming from nodes reachable from Start are waited on, so a
+    // stray node wired into the graph cannot block a join forever
+    std::vector<bool> reachable(node_count, false);
+    std::vector<uint32_t> stack = {plan->start_index};
+    reachable[plan->start_index] = true;
+    while (!stack.empty()) {
+        uint32_t index = stack.back();
+        stack.pop_back();
+        for (const uint32_t* it = plan->successorsBegin(index); it != plan->successorsEnd(index); ++it) {
+            if (!reachable[*it]) {
+                reachable[*it] = true;
+                stack.push_back(*it);
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < node_count; i++) {
+        if (!reachable[i]) continue;
+        plan->reachable_count++;
+        for (const uint32_t* it = plan->successorsBegin(i); it != plan->successorsEnd(i); ++it) {
+            plan->initial_pending[*it]++;
+        }
+    }
+
+    // ---- Streamed responses ----
+    // A response read by nothing but JSON extract nodes (each with no other
+    // input) never has to be held as a whole: their paths are evaluated as
+    // it arrives, and the transfer ends once they have what they select
+    for (uint32_t i = 0; i < node_count; i++) {
+        const uint32_t* begin = plan->successorsBegin(i);
+        const uint32_t* end = plan->successorsEnd(i);
+        if (!reachable[i] || begin == end || end - begin > static_cast<long>(JsonStreamExtractor::MAX_PATHS)) continue;
+
+        auto paths = std::make_shared<JsonPathSet>();
+        for (const uint32_t* it = begin; it != end; ++it) {
+            auto* extract = dynamic_cast<JsonExtractNode*>(plan->nodes[*it].get());
+            const JsonPath* path = extract ? extract->getCompiledPath().get() : nullptr;
+            if (!path || path->hasFilters() || plan->initial_pending[*it] != 1) {
+                paths.reset();
+                break;
+            }
+            paths->push_back(extract->getCompiledPath());
+        }
+        if (paths) plan->nodes[i]->setStreamPaths(std::move(paths));
+    }
+
+    // Kahn's algorithm; whatever is left out sits on a cycle
+    std::vector<int32_t> pending = plan->initial_pending;
+    plan->topo_order.reserve(plan->reachable_count);
+    plan->topo_order.push_back(plan->start_index);
+    for (size_t head = 0; head < plan->topo_order.size(); head++) {
+        uint32_t index = plan->topo_order[head];
+        for (const uint32_t* it = plan->successorsBegin(index); it != plan->successorsEnd(index); ++it) {
+            if (--pending[*it] == 0) {
+                plan->topo_order.push_back(*it);
+            }
+        }
+    }
+
+    return plan;
+}
+
+uint32_t ExecutionPlan::nodeForPin(int pin) const {
+    if (!pin_table.empty()) {
+        long long offset = static_cast<long long>(pin) - pin_base;
+        if (offset < 0 || offset >= static_cast<long long>(pin_table.size())) return npos;
+        return pin_table[static_cast<size_t>(offset)];
+    }
+    auto it = sparse_pins.find(pin);
+    return it != sparse_pins.end() ? it->second : npos;
+}
+
+uint32_t ExecutionPlan::findNode(int node_id) const {
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i]->getId() == node_id) return i;
+    }
+    return npos;
+}
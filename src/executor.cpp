@@ -1,232 +1,453 @@
 #include "executor.h"
 #include "terminal.h"
 #include "nodes.h"
-#include <SDL.h>
+#include "async_http_client.h"
+#include "json_path.h"
+#include "expression.h"
+#include "request_template.h"
 #include <iostream>
-#include <sstream>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
 
-void ExecutionContext::setVariable(const std::string& name, const std::any& value) {
-    variables[name] = value;
+std::unique_ptr<ExecutionContext> ExecutionContext::fork() {
+    auto branch = std::make_unique<ExecutionContext>();
+    branch->root = &scope();
+    branch->http_client = http_client;
+    branch->async_http = async_http;
+    branch->terminal = terminal;
+    branch->cancel_flag = cancel_flag;
+    branch->log_enabled = log_enabled;
+    branch->latency = latency;
+    branch->last_response_body = last_response_body;
+    branch->streamed_values = streamed_values;
+    branch->last_status_code = last_status_code;
+    return branch;
 }
 
-std::any ExecutionContext::getVariable(const std::string& name) {
-    if (variables.find(name) != variables.end()) {
-        return variables[name];
+void ExecutionContext::setVariable(uint32_t slot, VariableValue value) {
+    ExecutionContext& shared = scope();
+    std::lock_guard<std::mutex> lock(shared.variables_mutex);
+    if (slot >= shared.variables.size()) {
+        shared.variables.resize(slot + 1);
     }
-    return std::any();
+    shared.variables[slot] = std::move(value);
+}
+
+VariableValue ExecutionContext::getVariable(uint32_t slot) {
+    ExecutionContext& shared = scope();
+    std::lock_guard<std::mutex> lock(shared.variables_mutex);
+    if (slot < shared.variables.size()) {
+        return shared.variables[slot];
+    }
+    return VariableValue();
+}
+
+bool ExecutionContext::hasVariable(uint32_t slot) {
+    ExecutionContext& shared = scope();
+    std::lock_guard<std::mutex> lock(shared.variables_mutex);
+    return slot < shared.variables.size() && !std::holds_alternative<std::monostate>(shared.variables[slot]);
+}
+
+void ExecutionContext::setVariable(const std::string& name, VariableValue value) {
+    setVariable(VariableNames::instance().intern(name), std::move(value));
+}
+
+VariableValue ExecutionContext::getVariable(const std::string& name) {
+    uint32_t slot = VariableNames::instance().find(name);
+    return slot != VariableNames::npos ? getVariable(slot) : VariableValue();
 }
 
 bool ExecutionContext::hasVariable(const std::string& name) {
-    return variables.find(name) != variables.end();
+    uint32_t slot = VariableNames::instance().find(name);
+    return slot != VariableNames::npos && hasVariable(slot);
+}
+
+void ExecutionContext::clearVariables() {
+    ExecutionContext& shared = scope();
+    std::lock_guard<std::mutex> lock(shared.variables_mutex);
+    for (VariableValue& value : shared.variables) {
+        value = std::monostate();
+    }
+}
+
+void ExecutionContext::recordRequest(bool success) {
+    ExecutionContext& shared = scope();
+    shared.requests_sent.fetch_add(1, std::memory_order_relaxed);
+    if (!success) {
+        shared.requests_failed.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+std::shared_ptr<const JsonIndex> ExecutionContext::jsonIndex(const BodyBuffer& body) {
+    if (body.size() < JsonIndex::MIN_SIZE || body.size() > JsonIndex::MAX_SIZE) return nullptr;
+
+    ExecutionContext& shared = scope();
+    std::weak_ptr<const void> lifetime = body.lifetime();
+    std::lock_guard<std::mutex> lock(shared.json_index_mutex);
+    auto& cache = shared.json_indexes;
+    cache.erase(std::remove_if(cache.begin(), cache.end(),
+                               [](const CachedIndex& entry) { return entry.lifetime.expired(); }),
+                cache.end());
+    for (const CachedIndex& entry : cache) {
+        // Same bytes of the same buffer; the owner check rules out a new
+        // body that happens to reuse the address of a freed one
+        if (entry.bytes == body.data() && entry.length == body.size() &&
+            !entry.lifetime.owner_before(lifetime) && !lifetime.owner_before(entry.lifetime)) {
+            return entry.index;
+        }
+    }
+    auto index = std::make_shared<const JsonIndex>(body.view());
+    cache.push_back({body.data(), body.size(), lifetime, index});
+    return index;
 }
 
 void ExecutionContext::log(const std::string& message) {
-    execution_log += message + "\n";
+    if (!log_enabled) return;
+    {
+        ExecutionContext& shared = scope();
+        std::lock_guard<std::mutex> lock(shared.log_mutex);
+        shared.execution_log += message + "\n";
+    }
     std::cout << "[EXEC] " << message << std::endl;
     if (terminal) {
         terminal->log("[EXEC] " + message);
     }
 }
 
-// Helper to parse headers from string
-std::map<std::string, std::string> parseHeaders(const std::string& headers_str) {
-    std::map<std::string, std::string> headers;
-    std::istringstream stream(headers_str);
-    std::string line;
-    
-    while (std::getline(stream, line)) {
-        if (line.empty() || line == "\r") continue;
-        
-        size_t colon_pos = line.find(':');
-        if (colon_pos != std::string::npos) {
-            std::string key = line.substr(0, colon_pos);
-            std::string value = line.substr(colon_pos + 1);
-            
-            // Trim whitespace
-            key.erase(0, key.find_first_not_of(" \t\r"));
-            key.erase(key.find_last_not_of(" \t\r") + 1);
-            value.erase(0, value.find_first_not_of(" \t\r"));
-            value.erase(value.find_last_not_of(" \t\r") + 1);
-            
-            headers[key] = value;
-        }
-    }
-    
-    return headers;
+std::string ExecutionContext::getLog() const {
+    const ExecutionContext& shared = scope();
+    std::lock_guard<std::mutex> lock(shared.log_mutex);
+    return shared.execution_log;
+}
+
+void ExecutionContext::clearLog() {
+    ExecutionContext& shared = scope();
+    std::lock_guard<std::mutex> lock(shared.log_mutex);
+    shared.execution_log.clear();
 }
 
 bool NodeExecutor::execute(Node* node, ExecutionContext& context) {
     if (!node) return false;
     
-    // DEBUG INFO
-    printf("DEBUG Executor: Node pointer: %p\n", (void*)node);
-    printf("DEBUG Executor: Node ID: %d\n", node->getId());
-    
-    std::string type = node->getType();
-    printf("DEBUG Executor: Type string: '%s'\n", type.c_str());
-    printf("DEBUG Executor: Type length: %zu\n", type.length());
+    EXEC_TRACE(context, TRACE_DEBUG, "Executing node: " + node->getType() + " (ID: " + std::to_string(node->getId()) + ")");
+    return node->execute(context);
+}
+
+// -------------------- Node execution --------------------
+bool Node::execute(ExecutionContext& context) {
+    EXEC_TRACE(context, TRACE_INFO, "WARNING: Node type '" + getType() + "' execution not implemented yet");
+    return true;
+}
+
+void Node::executeAsync(ExecutionContext& context, std::function<void(bool)> done) {
+    done(execute(context));
+}
+
+bool StartNode::execute(ExecutionContext& context) {
+    EXEC_TRACE(context, TRACE_INFO, "Starting workflow execution");
+    return true;
+}
+
+// Shared tail of the HTTP nodes: stores the response for downstream nodes
+static std::string formatTimings(const HttpTimings& timings) {
+    // Only worth mentioning when the body was noticeably compressed
+    std::string decoded;
+    if (timings.bytes_decoded > timings.bytes_received) {
+        decoded = ", " + std::to_string(timings.bytes_decoded) + " B decoded";
+    }
+
+    char buffer[320];
+    snprintf(buffer, sizeof(buffer),
+             "Timing: dns %.1f ms, connect %.1f ms, tls %.1f ms, server %.1f ms, transfer %.1f ms, total %.1f ms "
+             "(%lld B up, %lld B down%s%s%s)",
+             timings.dnsUs() / 1000.0, timings.connectUs() / 1000.0, timings.tlsUs() / 1000.0,
+             timings.serverUs() / 1000.0, timings.transferUs() / 1000.0, timings.total_us / 1000.0,
+             timings.bytes_sent, timings.bytes_received, timings.connection_reused ? ", reused connection" : "",
+             timings.http2 ? ", HTTP/2" : "", decoded.c_str());
+    return buffer;
+}
+
+static bool handleHttpResponse(ExecutionContext& context, const HttpResponse& response, bool log_body) {
+    context.recordRequest(response.success && response.status_code < 400);
+    context.last_timings = response.timings;
     
-    // Try all dynamic casts to see what the object actually is
-    printf("DEBUG: Is StartNode? %s\n", dynamic_cast<StartNode*>(node) ? "YES" : "NO");
-    printf("DEBUG: Is HttpGetNode? %s\n", dynamic_cast<HttpGetNode*>(node) ? "YES" : "NO");
-    printf("DEBUG: Is HttpPostNode? %s\n", dynamic_cast<HttpPostNode*>(node) ? "YES" : "NO");
-    printf("DEBUG: Is HttpPutNode? %s\n", dynamic_cast<HttpPutNode*>(node) ? "YES" : "NO");
-    printf("DEBUG: Is HttpDeleteNode? %s\n", dynamic_cast<HttpDeleteNode*>(node) ? "YES" : "NO");
-    printf("DEBUG: Is IfConditionNode? %s\n", dynamic_cast<IfConditionNode*>(node) ? "YES" : "NO");
-    printf("DEBUG: Is LogNode? %s\n", dynamic_cast<LogNode*>(node) ? "YES" : "NO");
+    if (!response.success) {
+        EXEC_TRACE(context, TRACE_ERROR, "ERROR: " + response.error_message);
+        return false;
+    }
     
-    context.log("Executing node: " + type + " (ID: " + std::to_string(node->getId()) + ")");
-       
-    if (type == "Start") {
-        context.log("Starting workflow execution");
-        return true;
+    context.last_response_body = response.body;
+    context.streamed_values = response.streamed;
+    context.last_status_code = response.status_code;
+    EXEC_TRACE(context, TRACE_INFO, "Response: Status " + std::to_string(response.status_code));
+    EXEC_TRACE(context, TRACE_INFO, formatTimings(response.timings));
+    if (response.streamed) {
+        EXEC_TRACE(context, TRACE_DEBUG, "Body: streamed through " + std::to_string(response.streamed->paths->size()) +
+                                         " JSON path(s), not kept");
+    } else if (log_body) {
+        EXEC_TRACE(context, TRACE_DEBUG, "Body: " + response.body.preview(200));
     }
-    else if (type == "HTTP_GET") {
-        auto* http_node = dynamic_cast<HttpGetNode*>(node);
-        if (!http_node) return false;
-        
-        std::string url = http_node->getUrl();
-        std::string headers_str = http_node->getHeaders();
-        
-        context.log("GET Request to: " + url);
-        
-        auto headers = parseHeaders(headers_str);
-        HttpResponse response = context.http_client.get(url, headers);
-        
-        if (response.success) {
-            context.last_response_body = response.body;
-            context.last_status_code = response.status_code;
-            context.log("Response: Status " + std::to_string(response.status_code));
-            context.log("Body: " + response.body.substr(0, 200) + (response.body.length() > 200 ? "..." : ""));
-            return true;
-        } else {
-            context.log("ERROR: " + response.error_message);
-            return false;
-        }
+    return true;
+}
+
+// Request the HTTP nodes render into. Its strings keep their capacity from
+// one request to the next; each worker thread has its own, since DAG runs
+// fork a fresh context for every node.
+static thread_local HttpRequest request_buffer;
+
+// The request goes to the event-driven client, which keeps it until the
+// transfer ends; the buffer takes over the request of a finished transfer
+// instead, so the next render still has capacity to write into
+static void submitHttpRequest(ExecutionContext& context, bool log_body, std::function<void(bool)> done) {
+    context.async_http->submit(std::move(request_buffer),
+        [&context, log_body, done = std::move(done)](HttpResponse&& response) {
+            done(handleHttpResponse(context, response, log_body));
+        },
+        context.cancel_flag);
+    context.async_http->reuseRequest(request_buffer);
+}
+
+// Blocking send of the rendered request. When the context has an
+// event-driven client (HTTP/2 runs), the request still goes through it so
+// that parallel branches share its connections, and the calling worker just
+// waits for the result.
+static HttpResponse sendHttpRequest(ExecutionContext& context) {
+    if (context.async_http) {
+        HttpResponse response = context.async_http->submit(std::move(request_buffer), context.cancel_flag).get();
+        // The transfer put its request back among the spares before answering
+        context.async_http->reuseRequest(request_buffer);
+        return response;
     }
-    else if (type == "HTTP_POST") {
-        auto* http_node = dynamic_cast<HttpPostNode*>(node);
-        if (!http_node) return false;
-        
-        std::string url = http_node->getUrl();
-        std::string headers_str = http_node->getHeaders();
-        std::string body = http_node->getBody();
-        
-        context.log("POST Request to: " + url);
-        
-        auto headers = parseHeaders(headers_str);
-        HttpResponse response = context.http_client.post(url, body, headers);
-        
-        if (response.success) {
-            context.last_response_body = response.body;
-            context.last_status_code = response.status_code;
-            context.log("Response: Status " + std::to_string(response.status_code));
-            context.log("Body: " + response.body.substr(0, 200) + (response.body.length() > 200 ? "..." : ""));
-            return true;
-        } else {
-            context.log("ERROR: " + response.error_message);
-            return false;
-        }
+
+    return context.http_client->send(request_buffer);
+}
+
+// Renders a node's request into the buffer and logs it
+static void renderHttpRequest(ExecutionContext& context, const RequestTemplate& request_template,
+                              const std::shared_ptr<const JsonPathSet>& stream_paths) {
+    HttpRequest& request = request_buffer;
+    request_template.render(context, request);
+    request.stream_paths = stream_paths;
+    EXEC_TRACE(context, TRACE_INFO, request.method + " Request to: " + request.url);
+}
+
+bool HttpGetNode::execute(ExecutionContext& context) {
+    renderHttpRequest(context, *request_template, stream_paths);
+    HttpResponse response = sendHttpRequest(context);
+    return handleHttpResponse(context, response, true);
+}
+
+void HttpGetNode::executeAsync(ExecutionContext& context, std::function<void(bool)> done) {
+    if (!context.async_http) return done(execute(context));
+    renderHttpRequest(context, *request_template, stream_paths);
+    submitHttpRequest(context, true, std::move(done));
+}
+
+bool HttpPostNode::execute(ExecutionContext& context) {
+    renderHttpRequest(context, *request_template, stream_paths);
+    HttpResponse response = sendHttpRequest(context);
+    return handleHttpResponse(context, response, true);
+}
+
+void HttpPostNode::executeAsync(ExecutionContext& context, std::function<void(bool)> done) {
+    if (!context.async_http) return done(execute(context));
+    renderHttpRequest(context, *request_template, stream_paths);
+    submitHttpRequest(context, true, std::move(done));
+}
+
+bool HttpPutNode::execute(ExecutionContext& context) {
+    renderHttpRequest(context, *request_template, stream_paths);
+    HttpResponse response = sendHttpRequest(context);
+    return handleHttpResponse(context, response, true);
+}
+
+void HttpPutNode::executeAsync(ExecutionContext& context, std::function<void(bool)> done) {
+    if (!context.async_http) return done(execute(context));
+    renderHttpRequest(context, *request_template, stream_paths);
+    submitHttpRequest(context, true, std::move(done));
+}
+
+bool HttpDeleteNode::execute(ExecutionContext& context) {
+    renderHttpRequest(context, *request_template, stream_paths);
+    HttpResponse response = sendHttpRequest(context);
+    return handleHttpResponse(context, response, false);
+}
+
+void HttpDeleteNode::executeAsync(ExecutionContext& context, std::function<void(bool)> done) {
+    if (!context.async_http) return done(execute(context));
+    renderHttpRequest(context, *request_template, stream_paths);
+    submitHttpRequest(context, false, std::move(done));
+}
+
+bool SetVariableNode::execute(ExecutionContext& context) {
+    // For now, set the last response body as the variable value; the
+    // variable shares the body's bytes
+    uint32_t slot = var_slot != VariableNames::npos ? var_slot : VariableNames::instance().intern(var_name);
+    context.setVariable(slot, context.last_response_body);
+    EXEC_TRACE(context, TRACE_DEBUG, "Set variable '" + std::string(var_name) + "' = " + context.last_response_body.preview(100));
+    return true;
+}
+
+bool JsonExtractNode::execute(ExecutionContext& context) {
+    if (!compiled_path) {
+        EXEC_TRACE(context, TRACE_ERROR, "ERROR: Invalid JSON path '" + std::string(json_path) + "': " + path_error);
+        return false;
     }
-    else if (type == "HTTP_PUT") {
-        auto* http_node = dynamic_cast<HttpPutNode*>(node);
-        if (!http_node) return false;
-        
-        std::string url = http_node->getUrl();
-        std::string headers_str = http_node->getHeaders();
-        std::string body = http_node->getBody();
-        
-        context.log("PUT Request to: " + url);
-        
-        auto headers = parseHeaders(headers_str);
-        HttpResponse response = context.http_client.put(url, body, headers);
-        
-        if (response.success) {
-            context.last_response_body = response.body;
-            context.last_status_code = response.status_code;
-            context.log("Response: Status " + std::to_string(response.status_code));
-            context.log("Body: " + response.body.substr(0, 200) + (response.body.length() > 200 ? "..." : ""));
-            return true;
+
+    // A streamed response left behind only what the paths reading it
+    // selected. Otherwise large responses are indexed once and shared with
+    // every other node reading them; the index refers to the body, which
+    // the context holds.
+    std::shared_ptr<const JsonStreamResult> stream = std::move(context.streamed_values);
+    const std::vector<JsonValue>* streamed = stream ? stream->find(compiled_path.get()) : nullptr;
+    BodyBuffer source = streamed ? stream->bytes : context.last_response_body;
+    std::shared_ptr<const JsonIndex> index = streamed ? nullptr : context.jsonIndex(source);
+    if (!compiled_path->isSingular()) {
+        // Wildcards, slices and filters yield a JSON array of every match
+        std::vector<JsonValue> matches;
+        const std::vector<JsonValue>& values = streamed ? *streamed : matches;
+        bool valid;
+        if (streamed) {
+            valid = stream->valid;
         } else {
-            context.log("ERROR: " + response.error_message);
-            return false;
+            valid = index ? extractJsonAll(*index, *compiled_path, matches)
+                          : extractJsonAll(source.view(), *compiled_path, matches);
         }
-    }
-    else if (type == "HTTP_DELETE") {
-        auto* http_node = dynamic_cast<HttpDeleteNode*>(node);
-        if (!http_node) return false;
-        
-        std::string url = http_node->getUrl();
-        std::string headers_str = http_node->getHeaders();
-        
-        context.log("DELETE Request to: " + url);
-        
-        auto headers = parseHeaders(headers_str);
-        HttpResponse response = context.http_client.del(url, headers);
-        
-        if (response.success) {
-            context.last_response_body = response.body;
-            context.last_status_code = response.status_code;
-            context.log("Response: Status " + std::to_string(response.status_code));
-            return true;
-        } else {
-            context.log("ERROR: " + response.error_message);
+        if (!valid) {
+            EXEC_TRACE(context, TRACE_ERROR, "ERROR: Response is not valid JSON along '" + std::string(json_path) + "'");
             return false;
         }
-    }
-    else if (type == "SET_VARIABLE") {
-        auto* var_node = dynamic_cast<SetVariableNode*>(node);
-        if (!var_node) return false;
-        
-        std::string var_name = var_node->getVarName();
-        
-        // For now, set the last response body as the variable value
-        context.setVariable(var_name, context.last_response_body);
-        context.log("Set variable '" + var_name + "' = " + context.last_response_body.substr(0, 100));
+        size_t length = 2;
+        for (const JsonValue& value : values) length += value.raw.size() + 1;
+        std::string list;
+        list.reserve(length);
+        list += '[';
+        for (size_t i = 0; i < values.size(); i++) {
+            if (i > 0) list += ',';
+            list += values[i].raw;
+        }
+        list += ']';
+        context.last_response_body = BodyBuffer(std::move(list));
+        EXEC_TRACE(context, TRACE_DEBUG, "Extracted " + std::to_string(values.size()) + " values for '" + std::string(json_path) + "'");
         return true;
     }
-    else if (type == "GET_VARIABLE") {
-        auto* var_node = dynamic_cast<GetVariableNode*>(node);
-        if (!var_node) return false;
-        
-        std::string var_name = var_node->getVarName();
-        
-        if (context.hasVariable(var_name)) {
-            auto value = context.getVariable(var_name);
-            try {
-                std::string str_value = std::any_cast<std::string>(value);
-                context.log("Get variable '" + var_name + "' = " + str_value.substr(0, 100));
-                context.last_response_body = str_value;
-            } catch (const std::bad_any_cast&) {
-                context.log("ERROR: Variable '" + var_name + "' is not a string");
-                return false;
-            }
-            return true;
-        } else {
-            context.log("ERROR: Variable '" + var_name + "' not found");
-            return false;
-        }
+
+    JsonValue value;
+    bool found;
+    if (streamed) {
+        found = !streamed->empty();
+        if (found) value = streamed->front();
+    } else {
+        found = index ? extractJson(*index, *compiled_path, value) : extractJson(source.view(), *compiled_path, value);
     }
-    else if (type == "LOG") {
-        auto* log_node = dynamic_cast<LogNode*>(node);
-        if (!log_node) return false;
-        
-        std::string message = log_node->getMessage();
-        context.log("LOG: " + message);
-        return true;
+    if (!found) {
+        EXEC_TRACE(context, TRACE_ERROR, "ERROR: JSON path '" + std::string(json_path) + "' not found in response");
+        return false;
+    }
+
+    // Strings lose their quotes; unless they need unescaping, the value
+    // shares the response's bytes instead of copying them
+    if (value.hasEscapes()) {
+        context.last_response_body = BodyBuffer(value.text());
+    } else {
+        context.last_response_body = source.slice(value.unquoted());
     }
-    else if (type == "DELAY") {
-        auto* delay_node = dynamic_cast<DelayNode*>(node);
-        if (!delay_node) return false;
-        
-        std::string delay_str = delay_node->getDelayMs();
-        int delay_ms = std::stoi(delay_str);
-        
-        context.log("Delaying for " + std::to_string(delay_ms) + "ms");
-        SDL_Delay(delay_ms);
+    EXEC_TRACE(context, TRACE_DEBUG, "Extracted '" + std::string(json_path) + "' = " + context.last_response_body.preview(100));
+    return true;
+}
+
+bool GetVariableNode::execute(ExecutionContext& context) {
+    uint32_t slot = var_slot != VariableNames::npos ? var_slot : VariableNames::instance().find(var_name);
+    VariableValue value = slot != VariableNames::npos ? context.getVariable(slot) : VariableValue();
+    if (std::holds_alternative<std::monostate>(value)) {
+        EXEC_TRACE(context, TRACE_ERROR, "ERROR: Variable '" + std::string(var_name) + "' not found");
+        return false;
+    }
+
+    context.streamed_values.reset();
+    context.last_response_body = variableText(value);
+    EXEC_TRACE(context, TRACE_DEBUG, "Get variable '" + std::string(var_name) + "' = " + context.last_response_body.preview(100));
+    return true;
+}
+
+bool IfConditionNode::execute(ExecutionContext& context) {
+    if (!compiled_condition) {
+        EXEC_TRACE(context, TRACE_ERROR, "ERROR: Invalid condition '" + std::string(condition) + "': " + condition_error);
+        return false;
+    }
+
+    bool result = compiled_condition->test(context);
+    context.taken_output = result ? id + 2 : id + 3;
+    EXEC_TRACE(context, TRACE_DEBUG, "Condition '" + std::string(condition) + "' is " + (result ? "true" : "false"));
+    return true;
+}
+
+bool AssertNode::execute(ExecutionContext& context) {
+    if (!compiled_assertion) {
+        EXEC_TRACE(context, TRACE_ERROR, "ERROR: Invalid assertion '" + std::string(assertion) + "': " + assertion_error);
+        return false;
+    }
+
+    if (compiled_assertion->test(context)) {
+        context.taken_output = id + 2;
+        EXEC_TRACE(context, TRACE_DEBUG, "Assertion passed: " + std::string(assertion));
         return true;
     }
+    context.taken_output = id + 3;
+    EXEC_TRACE(context, TRACE_ERROR, "ASSERTION FAILED: " + std::string(assertion) +
+                                     " (status " + std::to_string(context.last_status_code) + ")");
+    return fail_linked;
+}
+
+bool LogNode::execute(ExecutionContext& context) {
+    EXEC_TRACE(context, TRACE_INFO, "LOG: " + std::string(message));
+    return true;
+}
+
+bool DelayNode::execute(ExecutionContext& context) {
+    int delay = std::atoi(delay_ms);
     
-    context.log("WARNING: Node type '" + type + "' execution not implemented yet");
+    EXEC_TRACE(context, TRACE_DEBUG, "Delaying for " + std::to_string(delay) + "ms");
+    
+    // Sleep in short slices so a cancelled run does not hang on a long delay
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (context.isCancelled()) {
+            EXEC_TRACE(context, TRACE_INFO, "Delay interrupted, run cancelled");
+            return false;
+        }
+        auto remaining = deadline - std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(remaining, std::chrono::milliseconds(20)));
+    }
     return true;
 }
+
+// Waits on the client's timers in short slices, like the blocking version,
+// so a cancel does not have to sit out a long delay
+static void waitDelay(ExecutionContext& context, std::chrono::steady_clock::time_point deadline,
+                      std::function<void(bool)> done) {
+    if (context.isCancelled()) {
+        EXEC_TRACE(context, TRACE_INFO, "Delay interrupted, run cancelled");
+        return done(false);
+    }
+    auto remaining = deadline - std::chrono::steady_clock::now();
+    if (remaining <= std::chrono::steady_clock::duration::zero()) {
+        return done(true);
+    }
+    auto slice = std::chrono::ceil<std::chrono::milliseconds>(
+        std::min<std::chrono::steady_clock::duration>(remaining, std::chrono::milliseconds(50)));
+    context.async_http->post([&context, deadline, done = std::move(done)]() mutable {
+        waitDelay(context, deadline, std::move(done));
+    }, slice);
+}
+
+void DelayNode::executeAsync(ExecutionContext& context, std::function<void(bool)> done) {
+    if (!context.async_http) return done(execute(context));
+
+    int delay = std::atoi(delay_ms);
+    EXEC_TRACE(context, TRACE_DEBUG, "Delaying for " + std::to_string(delay) + "ms");
+    waitDelay(context, std::chrono::steady_clock::now() + std::chrono::milliseconds(delay), std::move(done));
+}
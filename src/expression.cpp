@@ -0,0 +1,784 @@
+#include "expression.h"
+#include "executor.h"
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Recursive descent over the expression text, emitting postfix code
+class ExpressionParser {
+public:
+    ExpressionParser(const std::string& text, Expression& expression, std::string& error)
+        : text(text), expression(expression), error(error) {}
+
+    bool parse() {
+        skipSpace();
+        if (position == text.size()) return fail("empty expression");
+        if (!orExpression()) return false;
+        skipSpace();
+        if (position < text.size()) return fail(std::string("unexpected '") + peek() + "'");
+        if (max_depth > Expression::MAX_DEPTH) return fail("expression is nested too deeply");
+        return true;
+    }
+
+private:
+    using Op = Expression::Op;
+
+    const std::string& text;
+    Expression& expression;
+    std::string& error;
+    size_t position = 0;
+    // Stack depth of the code emitted so far
+    int depth = 0;
+    int max_depth = 0;
+    // Levels of unary() currently being parsed
+    static constexpr int MAX_NESTING = 256;
+    int nesting = 0;
+
+    struct Function {
+        const char* name;
+        Op op;
+        int arguments;
+    };
+
+    static constexpr Function functions[] = {
+        {"len", Op::Length, 1},
+        {"contains", Op::Contains, 2},
+        {"starts_with", Op::StartsWith, 2},
+        {"ends_with", Op::EndsWith, 2},
+        {"lower", Op::Lower, 1},
+        {"upper", Op::Upper, 1},
+        {"num", Op::ToNumber, 1},
+        {"str", Op::ToString, 1},
+    };
+
+    char peek(size_t ahead = 0) const {
+        return position + ahead < text.size() ? text[position + ahead] : '\0';
+    }
+
+    void skipSpace() {
+        while (position < text.size() && strchr(" \t\r\n", text[position])) position++;
+    }
+
+    bool fail(const std::string& message) {
+        error = message + " at position " + std::to_string(position);
+        return false;
+    }
+
+    bool expect(char c) {
+        skipSpace();
+        if (peek() != c) return fail(std::string("expected '") + c + "'");
+        position++;
+        return true;
+    }
+
+    static bool isNameStart(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    static bool isNameChar(char c) {
+        return isNameStart(c) || (c >= '0' && c <= '9');
+    }
+
+    // Characters that end a dotted key of a path: spaces and operators
+    static bool isKeyChar(char c) {
+        return c != '\0' && !strchr(" \t\r\n.[]()=!<>&|'\"+-*/%,", c);
+    }
+
+    // Operator spelled with symbols, consumed when present
+    bool symbol(const char* spelling) {
+        size_t length = strlen(spelling);
+        if (text.compare(position, length, spelling) != 0) return false;
+        position += length;
+        return true;
+    }
+
+    // Word operator, consumed when present as a whole word
+    bool keyword(const char* word) {
+        size_t length = strlen(word);
+        if (text.compare(position, length, word) != 0 || isNameChar(peek(length))) return false;
+        position += length;
+        return true;
+    }
+
+    // Returns the instruction's position, for patching jumps
+    size_t emit(Op op, int operand = -1) {
+        switch (op) {
+            case Op::Constant: case Op::Variable: case Op::Path: case Op::PathCount:
+            case Op::StatusCode: case Op::Body: case Op::ResponseTime:
+                depth++;
+                if (depth > max_depth) max_depth = depth;
+                break;
+            case Op::Not: case Op::Negate: case Op::Truth: case Op::Length:
+            case Op::Lower: case Op::Upper: case Op::ToNumber: case Op::ToString:
+                break;
+            default:
+                depth--;
+                break;
+        }
+        expression.code.push_back({op, operand});
+        return expression.code.size() - 1;
+    }
+
+    void constant(Expression::Constant value) {
+        emit(Op::Constant, int(expression.constant_values.size()));
+        expression.constant_values.push_back(std::move(value));
+    }
+
+    // a || b runs b only when a is falsy; either way the result is a bool
+    bool orExpression() {
+        if (!andExpression()) return false;
+        while (skipSpace(), symbol("||") || keyword("or")) {
+            size_t jump = emit(Op::Or);
+            if (!andExpression()) return false;
+            emit(Op::Truth);
+            expression.code[jump].operand = int(expression.code.size());
+        }
+        return true;
+    }
+
+    bool andExpression() {
+        if (!equality()) return false;
+        while (skipSpace(), symbol("&&") || keyword("and")) {
+            size_t jump = emit(Op::And);
+            if (!equality()) return false;
+            emit(Op::Truth);
+            expression.code[jump].operand = int(expression.code.size());
+        }
+        return true;
+    }
+
+    bool equality() {
+        if (!comparison()) return false;
+        for (;;) {
+            skipSpace();
+            Op op;
+            if (symbol("==")) op = Op::Equal;
+            else if (symbol("!=")) op = Op::NotEqual;
+            else if (peek() == '=') return fail("use == to compare");
+            else return true;
+            if (!comparison()) return false;
+            emit(op);
+        }
+    }
+
+    bool comparison() {
+        if (!additive()) return false;
+        for (;;) {
+            skipSpace();
+            Op op;
+            if (symbol("<=")) op = Op::LessEqual;
+            else if (symbol(">=")) op = Op::GreaterEqual;
+            else if (symbol("<")) op = Op::Less;
+            else if (symbol(">")) op = Op::Greater;
+            else return true;
+            if (!additive()) return false;
+            emit(op);
+        }
+    }
+
+    bool additive() {
+        if (!multiplicative()) return false;
+        for (;;) {
+            skipSpace();
+            Op op;
+            if (symbol("+")) op = Op::Add;
+            else if (symbol("-")) op = Op::Subtract;
+            else return true;
+            if (!multiplicative()) return false;
+            emit(op);
+        }
+    }
+
+    bool multiplicative() {
+        if (!unary()) return false;
+        for (;;) {
+            skipSpace();
+            Op op;
+            if (symbol("*")) op = Op::Multiply;
+            else if (symbol("/")) op = Op::Divide;
+            else if (symbol("%")) op = Op::Modulo;
+            else return true;
+            if (!unary()) return false;
+            emit(op);
+        }
+    }
+
+    // Guards the recursion: parentheses and unary operators nest without
+    // deepening the value stack, so MAX_DEPTH alone does not bound them
+    bool unary() {
+        if (nesting == MAX_NESTING) return fail("expression is nested too deeply");
+        nesting++;
+        bool parsed = unaryOperand();
+        nesting--;
+        return parsed;
+    }
+
+    bool unaryOperand() {
+        skipSpace();
+        if ((peek() == '!' && peek(1) != '=') || keyword("not")) {
+            if (peek() == '!') position++;
+            if (!unary()) return false;
+            emit(Op::Not);
+            return true;
+        }
+        if (peek() == '-' && !((peek(1) >= '0' && peek(1) <= '9') || peek(1) == '.')) {
+            position++;
+            if (!unary()) return false;
+            emit(Op::Negate);
+            return true;
+        }
+        return primary();
+    }
+
+    bool primary() {
+        skipSpace();
+        char c = peek();
+        if (c == '(') {
+            position++;
+            return orExpression() && expect(')');
+        }
+        if (c == '\'' || c == '"') {
+            Expression::Constant value;
+            value.type = Expression::Value::Type::String;
+            if (!quoted(value.text)) return false;
+            constant(std::move(value));
+            return true;
+        }
+        if (c == '-' || c == '.' || (c >= '0' && c <= '9')) {
+            Expression::Constant value;
+            value.type = Expression::Value::Type::Number;
+            const char* begin = text.data() + position;
+            auto result = std::from_chars(begin, text.data() + text.size(), value.number);
+            if (result.ec != std::errc() || !std::isfinite(value.number)) return fail("invalid number");
+            position += result.ptr - begin;
+            constant(std::move(value));
+            return true;
+        }
+        if (c == '$') return path(Op::Path);
+        if (!isNameStart(c)) return fail("expected a number, string, path, name or '('");
+
+        size_t start = position;
+        while (isNameChar(peek())) position++;
+        std::string name = text.substr(start, position - start);
+        if (name == "true" || name == "false") {
+            Expression::Constant value;
+            value.type = Expression::Value::Type::Bool;
+            value.boolean = name == "true";
+            constant(std::move(value));
+            return true;
+        }
+        if (name == "null") {
+            constant(Expression::Constant());
+            return true;
+        }
+        if (name == "and" || name == "or" || name == "not") {
+            position = start;
+            return fail("expected an operand before '" + name + "'");
+        }
+
+        skipSpace();
+        if (peek() == '(') return call(name);
+
+        if (name == "status_code") emit(Op::StatusCode);
+        else if (name == "body") emit(Op::Body);
+        else if (name == "response_time_ms") emit(Op::ResponseTime);
+        else emit(Op::Variable, intern(name));
+        return true;
+    }
+
+    bool call(const std::string& name) {
+        position++;
+        if (name == "count") {
+            skipSpace();
+            if (peek() != '$') return fail("count takes a path");
+            return path(Op::PathCount) && expect(')');
+        }
+
+        int arguments = 0;
+        skipSpace();
+        if (peek() != ')') {
+            do {
+                if (!orExpression()) return false;
+                arguments++;
+                skipSpace();
+            } while (symbol(","));
+        }
+        if (!expect(')')) return false;
+
+        if (name == "exists") {
+            if (arguments != 1) return fail("exists takes 1 argument");
+            constant(Expression::Constant());
+            emit(Op::NotEqual);
+            return true;
+        }
+        for (const Function& function : functions) {
+            if (name != function.name) continue;
+            if (arguments != function.arguments) {
+                return fail(name + " takes " + std::to_string(function.arguments) +
+                            (function.arguments == 1 ? " argument" : " arguments"));
+            }
+            emit(function.op);
+            return true;
+        }
+        return fail("unknown function '" + name + "'");
+    }
+
+    // The path text runs over dotted keys and bracketed segments; it is then
+    // compiled by JsonPath, and repeated paths share one compiled copy
+    bool path(Op op) {
+        size_t start = position++;
+        for (;;) {
+            if (peek() == '.') {
+                position++;
+                if (peek() == '*') position++;
+                else while (isKeyChar(peek())) position++;
+            } else if (peek() == '[') {
+                if (!bracket()) return false;
+            } else {
+                break;
+            }
+        }
+
+        std::string source = text.substr(start, position - start);
+        int index = -1;
+        for (size_t i = 0; i < expression.json_paths.size(); i++) {
+            if (expression.json_paths[i]->getText() == source) index = int(i);
+        }
+        if (index < 0) {
+            auto compiled = std::make_shared<JsonPath>();
+            std::string path_error;
+            if (!compiled->compile(source, path_error)) {
+                position = start;
+                return fail("invalid path '" + source + "' (" + path_error + ")");
+            }
+            index = int(expression.json_paths.size());
+            expression.json_paths.push_back(std::move(compiled));
+        }
+        emit(op, index);
+        return true;
+    }
+
+    // Skips a [...] segment, brackets and quotes inside filters included
+    bool bracket() {
+        size_t start = position;
+        int nesting = 0;
+        while (position < text.size()) {
+            char c = text[position++];
+            if (c == '\'' || c == '"') {
+                while (position < text.size() && text[position] != c) {
+                    if (text[position] == '\\') position++;
+                    position++;
+                }
+                if (position >= text.size()) break;
+                position++;
+            } else if (c == '[') {
+                nesting++;
+            } else if (c == ']' && --nesting == 0) {
+                return true;
+            }
+        }
+        position = start;
+        return fail("unterminated '['");
+    }
+
+    bool quoted(std::string& value) {
+        char quote = text[position++];
+        value.clear();
+        while (position < text.size() && text[position] != quote) {
+            char c = text[position++];
+            if (c == '\\' && position < text.size()) {
+                c = text[position++];
+                if (c == 'n') c = '\n';
+                else if (c == 't') c = '\t';
+                else if (c == 'r') c = '\r';
+            }
+            value += c;
+        }
+        if (position >= text.size()) return fail("unterminated string");
+        position++;
+        return true;
+    }
+
+    int intern(const std::string& name) {
+        auto& names = expression.variable_names;
+        for (size_t i = 0; i < names.size(); i++) {
+            if (names[i] == name) return int(i);
+        }
+        names.push_back(name);
+        return int(names.size() - 1);
+    }
+};
+
+bool Expression::compile(const std::string& expression_text, std::string& error) {
+    *this = Expression();
+    text = expression_text;
+    ExpressionParser parser(expression_text, *this, error);
+    if (!parser.parse()) {
+        std::string source = std::move(text);
+        *this = Expression();
+        text = std::move(source);
+        return false;
+    }
+    return true;
+}
+
+void Expression::resolveVariables() {
+    variable_slots.clear();
+    for (const std::string& name : variable_names) {
+        variable_slots.push_back(VariableNames::instance().intern(name));
+    }
+}
+
+// ---- Evaluation ----
+
+struct Expression::Evaluation {
+    ExecutionContext& context;
+    // Strings made while evaluating (concatenations, unescaped JSON
+    // strings), kept until the result has been used
+    std::vector<BodyBuffer> buffers;
+    // Variables read so far: another branch may set them meanwhile, so the
+    // values are held here. The first few need no allocation.
+    static constexpr size_t HELD_INLINE = 4;
+    BodyBuffer held[HELD_INLINE];
+    size_t held_count = 0;
+    // Index of the last response, looked up by the first path that needs it
+    std::shared_ptr<const JsonIndex> index;
+    bool index_looked_up = false;
+
+    explicit Evaluation(ExecutionContext& context) : context(context) {}
+};
+
+namespace {
+
+using Value = Expression::Value;
+using Type = Value::Type;
+using Op = Expression::Op;
+
+Value makeBool(bool boolean) {
+    Value value;
+    value.type = Type::Bool;
+    value.boolean = boolean;
+    return value;
+}
+
+Value makeNumber(double number) {
+    Value value;
+    value.type = Type::Number;
+    value.number = number;
+    return value;
+}
+
+Value makeString(std::string_view text) {
+    Value value;
+    value.type = Type::String;
+    value.text = text;
+    return value;
+}
+
+bool truthy(const Value& value) {
+    switch (value.type) {
+        case Type::Bool: return value.boolean;
+        case Type::Number: return value.number != 0 && !std::isnan(value.number);
+        case Type::String: return !value.text.empty();
+        default: return false;
+    }
+}
+
+// Whole text must be a finite number; "inf" and "nan" do not count
+bool parseNumber(std::string_view text, double& number) {
+    if (text.empty() || !(text[0] == '-' || text[0] == '.' || (text[0] >= '0' && text[0] <= '9'))) return false;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), number);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+bool toNumber(const Value& value, double& number) {
+    if (value.type == Type::Number) {
+        number = value.number;
+        return true;
+    }
+    return value.type == Type::String && parseNumber(value.text, number);
+}
+
+void format(const Value& value, std::string& out) {
+    switch (value.type) {
+        case Type::Null: out += "null"; break;
+        case Type::Bool: out += value.boolean ? "true" : "false"; break;
+        case Type::Number: {
+            char digits[32];
+            auto result = std::to_chars(digits, digits + sizeof(digits), value.number);
+            out.append(digits, result.ptr);
+            break;
+        }
+        case Type::String: out += value.text; break;
+    }
+}
+
+Value own(Expression::Evaluation& evaluation, std::string text) {
+    evaluation.buffers.emplace_back(std::move(text));
+    return makeString(evaluation.buffers.back().view());
+}
+
+bool equal(const Value& a, const Value& b) {
+    if (a.type == b.type) {
+        switch (a.type) {
+            case Type::Null: return true;
+            case Type::Bool: return a.boolean == b.boolean;
+            case Type::Number: return a.number == b.number;
+            case Type::String: return a.text == b.text;
+        }
+    }
+    double x, y;
+    return toNumber(a, x) && toNumber(b, y) && x == y;
+}
+
+// Numbers (numeric strings included) by value, other strings by bytes;
+// anything else does not compare
+bool ordered(Op op, const Value& a, const Value& b) {
+    int order;
+    double x, y;
+    if (toNumber(a, x) && toNumber(b, y)) {
+        if (std::isnan(x) || std::isnan(y)) return false;
+        order = x < y ? -1 : (x > y ? 1 : 0);
+    } else if (a.type == Type::String && b.type == Type::String) {
+        order = a.text.compare(b.text);
+    } else {
+        return false;
+    }
+    switch (op) {
+        case Op::Less: return order < 0;
+        case Op::LessEqual: return order <= 0;
+        case Op::Greater: return order > 0;
+        default: return order >= 0;
+    }
+}
+
+Value arithmetic(Expression::Evaluation& evaluation, Op op, const Value& a, const Value& b) {
+    double x, y;
+    bool numeric = toNumber(a, x) && toNumber(b, y);
+    if (op == Op::Add && (!numeric || (a.type == Type::String && b.type == Type::String))) {
+        if (a.type != Type::String && b.type != Type::String) return Value();
+        std::string joined;
+        format(a, joined);
+        format(b, joined);
+        return own(evaluation, std::move(joined));
+    }
+    if (!numeric) return Value();
+    switch (op) {
+        case Op::Add: return makeNumber(x + y);
+        case Op::Subtract: return makeNumber(x - y);
+        case Op::Multiply: return makeNumber(x * y);
+        case Op::Divide: return y != 0 ? makeNumber(x / y) : Value();
+        default: return y != 0 ? makeNumber(std::fmod(x, y)) : Value();
+    }
+}
+
+// Strings as they are; other values formatted into a buffer
+std::string_view textOf(Expression::Evaluation& evaluation, const Value& value) {
+    if (value.type == Type::String) return value.text;
+    std::string text;
+    format(value, text);
+    return own(evaluation, std::move(text)).text;
+}
+
+Value caseOf(Expression::Evaluation& evaluation, const Value& value, bool upper) {
+    if (value.type != Type::String) return value;
+    std::string text(value.text);
+    for (char& c : text) {
+        if (upper && c >= 'a' && c <= 'z') c = char(c - 'a' + 'A');
+        if (!upper && c >= 'A' && c <= 'Z') c = char(c - 'A' + 'a');
+    }
+    return own(evaluation, std::move(text));
+}
+
+Value fromJson(Expression::Evaluation& evaluation, const JsonValue& json) {
+    switch (json.type) {
+        case JsonType::Bool: return makeBool(json.raw[0] == 't');
+        case JsonType::Number: {
+            double number;
+            return parseNumber(json.raw, number) ? makeNumber(number) : makeString(json.raw);
+        }
+        case JsonType::String:
+            return json.hasEscapes() ? own(evaluation, json.text()) : makeString(json.unquoted());
+        case JsonType::Object:
+        case JsonType::Array:
+            return makeString(json.raw);
+        default:
+            return Value();
+    }
+}
+
+const JsonIndex* responseIndex(Expression::Evaluation& evaluation) {
+    if (!evaluation.index_looked_up) {
+        evaluation.index = evaluation.context.jsonIndex(evaluation.context.last_response_body);
+        evaluation.index_looked_up = true;
+    }
+    return evaluation.index.get();
+}
+
+// Like the JSON extract node: a singular path gives its value, any other
+// path a JSON array of every match
+Value pathValue(Expression::Evaluation& evaluation, const JsonPath& path) {
+    std::string_view body = evaluation.context.last_response_body.view();
+    const JsonIndex* index = responseIndex(evaluation);
+    if (path.isSingular()) {
+        JsonValue value;
+        bool found = index ? extractJson(*index, path, value) : extractJson(body, path, value);
+        return found ? fromJson(evaluation, value) : Value();
+    }
+    std::vector<JsonValue> values;
+    bool valid = index ? extractJsonAll(*index, path, values) : extractJsonAll(body, path, values);
+    if (!valid) return Value();
+    std::string list = "[";
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i > 0) list += ',';
+        list += values[i].raw;
+    }
+    list += ']';
+    return own(evaluation, std::move(list));
+}
+
+Value pathCount(Expression::Evaluation& evaluation, const JsonPath& path) {
+    std::string_view body = evaluation.context.last_response_body.view();
+    const JsonIndex* index = responseIndex(evaluation);
+    std::vector<JsonValue> values;
+    bool valid = index ? extractJsonAll(*index, path, values) : extractJsonAll(body, path, values);
+    return valid ? makeNumber(double(values.size())) : Value();
+}
+
+Value variableValue(Expression::Evaluation& evaluation, uint32_t slot) {
+    VariableValue value = evaluation.context.getVariable(slot);
+    if (const bool* boolean = std::get_if<bool>(&value)) return makeBool(*boolean);
+    if (const int64_t* integer = std::get_if<int64_t>(&value)) return makeNumber(double(*integer));
+    if (const double* number = std::get_if<double>(&value)) return makeNumber(*number);
+    if (std::holds_alternative<std::monostate>(value)) return Value();
+
+    BodyBuffer text = variableText(value);
+    if (evaluation.held_count < Expression::Evaluation::HELD_INLINE) {
+        evaluation.held[evaluation.held_count++] = std::move(text);
+        return makeString(evaluation.held[evaluation.held_count - 1].view());
+    }
+    evaluation.buffers.push_back(std::move(text));
+    return makeString(evaluation.buffers.back().view());
+}
+
+} // namespace
+
+Expression::Value Expression::evaluate(Evaluation& evaluation) const {
+    // Left uninitialized: every slot is written before it is read
+    alignas(Value) unsigned char storage[sizeof(Value) * MAX_DEPTH];
+    Value* stack = reinterpret_cast<Value*>(storage);
+    int top = -1;
+    ExecutionContext& context = evaluation.context;
+
+    const size_t size = code.size();
+    for (size_t pc = 0; pc < size; pc++) {
+        const Instruction& instruction = code[pc];
+        switch (instruction.op) {
+            case Op::Constant: {
+                const Constant& constant = constant_values[instruction.operand];
+                Value& value = stack[++top];
+                value.type = constant.type;
+                value.boolean = constant.boolean;
+                value.number = constant.number;
+                value.text = constant.text;
+                break;
+            }
+            case Op::Variable: {
+                uint32_t slot = variable_slots.empty() ? VariableNames::instance().find(variable_names[instruction.operand])
+                                                       : variable_slots[instruction.operand];
+                stack[++top] = slot != VariableNames::npos ? variableValue(evaluation, slot) : Value();
+                break;
+            }
+            case Op::Path: stack[++top] = pathValue(evaluation, *json_paths[instruction.operand]); break;
+            case Op::PathCount: stack[++top] = pathCount(evaluation, *json_paths[instruction.operand]); break;
+            case Op::StatusCode: stack[++top] = makeNumber(context.last_status_code); break;
+            case Op::Body: stack[++top] = makeString(context.last_response_body.view()); break;
+            case Op::ResponseTime: stack[++top] = makeNumber(context.last_timings.total_us / 1000.0); break;
+
+            case Op::Not: stack[top] = makeBool(!truthy(stack[top])); break;
+            case Op::Truth: stack[top] = makeBool(truthy(stack[top])); break;
+            case Op::Negate: {
+                double number;
+                stack[top] = toNumber(stack[top], number) ? makeNumber(-number) : Value();
+                break;
+            }
+
+            case Op::Add: case Op::Subtract: case Op::Multiply: case Op::Divide: case Op::Modulo:
+                top--;
+                stack[top] = arithmetic(evaluation, instruction.op, stack[top], stack[top + 1]);
+                break;
+            case Op::Equal:
+                top--;
+                stack[top] = makeBool(equal(stack[top], stack[top + 1]));
+                break;
+            case Op::NotEqual:
+                top--;
+                stack[top] = makeBool(!equal(stack[top], stack[top + 1]));
+                break;
+            case Op::Less: case Op::LessEqual: case Op::Greater: case Op::GreaterEqual:
+                top--;
+                stack[top] = makeBool(ordered(instruction.op, stack[top], stack[top + 1]));
+                break;
+
+            case Op::And:
+            case Op::Or:
+                if (truthy(stack[top]) == (instruction.op == Op::Or)) {
+                    stack[top] = makeBool(instruction.op == Op::Or);
+                    pc = size_t(instruction.operand) - 1;
+                } else {
+                    top--;
+                }
+                break;
+
+            case Op::Length:
+                stack[top] = stack[top].type == Type::String ? makeNumber(double(stack[top].text.size())) : Value();
+                break;
+            case Op::Contains: case Op::StartsWith: case Op::EndsWith: {
+                top--;
+                if (stack[top].type == Type::Null || stack[top + 1].type == Type::Null) {
+                    stack[top] = makeBool(false);
+                    break;
+                }
+                std::string_view haystack = textOf(evaluation, stack[top]);
+                std::string_view needle = textOf(evaluation, stack[top + 1]);
+                bool found;
+                if (instruction.op == Op::Contains) {
+                    found = haystack.find(needle) != std::string_view::npos;
+                } else if (needle.size() > haystack.size()) {
+                    found = false;
+                } else if (instruction.op == Op::StartsWith) {
+                    found = haystack.compare(0, needle.size(), needle) == 0;
+                } else {
+                    found = haystack.compare(haystack.size() - needle.size(), needle.size(), needle) == 0;
+                }
+                stack[top] = makeBool(found);
+                break;
+            }
+            case Op::Lower: stack[top] = caseOf(evaluation, stack[top], false); break;
+            case Op::Upper: stack[top] = caseOf(evaluation, stack[top], true); break;
+            case Op::ToNumber: {
+                double number;
+                if (stack[top].type == Type::Bool) stack[top] = makeNumber(stack[top].boolean ? 1 : 0);
+                else stack[top] = toNumber(stack[top], number) ? makeNumber(number) : Value();
+                break;
+            }
+            case Op::ToString:
+                stack[top] = makeString(textOf(evaluation, stack[top]));
+                break;
+        }
+    }
+    return top >= 0 ? stack[top] : Value();
+}
+
+bool Expression::test(ExecutionContext& context) const {
+    Evaluation evaluation(context);
+    return truthy(evaluate(evaluation));
+}
+
+std::string Expression::evaluateToString(ExecutionContext& context) const {
+    Evaluation evaluation(context);
+    std::string text;
+    format(evaluate(evaluation), text);
+    return text;
+}
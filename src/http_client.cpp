@@ -1,23 +1,110 @@
 #include "http_client.h"
+#include "curl_share.h"
 #include <curl/curl.h>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <sstream>
 #include <iostream>
 
 HttpClient::HttpClient() {
-    curl_global_init(CURL_GLOBAL_DEFAULT);
+    // Makes sure curl is initialized before the first handle is created
+    CurlShare::instance();
 }
 
 HttpClient::~HttpClient() {
-    curl_global_cleanup();
+    for (auto& [origin, handles] : idle_handles) {
+        for (CURL* curl : handles) {
+            curl_easy_cleanup(curl);
+        }
+    }
+}
+
+// scheme://host[:port] part of a URL, used as the pool key
+static std::string originOf(const std::string& url) {
+    size_t host_start = url.find("://");
+    host_start = host_start == std::string::npos ? 0 : host_start + 3;
+    size_t host_end = url.find_first_of("/?#", host_start);
+    return url.substr(0, host_end);
+}
+
+CURL* HttpClient::acquireHandle(const std::string& origin) {
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        // Only a handle that last talked to this origin has a connection to
+        // reuse; DNS and TLS sessions come from the share whatever the handle,
+        // so taking another origin's would only spend its warm connections
+        auto it = idle_handles.find(origin);
+        if (it != idle_handles.end() && !it->second.empty()) {
+            CURL* curl = it->second.back();
+            it->second.pop_back();
+            idle_count--;
+            return curl;
+        }
+    }
+    return curl_easy_init();
 }
 
-size_t HttpClient::writeCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-    ((std::string*)userp)->append((char*)contents, size * nmemb);
+void HttpClient::releaseHandle(const std::string& origin, CURL* curl) {
+    // Drops all options but keeps the handle's connection cache
+    curl_easy_reset(curl);
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (idle_count < MAX_IDLE_HANDLES) {
+            idle_handles[origin].push_back(curl);
+            idle_count++;
+            return;
+        }
+    }
+    curl_easy_cleanup(curl);
+}
+
+size_t HttpTransfer::writeCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    auto* transfer = static_cast<HttpTransfer*>(userp);
+    if (transfer->stream) {
+        return transfer->streamBody(static_cast<const char*>(contents), size * nmemb);
+    }
+    // Anything short of the full size fails the transfer with CURLE_WRITE_ERROR
+    if (!transfer->received.append(static_cast<const char*>(contents), size * nmemb)) {
+        return 0;
+    }
     return size * nmemb;
 }
 
-size_t HttpClient::headerCallback(char* buffer, size_t size, size_t nitems, void* userdata) {
-    auto* headers = (std::map<std::string, std::string>*)userdata;
+// Feeds the body to the stream extractor instead of keeping it. Once the
+// extractor has all it needs (or the body turned out not to be JSON), a
+// short remainder is still read so the connection can be reused, and a
+// long or unknown one ends the transfer right away.
+size_t HttpTransfer::streamBody(const char* data, size_t length) {
+    streamed_bytes += length;
+    if (draining) return length;
+    if (stream->feed(std::string_view(data, length)) && !stream->done()) return length;
+
+    // Content-Length counts encoded bytes; HTTP/2 only resets the stream, so
+    // aborting costs nothing there
+    long http_version = 0;
+    curl_easy_getinfo(handle, CURLINFO_HTTP_VERSION, &http_version);
+    long long remaining = expected_length - static_cast<long long>(streamed_bytes);
+    if (expected_length >= 0 && !content_encoded && http_version != CURL_HTTP_VERSION_2_0 &&
+        remaining <= DRAIN_LIMIT) {
+        draining = true;
+        return length;
+    }
+    stream_stopped = true;
+    return 0;
+}
+
+static bool isHeader(const std::string& key, const char* name) {
+    size_t length = strlen(name);
+    if (key.size() != length) return false;
+    for (size_t i = 0; i < length; i++) {
+        if (std::tolower(static_cast<unsigned char>(key[i])) != name[i]) return false;
+    }
+    return true;
+}
+
+size_t HttpTransfer::headerCallback(char* buffer, size_t size, size_t nitems, void* userdata) {
+    auto* transfer = static_cast<HttpTransfer*>(userdata);
     std::string header(buffer, size * nitems);
     
     size_t separator = header.find(':');
@@ -27,81 +114,328 @@ size_t HttpClient::headerCallback(char* buffer, size_t size, size_t nitems, void
         
         value.erase(0, value.find_first_not_of(" \t\r\n"));
         value.erase(value.find_last_not_of(" \t\r\n") + 1);
+
+        if (isHeader(key, "content-length")) {
+            transfer->expected_length = std::strtoll(value.c_str(), nullptr, 10);
+            // Size the body once instead of growing it chunk by chunk
+            if (!transfer->stream) transfer->received.reserve(std::strtoull(value.c_str(), nullptr, 10));
+        } else if (isHeader(key, "content-encoding")) {
+            transfer->content_encoded = true;
+        }
         
-        headers->insert({key, value});
+        transfer->response.headers.insert({key, value});
     }
     
     return size * nitems;
 }
 
-HttpResponse HttpClient::performRequest(const std::string& method, const std::string& url, 
-                                       const std::string& body, const std::map<std::string, std::string>& headers) {
-    HttpResponse response;
-    response.success = false;
-    response.status_code = 0;
-    
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        response.error_message = "Failed to initialize CURL";
-        return response;
+static void readTimings(CURL* curl, HttpTimings& timings) {
+    curl_off_t value = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &value) == CURLE_OK) timings.name_lookup_us = value;
+    if (curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &value) == CURLE_OK) timings.connect_us = value;
+    if (curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &value) == CURLE_OK) timings.app_connect_us = value;
+    if (curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &value) == CURLE_OK) timings.pre_transfer_us = value;
+    if (curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &value) == CURLE_OK) timings.start_transfer_us = value;
+    if (curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &value) == CURLE_OK) timings.total_us = value;
+
+    // Headers count towards the bytes on the wire in both directions
+    long header_bytes = 0;
+    curl_off_t uploaded = 0;
+    curl_off_t downloaded = 0;
+    curl_easy_getinfo(curl, CURLINFO_REQUEST_SIZE, &header_bytes);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &uploaded);
+    timings.bytes_sent = header_bytes + uploaded;
+    header_bytes = 0;
+    curl_easy_getinfo(curl, CURLINFO_HEADER_SIZE, &header_bytes);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+    timings.bytes_received = header_bytes + downloaded;
+
+    long http_version = 0;
+    curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &http_version);
+    timings.http2 = http_version == CURL_HTTP_VERSION_2_0;
+
+    // The transfer got going without opening a new connection
+    long new_connections = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &new_connections);
+    timings.connection_reused = new_connections == 0 && timings.pre_transfer_us > 0;
+}
+
+static int progressCallback(void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    auto* cancel_flag = static_cast<const std::atomic<bool>*>(clientp);
+    // Non-zero aborts the transfer with CURLE_ABORTED_BY_CALLBACK
+    return cancel_flag->load(std::memory_order_relaxed) ? 1 : 0;
+}
+
+HeaderList::HeaderList(const std::string& text) {
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) end = text.size();
+
+        size_t colon = text.find(':', start);
+        if (colon < end) {
+            auto trimmed = [&](size_t from, size_t to) {
+                while (from < to && (text[from] == ' ' || text[from] == '\t' || text[from] == '\r')) from++;
+                while (to > from && (text[to - 1] == ' ' || text[to - 1] == '\t' || text[to - 1] == '\r')) to--;
+                return text.substr(from, to - from);
+            };
+            headers[trimmed(start, colon)] = trimmed(colon + 1, end);
+        }
+        start = end + 1;
     }
-    
-    std::string response_body;
-    
+    build();
+}
+
+HeaderList::HeaderList(const std::map<std::string, std::string>& entries) : headers(entries) {
+    build();
+}
+
+HeaderList::~HeaderList() {
+    if (list) {
+        curl_slist_free_all(list);
+    }
+}
+
+void HeaderList::build() {
+    for (const auto& [key, value] : headers) {
+        std::string header = key + ": " + value;
+        list = curl_slist_append(list, header.c_str());
+    }
+}
+
+HttpTransfer::~HttpTransfer() = default;
+
+// libcurl 7.88 fails every request after the first on a reused h2c (prior
+// knowledge over http://) connection with CURLE_HTTP2. With those versions
+// each such request gets a connection of its own; TLS is not affected.
+static bool h2cReuseBroken() {
+    static const bool broken = curl_version_info(CURLVERSION_NOW)->version_num < 0x080000;
+    return broken;
+}
+
+void HttpTransfer::prepare(CURL* curl, const HttpRequest& request, const std::atomic<bool>* cancel_flag,
+                           HttpVersion version, const HttpOptions& options) {
+    const std::string& url = request.url;
+    CurlShare::instance().attach(curl);
     curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_body);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
     curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerCallback);
-    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &response.headers);
-    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method.c_str());
-    
-    struct curl_slist* curl_headers = nullptr;
-    for (const auto& [key, value] : headers) {
-        std::string header = key + ": " + value;
-        curl_headers = curl_slist_append(curl_headers, header.c_str());
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, this);
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, request.method.c_str());
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    received.setSpoolThreshold(options.spool_threshold);
+    handle = curl;
+    if (request.stream_paths) {
+        stream = std::make_unique<JsonStreamExtractor>(request.stream_paths);
+    }
+    if (options.compression) {
+        // An empty string lists all encodings this libcurl can decode
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    }
+
+    if (version == HttpVersion::Http2PriorKnowledge && url.compare(0, 7, "http://") == 0 && h2cReuseBroken()) {
+        curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE);
+        curl_easy_setopt(curl, CURLOPT_FRESH_CONNECT, 1L);
+        curl_easy_setopt(curl, CURLOPT_FORBID_REUSE, 1L);
+    } else if (version != HttpVersion::Http1) {
+        curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, version == HttpVersion::Http2PriorKnowledge
+                                                         ? CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE
+                                                         : CURL_HTTP_VERSION_2TLS);
+        // Wait for a connection that is still being set up to turn out
+        // multiplexable rather than opening a second one next to it
+        curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
     }
-    if (curl_headers) {
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, curl_headers);
+    
+    if (cancel_flag) {
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, progressCallback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, cancel_flag);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
     }
     
-    if (!body.empty()) {
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, body.length());
+    // Nodes hand in their cached list; only ad-hoc requests build one here
+    shared_headers = request.header_list;
+    if (!shared_headers && !request.headers.empty()) {
+        own_headers = std::make_unique<HeaderList>(request.headers);
+    }
+    const HeaderList* headers = shared_headers ? shared_headers.get() : own_headers.get();
+    if (headers && headers->slist()) {
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers->slist());
     }
     
-    CURLcode res = curl_easy_perform(curl);
+    if (!request.body.empty()) {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.body.c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, request.body.length());
+    }
+}
+
+void HttpTransfer::finish(CURL* curl, CURLcode result) {
+    readTimings(curl, response.timings);
+    // A streamed body cut short once its paths were satisfied
+    if (result == CURLE_WRITE_ERROR && stream_stopped) {
+        result = CURLE_OK;
+    }
     
-    if (res != CURLE_OK) {
-        response.error_message = curl_easy_strerror(res);
+    if (result != CURLE_OK) {
+        response.error_message = curl_easy_strerror(result);
+        received.clear();
         response.success = false;
     } else {
         long http_code = 0;
         curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
         response.status_code = static_cast<int>(http_code);
-        response.body = response_body;
+        if (stream) {
+            response.streamed = stream->finish();
+            response.timings.bytes_decoded = static_cast<long long>(streamed_bytes);
+        } else if (!received.finish(response.body)) {
+            response.error_message = "Failed to read spooled response body";
+            response.success = false;
+            return;
+        } else {
+            response.timings.bytes_decoded = static_cast<long long>(response.body.size());
+        }
         response.success = true;
     }
+}
+
+void HttpTransfer::reset() {
+    own_headers.reset();
+    shared_headers.reset();
+    response = HttpResponse();
+    received.clear();
+    stream.reset();
+    handle = nullptr;
+    streamed_bytes = 0;
+    expected_length = -1;
+    content_encoded = false;
+    draining = false;
+    stream_stopped = false;
+}
+
+void HttpVersionPolicy::setVersion(HttpVersion requested) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (version == requested) return;
+    version = requested;
+    http1_origins.clear();
+    strikes.clear();
+    has_strikes.store(false, std::memory_order_relaxed);
+}
+
+HttpVersion HttpVersionPolicy::versionFor(const std::string& url) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (version == HttpVersion::Http2PriorKnowledge && http1_origins.count(originOf(url))) {
+        return HttpVersion::Http1;
+    }
+    return version;
+}
+
+// Methods a server may see twice without harm
+static bool isSafeToRepeat(const std::string& method) {
+    return method == "GET" || method == "HEAD" || method == "OPTIONS";
+}
+
+bool HttpVersionPolicy::fallBack(CURL* curl, const HttpRequest& request, CURLcode result) {
+    // ALPN negotiation falls back by itself; only prior knowledge can hit a
+    // server that does not understand the connection preface. An HTTP/1.1
+    // server answers it with a reply curl cannot read as HTTP/2, or closes
+    // the connection without a word; send and receive errors only count as
+    // strikes, since a real h2c server resetting a connection looks the same.
+    bool rejected;
+    switch (result) {
+        case CURLE_HTTP2:
+        case CURLE_WEIRD_SERVER_REPLY:
+        case CURLE_GOT_NOTHING:
+        case CURLE_UNSUPPORTED_PROTOCOL:
+            rejected = true;
+            break;
+        case CURLE_RECV_ERROR:
+        case CURLE_SEND_ERROR:
+            rejected = false;
+            break;
+        default:
+            return false;
+    }
+
+    // Failures on a connection that already carried HTTP/2, or after part
+    // of a response arrived, have other causes
+    long new_connections = 0;
+    long http_version = 0;
+    curl_off_t received = 0;
+    long header_size = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &new_connections);
+    curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &http_version);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &received);
+    curl_easy_getinfo(curl, CURLINFO_HEADER_SIZE, &header_size);
+    if (new_connections == 0 || http_version == CURL_HTTP_VERSION_2_0) return false;
+    if (result == CURLE_GOT_NOTHING && (received > 0 || header_size > 0)) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (version != HttpVersion::Http2PriorKnowledge) return false;
+    std::string origin = originOf(request.url);
+    if (!rejected) {
+        int& count = strikes[origin];
+        has_strikes.store(true, std::memory_order_relaxed);
+        rejected = ++count >= FALLBACK_STRIKES;
+    }
+    if (rejected) {
+        strikes.erase(origin);
+        has_strikes.store(!strikes.empty(), std::memory_order_relaxed);
+        if (http1_origins.insert(origin).second) {
+            std::cout << origin << " does not speak HTTP/2, falling back to HTTP/1.1" << std::endl;
+        }
+    }
+    // The server may have acted on a request it read before failing; only
+    // requests it may see twice are repeated, whether or not the origin was
+    // given up on
+    return isSafeToRepeat(request.method);
+}
+
+void HttpVersionPolicy::succeeded(const std::string& url) {
+    if (!has_strikes.load(std::memory_order_relaxed)) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    strikes.erase(originOf(url));
+    has_strikes.store(!strikes.empty(), std::memory_order_relaxed);
+}
+
+HttpResponse HttpClient::send(const HttpRequest& request) {
+    const std::string origin = originOf(request.url);
+    CURL* curl = acquireHandle(origin);
+    if (!curl) {
+        HttpResponse response;
+        response.error_message = "Failed to initialize CURL";
+        return response;
+    }
     
-    if (curl_headers) {
-        curl_slist_free_all(curl_headers);
+    HttpTransfer transfer;
+    transfer.prepare(curl, request, cancel_flag, versions.versionFor(request.url), options);
+    CURLcode result = curl_easy_perform(curl);
+    if (result != CURLE_OK && versions.fallBack(curl, request, result)) {
+        curl_easy_reset(curl);
+        transfer.reset();
+        transfer.prepare(curl, request, cancel_flag, HttpVersion::Http1, options);
+        result = curl_easy_perform(curl);
     }
-    curl_easy_cleanup(curl);
+    if (result == CURLE_OK) versions.succeeded(request.url);
+    transfer.finish(curl, result);
+    releaseHandle(origin, curl);
     
-    return response;
+    return std::move(transfer.response);
 }
 
 HttpResponse HttpClient::get(const std::string& url, const std::map<std::string, std::string>& headers) {
-    return performRequest("GET", url, "", headers);
+    return send({"GET", url, "", headers, nullptr, nullptr});
 }
 
 HttpResponse HttpClient::post(const std::string& url, const std::string& body, const std::map<std::string, std::string>& headers) {
-    return performRequest("POST", url, body, headers);
+    return send({"POST", url, body, headers, nullptr, nullptr});
 }
 
 HttpResponse HttpClient::put(const std::string& url, const std::string& body, const std::map<std::string, std::string>& headers) {
-    return performRequest("PUT", url, body, headers);
+    return send({"PUT", url, body, headers, nullptr, nullptr});
 }
 
 HttpResponse HttpClient::del(const std::string& url, const std::map<std::string, std::string>& headers) {
-    return performRequest("DELETE", url, "", headers);
+    return send({"DELETE", url, "", headers, nullptr, nullptr});
 }
@@ -0,0 +1,326 @@
+#include "json_path.h"
+#include <charconv>
+#include <cstring>
+
+// Recursive descent over the path text, emitting straight into a JsonPath
+class JsonPathParser {
+public:
+    JsonPathParser(const std::string& text, JsonPath& path, std::string& error)
+        : text(text), path(path), error(error) {}
+
+    bool parse() {
+        skipSpace();
+        if (position == text.size()) return fail("empty path");
+        // The leading "$" is optional; without it the path may open with a bare key
+        bool first = true;
+        if (peek() == '$') {
+            position++;
+            first = false;
+        }
+        while (skipSpace(), position < text.size()) {
+            if (!segment(path.steps, first, false)) return false;
+            first = false;
+        }
+        return true;
+    }
+
+private:
+    const std::string& text;
+    JsonPath& path;
+    std::string& error;
+    size_t position = 0;
+    // Stack depth of the filter being emitted
+    int depth = 0;
+    int max_depth = 0;
+
+    char peek(size_t ahead = 0) const {
+        return position + ahead < text.size() ? text[position + ahead] : '\0';
+    }
+
+    void skipSpace() {
+        while (position < text.size() && (text[position] == ' ' || text[position] == '\t')) position++;
+    }
+
+    bool fail(const std::string& message) {
+        error = message + " at position " + std::to_string(position);
+        return false;
+    }
+
+    bool expect(char c) {
+        skipSpace();
+        if (peek() != c) return fail(std::string("expected '") + c + "'");
+        position++;
+        return true;
+    }
+
+    static bool isNameChar(char c) {
+        return c != '\0' && !strchr(".[]()=!<>&| \t'\"", c);
+    }
+
+    // One ".name", ".*" or "[...]"; a path may also start with a bare name.
+    // Relative paths (inside filters) only take keys and indices.
+    bool segment(std::vector<JsonPath::Step>& steps, bool first, bool relative) {
+        JsonPath::Step step;
+        if (peek() == '.' && peek(1) == '.') {
+            return fail("recursive descent (..) is not supported");
+        }
+        if (peek() == '.' || (first && isNameChar(peek()))) {
+            if (peek() == '.') position++;
+            if (peek() == '*') {
+                if (relative) return fail("filter paths only take keys and indices");
+                position++;
+                step.kind = JsonPath::StepKind::Wildcard;
+            } else {
+                size_t start = position;
+                while (isNameChar(peek())) position++;
+                if (position == start) return fail("expected a key");
+                step.key = text.substr(start, position - start);
+            }
+        } else if (peek() == '[') {
+            position++;
+            skipSpace();
+            if (!bracket(step, relative) || !expect(']')) return false;
+        } else {
+            return fail(std::string("unexpected '") + peek() + "'");
+        }
+
+        if (step.kind != JsonPath::StepKind::Key && step.kind != JsonPath::StepKind::Index) {
+            path.singular = false;
+        }
+        steps.push_back(std::move(step));
+        return true;
+    }
+
+    bool bracket(JsonPath::Step& step, bool relative) {
+        char c = peek();
+        if (c == '\'' || c == '"') {
+            step.kind = JsonPath::StepKind::Key;
+            return quoted(step.key);
+        }
+        if (relative && !(c >= '0' && c <= '9')) {
+            return fail("filter paths only take keys and indices");
+        }
+        if (c == '*') {
+            position++;
+            step.kind = JsonPath::StepKind::Wildcard;
+            return true;
+        }
+        if (c == '?') {
+            position++;
+            step.kind = JsonPath::StepKind::Filter;
+            return filter(step);
+        }
+
+        // Index or slice: [n], [start:end], [start:end:step], any part optional
+        long bounds[3] = {0, -1, 1};
+        int parts = 0;
+        for (;;) {
+            skipSpace();
+            if (peek() == '-') return fail("negative indices are not supported");
+            if (peek() >= '0' && peek() <= '9') {
+                if (!integer(bounds[parts])) return false;
+            } else if (parts == 0 && peek() != ':') {
+                return fail("expected an index, slice, '*', '?' or quoted key");
+            }
+            parts++;
+            skipSpace();
+            if (peek() != ':' || parts == 3) break;
+            position++;
+        }
+        if (parts == 1) {
+            step.kind = JsonPath::StepKind::Index;
+            step.start = bounds[0];
+            return true;
+        }
+        if (relative) return fail("filter paths only take keys and indices");
+        if (bounds[2] <= 0) return fail("slice step must be positive");
+        step.kind = JsonPath::StepKind::Slice;
+        step.start = bounds[0];
+        step.end = bounds[1];
+        step.step = bounds[2];
+        return true;
+    }
+
+    bool integer(long& value) {
+        const char* begin = text.data() + position;
+        auto result = std::from_chars(begin, text.data() + text.size(), value);
+        if (result.ec != std::errc()) return fail("index out of range");
+        position += result.ptr - begin;
+        return true;
+    }
+
+    bool quoted(std::string& value) {
+        char quote = text[position++];
+        value.clear();
+        while (position < text.size() && text[position] != quote) {
+            if (text[position] == '\\' && position + 1 < text.size()) position++;
+            value += text[position++];
+        }
+        if (position >= text.size()) return fail("unterminated string");
+        position++;
+        return true;
+    }
+
+    // ---- Filters ----
+
+    bool filter(JsonPath::Step& step) {
+        step.filter = int(path.filter_code.size());
+        path.filter_code.emplace_back();
+        depth = 0;
+        max_depth = 0;
+
+        skipSpace();
+        bool parenthesized = peek() == '(';
+        if (parenthesized) position++;
+        if (!orExpression(step.filter)) return false;
+        if (parenthesized && !expect(')')) return false;
+        if (max_depth > JsonPath::MAX_FILTER_DEPTH) return fail("filter is nested too deeply");
+        return true;
+    }
+
+    void emit(int filter, JsonPath::Op op, int path_index = -1, int literal = -1) {
+        path.filter_code[filter].push_back({op, path_index, literal});
+        if (op == JsonPath::Op::And || op == JsonPath::Op::Or) {
+            depth--;
+        } else if (op != JsonPath::Op::Not) {
+            depth++;
+            if (depth > max_depth) max_depth = depth;
+        }
+    }
+
+    bool orExpression(int filter) {
+        if (!andExpression(filter)) return false;
+        while (skipSpace(), peek() == '|' && peek(1) == '|') {
+            position += 2;
+            if (!andExpression(filter)) return false;
+            emit(filter, JsonPath::Op::Or);
+        }
+        return true;
+    }
+
+    bool andExpression(int filter) {
+        if (!unary(filter)) return false;
+        while (skipSpace(), peek() == '&' && peek(1) == '&') {
+            position += 2;
+            if (!unary(filter)) return false;
+            emit(filter, JsonPath::Op::And);
+        }
+        return true;
+    }
+
+    bool unary(int filter) {
+        skipSpace();
+        if (peek() == '!') {
+            position++;
+            if (!unary(filter)) return false;
+            emit(filter, JsonPath::Op::Not);
+            return true;
+        }
+        if (peek() == '(') {
+            position++;
+            return orExpression(filter) && expect(')');
+        }
+        return comparison(filter);
+    }
+
+    bool comparison(int filter) {
+        int left_path = -1, left_literal = -1;
+        if (!operand(left_path, left_literal)) return false;
+
+        skipSpace();
+        JsonPath::Op op;
+        if (!comparisonOperator(op)) {
+            if (left_path < 0) return fail("a literal alone is not a condition");
+            emit(filter, JsonPath::Op::Exists, left_path);
+            return true;
+        }
+
+        int right_path = -1, right_literal = -1;
+        if (!operand(right_path, right_literal)) return false;
+        if ((left_path < 0) == (right_path < 0)) {
+            return fail("comparisons need one @ path and one literal");
+        }
+        if (left_path < 0) {
+            // 3 < @.x is @.x > 3
+            switch (op) {
+                case JsonPath::Op::Less: op = JsonPath::Op::Greater; break;
+                case JsonPath::Op::LessEqual: op = JsonPath::Op::GreaterEqual; break;
+                case JsonPath::Op::Greater: op = JsonPath::Op::Less; break;
+                case JsonPath::Op::GreaterEqual: op = JsonPath::Op::LessEqual; break;
+                default: break;
+            }
+            emit(filter, op, right_path, left_literal);
+        } else {
+            emit(filter, op, left_path, right_literal);
+        }
+        return true;
+    }
+
+    bool comparisonOperator(JsonPath::Op& op) {
+        char c = peek(), next = peek(1);
+        if (c == '=' && next == '=') op = JsonPath::Op::Equal;
+        else if (c == '!' && next == '=') op = JsonPath::Op::NotEqual;
+        else if (c == '<' && next == '=') op = JsonPath::Op::LessEqual;
+        else if (c == '>' && next == '=') op = JsonPath::Op::GreaterEqual;
+        else if (c == '<') op = JsonPath::Op::Less;
+        else if (c == '>') op = JsonPath::Op::Greater;
+        else return false;
+        position += (next == '=') ? 2 : 1;
+        return true;
+    }
+
+    // @-relative path or literal
+    bool operand(int& path_index, int& literal) {
+        skipSpace();
+        char c = peek();
+        if (c == '@') {
+            position++;
+            std::vector<JsonPath::Step> steps;
+            while (peek() == '.' || peek() == '[') {
+                if (!segment(steps, false, true)) return false;
+            }
+            path_index = int(path.relative_paths.size());
+            path.relative_paths.push_back(std::move(steps));
+            return true;
+        }
+
+        JsonPath::Literal value;
+        if (c == '\'' || c == '"') {
+            value.type = JsonType::String;
+            if (!quoted(value.text)) return false;
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            const char* begin = text.data() + position;
+            auto result = std::from_chars(begin, text.data() + text.size(), value.number);
+            if (result.ec != std::errc()) return fail("invalid number");
+            value.type = JsonType::Number;
+            value.text.assign(begin, result.ptr);
+            position += result.ptr - begin;
+        } else if (text.compare(position, 4, "true") == 0 || text.compare(position, 5, "false") == 0) {
+            value.type = JsonType::Bool;
+            value.text = c == 't' ? "true" : "false";
+            position += value.text.size();
+        } else if (text.compare(position, 4, "null") == 0) {
+            value.type = JsonType::Null;
+            value.text = "null";
+            position += 4;
+        } else {
+            return fail("expected @, a number, a string, true, false or null");
+        }
+        literal = int(path.literal_values.size());
+        path.literal_values.push_back(std::move(value));
+        return true;
+    }
+};
+
+bool JsonPath::compile(const std::string& path_text, std::string& error) {
+    *this = JsonPath();
+    text = path_text;
+    JsonPathParser parser(path_text, *this, error);
+    if (!parser.parse()) {
+        std::string source = std::move(text);
+        *this = JsonPath();
+        text = std::move(source);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,1265 @@
+#include "json_scanner.h"
+#include "json_path.h"
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define UNTANGLE_JSON_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Bit i of each mask describes byte i of a 64-byte block
+struct BlockMasks {
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    // { and [
+    uint64_t open = 0;
+    // } and ]
+    uint64_t close = 0;
+    // : and ,
+    uint64_t separator = 0;
+};
+
+using ClassifyFn = void (*)(const char* block, BlockMasks& masks);
+
+// '[' and '{' (and ']' and '}') differ only in bit 5, so or-ing 0x20 folds
+// the four brackets onto two compares. Picked where there is no SIMD
+// kernel, or when forced by setJsonScannerKernel().
+void classifyScalar(const char* block, BlockMasks& masks) {
+    masks = BlockMasks();
+    for (int i = 0; i < 64; i++) {
+        unsigned char c = static_cast<unsigned char>(block[i]);
+        uint64_t bit = 1ULL << i;
+        unsigned char folded = c | 0x20;
+        if (c == '"') masks.quote |= bit;
+        else if (c == '\\') masks.backslash |= bit;
+        else if (folded == '{') masks.open |= bit;
+        else if (folded == '}') masks.close |= bit;
+        else if (c == ':' || c == ',') masks.separator |= bit;
+    }
+}
+
+#ifdef UNTANGLE_JSON_X86
+// SSE2 is part of x86-64, so this one needs no CPU check
+void classifySse2(const char* block, BlockMasks& masks) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i fold = _mm_set1_epi8(0x20);
+
+    masks = BlockMasks();
+    for (int i = 0; i < 4; i++) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+        __m128i folded = _mm_or_si128(v, fold);
+        __m128i separator = _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma));
+        int shift = 16 * i;
+        masks.quote |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << shift;
+        masks.backslash |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)))) << shift;
+        masks.open |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(folded, open)))) << shift;
+        masks.close |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(folded, close)))) << shift;
+        masks.separator |= uint64_t(uint32_t(_mm_movemask_epi8(separator))) << shift;
+    }
+}
+
+__attribute__((target("avx2")))
+void classifyAvx2(const char* block, BlockMasks& masks) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i open = _mm256_set1_epi8('{');
+    const __m256i close = _mm256_set1_epi8('}');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i fold = _mm256_set1_epi8(0x20);
+
+    masks = BlockMasks();
+    for (int i = 0; i < 2; i++) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * i));
+        __m256i folded = _mm256_or_si256(v, fold);
+        __m256i separator = _mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma));
+        int shift = 32 * i;
+        masks.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)))) << shift;
+        masks.backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)))) << shift;
+        masks.open |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(folded, open)))) << shift;
+        masks.close |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(folded, close)))) << shift;
+        masks.separator |= uint64_t(uint32_t(_mm256_movemask_epi8(separator))) << shift;
+    }
+}
+#endif
+
+struct Kernel {
+    ClassifyFn classify;
+    const char* name;
+};
+
+Kernel& kernel() {
+    static Kernel selected = []() -> Kernel {
+#ifdef UNTANGLE_JSON_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return {classifyAvx2, "avx2"};
+        return {classifySse2, "sse2"};
+#else
+        return {classifyScalar, "scalar"};
+#endif
+    }();
+    return selected;
+}
+
+// Bit i set when any odd number of quotes precede or sit at byte i, i.e.
+// from an opening quote up to (not including) its closing quote
+uint64_t prefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// Bytes preceded by an escaping backslash, for a block whose last byte is
+// at last. A backslash there escapes the first byte of the next block,
+// which carry records. Backslashes are rare outside of a few string values,
+// so walking them one by one is cheap.
+uint64_t escapedBytes(uint64_t backslashes, uint64_t& carry, int last = 63) {
+    uint64_t result = carry;
+    uint64_t pending = backslashes & ~carry;
+    carry = 0;
+    while (pending) {
+        int i = __builtin_ctzll(pending);
+        if (i == last) {
+            carry = 1;
+            break;
+        }
+        result |= 2ULL << i;
+        pending &= ~(3ULL << i);
+    }
+    return result;
+}
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Yields the positions of a document's structural characters in order:
+// { } [ ] : , outside strings, and every unescaped quote. Blocks are
+// classified only when the caller asks for more, so a lookup that ends
+// early never touches the rest of the document.
+class StructuralScanner {
+public:
+    static constexpr size_t END = std::string::npos;
+
+    explicit StructuralScanner(std::string_view json) : json(json), classify(kernel().classify) {}
+
+    size_t next() {
+        while (bits == 0) {
+            if (next_block >= json.size()) return END;
+            loadBlock();
+        }
+        size_t position = block_start + __builtin_ctzll(bits);
+        bits &= bits - 1;
+        return position;
+    }
+
+    // Like next(), without consuming the character
+    size_t peek() {
+        while (bits == 0) {
+            if (next_block >= json.size()) return END;
+            loadBlock();
+        }
+        return block_start + __builtin_ctzll(bits);
+    }
+
+    // Hands out everything left of the current block (or the next one) at
+    // once: bit i of structurals stands for position base + i. False at the
+    // end of the document.
+    bool takeBlock(size_t& base, uint64_t& structurals, uint64_t& opening, uint64_t& closing) {
+        while (bits == 0) {
+            if (next_block >= json.size()) return false;
+            loadBlock();
+        }
+        base = block_start;
+        structurals = bits;
+        opening = opens;
+        closing = closes;
+        bits = 0;
+        return true;
+    }
+
+    // closeContainer() right after the opening bracket was handed out
+    size_t skipContainer() { return closeContainer(); }
+
+    // Consumes a container whose opening bracket was already handed out and
+    // returns the position of its closing bracket. Blocks that cannot hold
+    // it are settled with two popcounts instead of a walk over their bits.
+    size_t closeContainer() {
+        long depth = 1;
+        for (;;) {
+            while (bits == 0) {
+                if (next_block >= json.size()) return END;
+                loadBlock();
+            }
+            uint64_t opening = bits & opens;
+            uint64_t closing = bits & closes;
+            if (__builtin_popcountll(closing) < depth) {
+                depth += __builtin_popcountll(opening) - __builtin_popcountll(closing);
+                bits = 0;
+                continue;
+            }
+            while (bits) {
+                uint64_t bit = bits & -bits;
+                bits ^= bit;
+                if (bit & opens) {
+                    depth++;
+                } else if ((bit & closes) && --depth == 0) {
+                    return block_start + __builtin_ctzll(bit);
+                }
+            }
+        }
+    }
+
+private:
+    std::string_view json;
+    ClassifyFn classify;
+    size_t block_start = 0;
+    size_t next_block = 0;
+    // Structural characters of the current block not handed out yet
+    uint64_t bits = 0;
+    // Brackets of the current block, outside strings
+    uint64_t opens = 0;
+    uint64_t closes = 0;
+    // All ones when the previous block ended inside a string
+    uint64_t in_string = 0;
+    // The previous block ended in a backslash that escapes our first byte
+    uint64_t escape_carry = 0;
+
+    void loadBlock() {
+        const char* block = json.data() + next_block;
+        char tail[64];
+        size_t remaining = json.size() - next_block;
+        if (remaining < 64) {
+            // Spaces are never structural, so padding cannot add anything
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, block, remaining);
+            block = tail;
+        }
+
+        BlockMasks masks;
+        classify(block, masks);
+
+        uint64_t quotes = masks.quote & ~escapedBytes(masks.backslash, escape_carry);
+        uint64_t strings = prefixXor(quotes) ^ in_string;
+        in_string = uint64_t(int64_t(strings) >> 63);
+
+        opens = masks.open & ~strings;
+        closes = masks.close & ~strings;
+        bits = opens | closes | (masks.separator & ~strings) | quotes;
+        block_start = next_block;
+        next_block += 64;
+    }
+};
+
+} // namespace
+
+struct JsonIndex::State {
+    // Bracket entries learn the index of their partner once it is scanned
+    struct Entry {
+        uint32_t position = 0;
+        std::atomic<uint32_t> partner{0};
+    };
+
+    // Entries live in fixed chunks that never move, so readers can use
+    // published ones without holding the lock while others are appended
+    static constexpr size_t CHUNK = 1024;
+    // Positions scanned per extension beyond the one asked for, so a walk
+    // takes the lock about once per kilobyte rather than per structural
+    static constexpr size_t BATCH = 256;
+
+    std::string_view json;
+    std::unique_ptr<std::unique_ptr<Entry[]>[]> chunks;
+    std::atomic<size_t> count{0};
+
+    std::mutex mutex;
+    StructuralScanner scanner;
+    // Indices of brackets still waiting for their partner
+    std::vector<uint32_t> open_brackets;
+    bool complete = false;
+
+    explicit State(std::string_view json)
+        : json(json), chunks(new std::unique_ptr<Entry[]>[json.size() / CHUNK + 1]), scanner(json) {}
+
+    Entry& at(size_t i) const { return chunks[i / CHUNK][i % CHUNK]; }
+
+    // Scans until entry i exists; false when the document ends first
+    bool extend(size_t i) {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t n = count.load(std::memory_order_relaxed);
+        while (!complete && n < i + BATCH) n = scanBlock(n);
+        count.store(n, std::memory_order_release);
+        return i < n;
+    }
+
+    // Scans until the bracket at entry i knows its partner; false when the
+    // document ends first
+    bool extendToPartner(size_t i) {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t n = count.load(std::memory_order_relaxed);
+        while (!complete && !at(i).partner.load(std::memory_order_relaxed)) n = scanBlock(n);
+        count.store(n, std::memory_order_release);
+        return at(i).partner.load(std::memory_order_relaxed) != 0;
+    }
+
+private:
+    // Appends the next block's structurals after entry n; returns the count
+    size_t scanBlock(size_t n) {
+        size_t base;
+        uint64_t structurals, opening, closing;
+        if (!scanner.takeBlock(base, structurals, opening, closing)) {
+            complete = true;
+            return n;
+        }
+        while (structurals) {
+            uint64_t bit = structurals & -structurals;
+            structurals ^= bit;
+            if (!chunks[n / CHUNK]) chunks[n / CHUNK].reset(new Entry[CHUNK]);
+            at(n).position = uint32_t(base + __builtin_ctzll(bit));
+            if (bit & opening) {
+                open_brackets.push_back(uint32_t(n));
+            } else if ((bit & closing) && !open_brackets.empty()) {
+                at(open_brackets.back()).partner.store(uint32_t(n), std::memory_order_release);
+                open_brackets.pop_back();
+            }
+            n++;
+        }
+        return n;
+    }
+};
+
+namespace {
+
+// Replays the structural positions of a JsonIndex, extending it when the
+// walk gets past what earlier lookups scanned. Same interface as
+// StructuralScanner, so the matcher runs on either.
+class IndexCursor {
+public:
+    static constexpr size_t END = StructuralScanner::END;
+
+    explicit IndexCursor(JsonIndex::State& index) : index(&index) {}
+
+    size_t next() {
+        size_t position = peek();
+        if (position != END) i++;
+        return position;
+    }
+
+    size_t peek() {
+        if (i >= available) {
+            available = index->count.load(std::memory_order_acquire);
+            if (i >= available) {
+                if (!index->extend(i)) return END;
+                available = index->count.load(std::memory_order_acquire);
+            }
+        }
+        return index->at(i).position;
+    }
+
+    // Right after the opening bracket was handed out: jumps to its partner
+    size_t skipContainer() {
+        return jumpToPartner(i - 1);
+    }
+
+    // Nested containers are jumped over, so only the siblings at this level
+    // are visited
+    size_t closeContainer() {
+        for (;;) {
+            size_t position = peek();
+            if (position == END) return END;
+            char c = index->json[position] | 0x20;
+            if (c == '{') {
+                if (jumpToPartner(i) == END) return END;
+            } else {
+                i++;
+                if (c == '}') return position;
+            }
+        }
+    }
+
+private:
+    JsonIndex::State* index;
+    size_t i = 0;
+    // Entries known to be published
+    size_t available = 0;
+
+    // Moves behind the partner of the bracket at entry open, scanning
+    // ahead if no lookup got that far yet; returns the partner's position
+    size_t jumpToPartner(size_t open) {
+        uint32_t partner = index->at(open).partner.load(std::memory_order_acquire);
+        if (!partner) {
+            if (!index->extendToPartner(open)) return END;
+            partner = index->at(open).partner.load(std::memory_order_acquire);
+        }
+        i = size_t(partner) + 1;
+        return index->at(partner).position;
+    }
+};
+
+// Order of a number or string against a filter literal
+int compareOrder(const JsonValue& value, const JsonPath::Literal& literal) {
+    if (value.type == JsonType::Number) {
+        double number = 0;
+        std::from_chars(value.raw.data(), value.raw.data() + value.raw.size(), number);
+        return number < literal.number ? -1 : number > literal.number ? 1 : 0;
+    }
+    int order = value.hasEscapes() ? value.text().compare(literal.text) : value.unquoted().compare(literal.text);
+    return order < 0 ? -1 : order > 0 ? 1 : 0;
+}
+
+bool compareValue(bool exists, const JsonValue& value, JsonPath::Op op, const JsonPath::Literal& literal) {
+    // Missing values and values of another type only ever differ
+    if (!exists || value.type != literal.type) return op == JsonPath::Op::NotEqual;
+
+    if (value.type != JsonType::Number && value.type != JsonType::String) {
+        // true, false and null are equal or unordered
+        bool same = value.raw == literal.text;
+        switch (op) {
+            case JsonPath::Op::Equal:
+            case JsonPath::Op::LessEqual:
+            case JsonPath::Op::GreaterEqual: return same;
+            case JsonPath::Op::NotEqual: return !same;
+            default: return false;
+        }
+    }
+
+    int order = compareOrder(value, literal);
+    switch (op) {
+        case JsonPath::Op::Equal: return order == 0;
+        case JsonPath::Op::NotEqual: return order != 0;
+        case JsonPath::Op::Less: return order < 0;
+        case JsonPath::Op::LessEqual: return order <= 0;
+        case JsonPath::Op::Greater: return order > 0;
+        case JsonPath::Op::GreaterEqual: return order >= 0;
+        default: return false;
+    }
+}
+
+// Runs a compiled path over a document in one forward pass. Every value is
+// consumed exactly once: descended into when a step selects it, skipped by
+// bracket depth otherwise. Elements a filter tests are walked again by
+// matchers of their own, starting from a copy of the source.
+template <typename Source>
+class Matcher {
+public:
+    // Stops at the first match when first is set, else collects into all
+    Matcher(std::string_view json, const JsonPath& path, const std::vector<JsonPath::Step>& steps,
+            JsonValue* first, std::vector<JsonValue>* all, const Source& source)
+        : json(json), path(path), steps(steps), first(first), all(all), scanner(source) {}
+
+    // Matches steps from step_index on against the whole document; false
+    // when it turned out malformed
+    bool run(size_t step_index) {
+        size_t start = enterValue(0);
+        if (start == END) return false;
+        return runEntered(start, step_index);
+    }
+
+    // Same for the value at start, whose first byte the source already
+    // handed out
+    bool runEntered(size_t start, size_t step_index) {
+        singular_until = step_index;
+        while (singular_until < steps.size() && (steps[singular_until].kind == JsonPath::StepKind::Key ||
+                                                 steps[singular_until].kind == JsonPath::StepKind::Index)) {
+            singular_until++;
+        }
+        return walk(start, step_index);
+    }
+
+    // A first-match run found its value
+    bool finished() const { return found; }
+
+private:
+    static constexpr size_t END = Source::END;
+
+    std::string_view json;
+    const JsonPath& path;
+    const std::vector<JsonPath::Step>& steps;
+    JsonValue* first;
+    std::vector<JsonValue>* all;
+    Source scanner;
+    // Steps before this one select a single value each
+    size_t singular_until = 0;
+    // Nothing further can match: the first match was found, or every step
+    // that could still select something is behind us
+    bool done = false;
+    bool found = false;
+
+    size_t skipSpace(size_t position) const {
+        while (position < json.size() && isSpace(json[position])) position++;
+        return position;
+    }
+
+    // Start of the value at or after position. Strings and containers open
+    // with a structural character, which is consumed here so that the
+    // scanner always stands right behind the value's first byte.
+    size_t enterValue(size_t position) {
+        size_t start = skipSpace(position);
+        if (start >= json.size()) return END;
+        char c = json[start];
+        if (c == '{' || c == '[' || c == '"') {
+            if (scanner.next() != start) return END;
+        }
+        return start;
+    }
+
+    // Consumes the rest of an entered value and returns its last byte.
+    // Scalars end before the next structural character, which stays put.
+    size_t valueEnd(size_t start) {
+        char c = json[start];
+        if (c == '{' || c == '[') return scanner.skipContainer();
+        if (c == '"') return scanner.next();
+
+        size_t end = scanner.peek();
+        if (end == END) end = json.size();
+        while (end > start && isSpace(json[end - 1])) end--;
+        return end == start ? END : end - 1;
+    }
+
+    bool emit(size_t start) {
+        size_t end = valueEnd(start);
+        if (end == END) return false;
+
+        JsonValue value;
+        char c = json[start];
+        if (c == '{') value.type = JsonType::Object;
+        else if (c == '[') value.type = JsonType::Array;
+        else if (c == '"') value.type = JsonType::String;
+        else if (c == 't' || c == 'f') value.type = JsonType::Bool;
+        else if (c == 'n') value.type = JsonType::Null;
+        else if (c == '-' || (c >= '0' && c <= '9')) value.type = JsonType::Number;
+        else return false;
+        value.raw = json.substr(start, end + 1 - start);
+
+        if (first) {
+            *first = value;
+            found = done = true;
+        } else {
+            all->push_back(value);
+        }
+        return true;
+    }
+
+    // Matches steps[index..] inside the entered value at start, consuming
+    // all of it unless the run is done
+    bool walk(size_t start, size_t index) {
+        if (index == steps.size()) return emit(start);
+
+        char c = json[start];
+        if (c == '{') return walkObject(index);
+        if (c == '[') return walkArray(start, index);
+        // Scalars have nothing to descend into
+        return valueEnd(start) != END;
+    }
+
+    // Element or member value at start is selected by a filter step
+    bool walkFiltered(size_t start, size_t index) {
+        Source element = scanner;
+        if (valueEnd(start) == END) return false;
+        if (!filterMatches(start, element, steps[index].filter)) return true;
+
+        Matcher rest(json, path, steps, first, all, element);
+        bool ok = rest.runEntered(start, index + 1);
+        found = done = rest.found;
+        return ok;
+    }
+
+    bool walkChild(size_t start, size_t index, bool selected) {
+        if (steps[index].kind == JsonPath::StepKind::Filter) return walkFiltered(start, index);
+        if (selected) return walk(start, index + 1);
+        return valueEnd(start) != END;
+    }
+
+    // The step at index cannot select anything more in this container. When
+    // no earlier step can either, the run is over; otherwise the rest of the
+    // container is skipped to get back to the parent.
+    bool finishContainer(size_t index) {
+        if (index <= singular_until) {
+            done = true;
+            return true;
+        }
+        return scanner.closeContainer() != END;
+    }
+
+    bool walkObject(size_t index) {
+        const JsonPath::Step& step = steps[index];
+        if (step.kind == JsonPath::StepKind::Index || step.kind == JsonPath::StepKind::Slice) {
+            return scanner.closeContainer() != END;
+        }
+
+        size_t position = scanner.next();
+        while (position != END && json[position] == '"') {
+            size_t key_end = scanner.next();
+            if (key_end == END) return false;
+            size_t colon = scanner.next();
+            if (colon == END || json[colon] != ':') return false;
+            size_t value = enterValue(colon + 1);
+            if (value == END) return false;
+
+            bool selected = step.kind == JsonPath::StepKind::Wildcard;
+            if (step.kind == JsonPath::StepKind::Key) {
+                JsonValue name{JsonType::String, json.substr(position, key_end + 1 - position)};
+                selected = name.hasEscapes() ? name.text() == step.key : name.unquoted() == step.key;
+            }
+            if (!walkChild(value, index, selected)) return false;
+            if (done) return true;
+            // A key names one member; the rest of the object only needs skipping
+            if (selected && step.kind == JsonPath::StepKind::Key) return finishContainer(index);
+
+            size_t delimiter = scanner.next();
+            if (delimiter == END) return false;
+            if (json[delimiter] == '}') return true;
+            if (json[delimiter] != ',') return false;
+            position = scanner.next();
+        }
+        return position != END && json[position] == '}';
+    }
+
+    bool walkArray(size_t start, size_t index) {
+        const JsonPath::Step& step = steps[index];
+        if (step.kind == JsonPath::StepKind::Key) return scanner.closeContainer() != END;
+
+        size_t element = enterValue(start + 1);
+        for (long i = 0; element != END && json[element] != ']'; i++) {
+            bool selected;
+            switch (step.kind) {
+                case JsonPath::StepKind::Index: selected = i == step.start; break;
+                case JsonPath::StepKind::Slice:
+                    selected = i >= step.start && (step.end < 0 || i < step.end) && (i - step.start) % step.step == 0;
+                    break;
+                default: selected = true; break;
+            }
+            if (!walkChild(element, index, selected)) return false;
+            if (done) return true;
+            // Past the last element the step can select, only skipping is left
+            if ((step.kind == JsonPath::StepKind::Index && i >= step.start) ||
+                (step.kind == JsonPath::StepKind::Slice && step.end >= 0 && i + 1 >= step.end)) {
+                return finishContainer(index);
+            }
+
+            size_t delimiter = scanner.next();
+            if (delimiter == END) return false;
+            if (json[delimiter] == ']') return true;
+            if (json[delimiter] != ',') return false;
+            element = enterValue(delimiter + 1);
+        }
+        // Empty array (or a trailing comma): the ']' is still unconsumed
+        return element != END && scanner.next() == element;
+    }
+
+    bool filterMatches(size_t start, const Source& element, int filter) const {
+        bool stack[JsonPath::MAX_FILTER_DEPTH];
+        int top = 0;
+        for (const JsonPath::Instruction& instruction : path.filters()[filter]) {
+            switch (instruction.op) {
+                case JsonPath::Op::And:
+                    top--;
+                    stack[top - 1] = stack[top - 1] && stack[top];
+                    break;
+                case JsonPath::Op::Or:
+                    top--;
+                    stack[top - 1] = stack[top - 1] || stack[top];
+                    break;
+                case JsonPath::Op::Not:
+                    stack[top - 1] = !stack[top - 1];
+                    break;
+                default: {
+                    JsonValue value;
+                    Matcher lookup(json, path, path.relativePaths()[instruction.path], &value, nullptr, element);
+                    lookup.runEntered(start, 0);
+                    bool exists = lookup.finished();
+                    stack[top++] = instruction.op == JsonPath::Op::Exists
+                        ? exists
+                        : compareValue(exists, value, instruction.op, path.literals()[instruction.literal]);
+                    break;
+                }
+            }
+        }
+        return top == 1 && stack[0];
+    }
+};
+
+void appendUtf8(std::string& out, uint32_t code_point) {
+    if (code_point < 0x80) {
+        out += char(code_point);
+    } else if (code_point < 0x800) {
+        out += char(0xC0 | (code_point >> 6));
+        out += char(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        out += char(0xE0 | (code_point >> 12));
+        out += char(0x80 | ((code_point >> 6) & 0x3F));
+        out += char(0x80 | (code_point & 0x3F));
+    } else {
+        out += char(0xF0 | (code_point >> 18));
+        out += char(0x80 | ((code_point >> 12) & 0x3F));
+        out += char(0x80 | ((code_point >> 6) & 0x3F));
+        out += char(0x80 | (code_point & 0x3F));
+    }
+}
+
+bool parseHex4(std::string_view text, size_t position, uint32_t& value) {
+    if (position + 4 > text.size()) return false;
+    value = 0;
+    for (size_t i = position; i < position + 4; i++) {
+        char c = text[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+        else return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool JsonValue::hasEscapes() const {
+    return type == JsonType::String && unquoted().find('\\') != std::string_view::npos;
+}
+
+std::string_view JsonValue::unquoted() const {
+    if (type != JsonType::String || raw.size() < 2) return raw;
+    return raw.substr(1, raw.size() - 2);
+}
+
+std::string JsonValue::text() const {
+    std::string_view contents = unquoted();
+    if (type != JsonType::String || contents.find('\\') == std::string_view::npos) {
+        return std::string(contents);
+    }
+
+    std::string out;
+    out.reserve(contents.size());
+    for (size_t i = 0; i < contents.size(); i++) {
+        char c = contents[i];
+        if (c != '\\' || i + 1 == contents.size()) {
+            out += c;
+            continue;
+        }
+        char escape = contents[++i];
+        switch (escape) {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                uint32_t code_point;
+                if (!parseHex4(contents, i + 1, code_point)) {
+                    out += "\\u";
+                    break;
+                }
+                i += 4;
+                // Characters outside the BMP come as a surrogate pair
+                uint32_t low;
+                if (code_point >= 0xD800 && code_point < 0xDC00 && i + 2 < contents.size() &&
+                    contents[i + 1] == '\\' && contents[i + 2] == 'u' && parseHex4(contents, i + 3, low) &&
+                    low >= 0xDC00 && low < 0xE000) {
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                    i += 6;
+                }
+                appendUtf8(out, code_point);
+                break;
+            }
+            default: out += escape; break;
+        }
+    }
+    return out;
+}
+
+JsonIndex::JsonIndex(std::string_view json) : state(new State(json)) {}
+
+JsonIndex::~JsonIndex() = default;
+
+std::string_view JsonIndex::document() const {
+    return state->json;
+}
+
+size_t JsonIndex::size() const {
+    return state->count.load(std::memory_order_acquire);
+}
+
+bool extractJson(std::string_view json, const JsonPath& path, JsonValue& value) {
+    Matcher<StructuralScanner> matcher(json, path, path.getSteps(), &value, nullptr, StructuralScanner(json));
+    matcher.run(0);
+    return matcher.finished();
+}
+
+bool extractJson(const JsonIndex& index, const JsonPath& path, JsonValue& value) {
+    Matcher<IndexCursor> matcher(index.state->json, path, path.getSteps(), &value, nullptr, IndexCursor(*index.state));
+    matcher.run(0);
+    return matcher.finished();
+}
+
+bool extractJsonAll(std::string_view json, const JsonPath& path, std::vector<JsonValue>& values) {
+    Matcher<StructuralScanner> matcher(json, path, path.getSteps(), nullptr, &values, StructuralScanner(json));
+    return matcher.run(0);
+}
+
+bool extractJsonAll(const JsonIndex& index, const JsonPath& path, std::vector<JsonValue>& values) {
+    Matcher<IndexCursor> matcher(index.state->json, path, path.getSteps(), nullptr, &values, IndexCursor(*index.state));
+    return matcher.run(0);
+}
+
+struct JsonStreamExtractor::State {
+    // What the byte at hand may be
+    enum class Mode { Value, FirstElement, FirstMember, Member, Key, Colon, String, Scalar, AfterValue, Skip, Trailing, Failed };
+
+    // Open container; depth i selects its children with step i
+    struct Frame {
+        bool object;
+        // Elements started so far, for arrays
+        long count = 0;
+        // Paths whose steps so far selected this container and that may
+        // still select one of the children to come
+        uint64_t live = 0;
+        // Paths that can select nothing more once it is closed
+        uint64_t finishes = 0;
+        // Some live path needs the member names
+        bool keys = false;
+    };
+
+    // Value being copied out for the paths that selected it
+    struct Capture {
+        uint64_t paths;
+        size_t start;
+        size_t depth;
+    };
+
+    struct Span {
+        size_t start;
+        size_t length;
+    };
+
+    std::shared_ptr<const JsonPathSet> paths;
+    // Per path: first step that can select several values (steps.size()
+    // for singular paths); containers above it are unique
+    std::vector<size_t> anchors;
+    uint64_t all = 0;
+    uint64_t done = 0;
+    // Paths without steps select the whole document
+    uint64_t root_targets = 0;
+
+    Mode mode = Mode::Value;
+    std::vector<Frame> stack;
+    std::vector<Capture> captures;
+    std::vector<std::vector<Span>> spans;
+    // Bytes of every captured value, back to back
+    std::string buffer;
+
+    // Current member name, kept only when some path needs it
+    std::string key;
+    bool key_escaped = false;
+    // A string's backslash was the last byte of the previous piece
+    bool escape_pending = false;
+    // Paths done once the scalar or string being read ends
+    uint64_t value_finishes = 0;
+
+    // Skip mode: depth inside a container no path selected, and the string
+    // state carried from one block to the next
+    long skip_depth = 0;
+    uint64_t in_string = 0;
+    uint64_t escape_carry = 0;
+
+    // Where the current piece still has to be copied from into buffer (or
+    // key) when the piece ends
+    const char* data = nullptr;
+    size_t span_start = 0;
+    size_t key_start = 0;
+
+    explicit State(std::shared_ptr<const JsonPathSet> path_set) : paths(std::move(path_set)) {
+        spans.resize(paths->size());
+        for (size_t p = 0; p < paths->size(); p++) {
+            const std::vector<JsonPath::Step>& steps = (*paths)[p]->getSteps();
+            size_t anchor = 0;
+            while (anchor < steps.size() && (steps[anchor].kind == JsonPath::StepKind::Key ||
+                                             steps[anchor].kind == JsonPath::StepKind::Index)) {
+                anchor++;
+            }
+            anchors.push_back(anchor);
+            all |= 1ULL << p;
+            if (steps.empty()) root_targets |= 1ULL << p;
+        }
+    }
+
+    bool feed(const char* bytes, size_t length) {
+        data = bytes;
+        span_start = 0;
+        key_start = 0;
+        size_t i = 0;
+        while (i < length && done != all) {
+            char c = data[i];
+            switch (mode) {
+                case Mode::Value:
+                    if (isSpace(c)) break;
+                    if (!beginValue(i)) return fail();
+                    if ((c == '{' || c == '[') && exhausted()) skip();
+                    else if (c == '{') mode = Mode::FirstMember;
+                    else if (c == '[') mode = Mode::FirstElement;
+                    else if (c == '"') mode = Mode::String;
+                    else mode = Mode::Scalar;
+                    break;
+                case Mode::FirstElement:
+                    if (isSpace(c)) break;
+                    if (c == ']') {
+                        closeContainer(i);
+                        break;
+                    }
+                    // Anything else starts the first element
+                    mode = Mode::Value;
+                    continue;
+                case Mode::FirstMember:
+                case Mode::Member:
+                    if (isSpace(c)) break;
+                    if (c == '}' && mode == Mode::FirstMember) {
+                        closeContainer(i);
+                        break;
+                    }
+                    if (c != '"') return fail();
+                    mode = Mode::Key;
+                    key.clear();
+                    key_escaped = false;
+                    key_start = i + 1;
+                    break;
+                case Mode::Key:
+                    i = skipString(i, length);
+                    if (i == length) continue;
+                    if (stack.back().keys) key.append(data + key_start, i - key_start);
+                    mode = Mode::Colon;
+                    break;
+                case Mode::Colon:
+                    if (isSpace(c)) break;
+                    if (c != ':') return fail();
+                    mode = Mode::Value;
+                    break;
+                case Mode::String:
+                    i = skipString(i, length);
+                    if (i == length) continue;
+                    endValue(i + 1);
+                    break;
+                case Mode::Scalar:
+                    if (!isSpace(c) && !strchr(",:[]{}\"", c)) break;
+                    // The delimiter is looked at again after the value
+                    endValue(i);
+                    continue;
+                case Mode::AfterValue:
+                    if (isSpace(c)) break;
+                    if (c == ',') {
+                        if (exhausted()) skip();
+                        else mode = stack.back().object ? Mode::Member : Mode::Value;
+                    } else if (c == (stack.back().object ? '}' : ']')) {
+                        closeContainer(i);
+                    } else {
+                        return fail();
+                    }
+                    break;
+                case Mode::Skip:
+                    i = skipContainer(i, length);
+                    if (i == length) continue;
+                    closeContainer(i);
+                    break;
+                case Mode::Trailing:
+                    if (!isSpace(c)) return fail();
+                    break;
+                case Mode::Failed:
+                    return false;
+            }
+            i++;
+        }
+
+        // Values and names still open carry on into the next piece
+        if (!captures.empty()) buffer.append(data + span_start, i - span_start);
+        if (mode == Mode::Key && stack.back().keys) key.append(data + key_start, i - key_start);
+        return true;
+    }
+
+    bool fail() {
+        mode = Mode::Failed;
+        return false;
+    }
+
+    // Nothing further in the innermost container can be selected or copied
+    bool exhausted() const {
+        return !(stack.back().live & ~done) && captures.empty();
+    }
+
+    // Only the end of the innermost container matters from here on
+    void skip() {
+        mode = Mode::Skip;
+        skip_depth = 1;
+        in_string = 0;
+        escape_carry = 0;
+    }
+
+    // Moves through the inside of a string from i; returns its closing
+    // quote, or length when the piece ends first
+    size_t skipString(size_t i, size_t length) {
+        if (escape_pending) {
+            escape_pending = false;
+            i++;
+        }
+        while (i < length) {
+            const char* quote = static_cast<const char*>(memchr(data + i, '"', length - i));
+            size_t end = quote ? quote - data : length;
+            const char* backslash = static_cast<const char*>(memchr(data + i, '\\', end - i));
+            if (!backslash) return end;
+            key_escaped = true;
+            i = backslash - data + 2;
+            if (i > length) escape_pending = true;
+        }
+        return length;
+    }
+
+    // Finds the end of the container being skipped from i on, classifying
+    // 64 bytes at a time like StructuralScanner; returns its closing
+    // bracket, or length when the piece ends first. What lies inside is not
+    // validated.
+    size_t skipContainer(size_t i, size_t length) {
+        ClassifyFn classify = kernel().classify;
+        while (i < length) {
+            const char* block = data + i;
+            char tail[64];
+            int last = 63;
+            uint64_t inside = ~0ULL;
+            if (length - i < 64) {
+                // Spaces are never structural, so padding cannot add anything
+                memset(tail, ' ', sizeof(tail));
+                memcpy(tail, block, length - i);
+                block = tail;
+                last = int(length - i) - 1;
+                inside = (2ULL << last) - 1;
+            }
+
+            BlockMasks masks;
+            classify(block, masks);
+            uint64_t quotes = masks.quote & ~escapedBytes(masks.backslash, escape_carry, last);
+            uint64_t strings = prefixXor(quotes) ^ in_string;
+            in_string = (strings >> last) & 1 ? ~0ULL : 0;
+            uint64_t opening = masks.open & ~strings & inside;
+            uint64_t closing = masks.close & ~strings & inside;
+
+            // Blocks that cannot hold the end are settled with two popcounts
+            if (__builtin_popcountll(closing) < skip_depth) {
+                skip_depth += __builtin_popcountll(opening) - __builtin_popcountll(closing);
+                i += last + 1;
+                continue;
+            }
+            for (uint64_t brackets = opening | closing; brackets; brackets &= brackets - 1) {
+                uint64_t bit = brackets & -brackets;
+                if (bit & opening) {
+                    skip_depth++;
+                } else if (--skip_depth == 0) {
+                    return i + __builtin_ctzll(bit);
+                }
+            }
+            i += last + 1;
+        }
+        return length;
+    }
+
+    // Offset in buffer that byte i of the current piece will end up at
+    size_t bufferOffset(size_t i) {
+        if (captures.empty()) {
+            span_start = i;
+            return buffer.size();
+        }
+        return buffer.size() + (i - span_start);
+    }
+
+    bool selects(const JsonPath::Step& step, const Frame& parent, long index) const {
+        switch (step.kind) {
+            case JsonPath::StepKind::Key:
+                if (!parent.object) return false;
+                return key_escaped ? JsonValue{JsonType::String, "\"" + key + "\""}.text() == step.key
+                                   : key == step.key;
+            case JsonPath::StepKind::Index: return !parent.object && index == step.start;
+            case JsonPath::StepKind::Slice:
+                return !parent.object && index >= step.start && (step.end < 0 || index < step.end) &&
+                       (index - step.start) % step.step == 0;
+            default: return true;
+        }
+    }
+
+    // Value starting at byte i: works out which paths it is selected for,
+    // starts copying it for those it completes, and opens a frame for
+    // containers. False when it cannot start a value.
+    bool beginValue(size_t i) {
+        char c = data[i];
+        if (c != '{' && c != '[' && c != '"' && c != '-' && !(c >= '0' && c <= '9') && c != 't' && c != 'f' &&
+            c != 'n') {
+            return false;
+        }
+
+        uint64_t capture = 0, descend = 0, finishes = 0;
+        if (stack.empty()) {
+            capture = root_targets & ~done;
+            descend = all & ~root_targets & ~done;
+        } else {
+            Frame& parent = stack.back();
+            size_t depth = stack.size() - 1;
+            long index = parent.object ? -1 : parent.count++;
+            for (uint64_t live = parent.live & ~done; live; live &= live - 1) {
+                size_t p = __builtin_ctzll(live);
+                const std::vector<JsonPath::Step>& steps = (*paths)[p]->getSteps();
+                const JsonPath::Step& step = steps[depth];
+                // Past the end of a slice; over a unique array that is all
+                // the path can select
+                if (step.kind == JsonPath::StepKind::Slice && step.end >= 0 && index >= step.end) {
+                    parent.live &= ~(1ULL << p);
+                    if (depth == anchors[p]) done |= 1ULL << p;
+                    continue;
+                }
+                if (!selects(step, parent, index)) continue;
+                // A key or an index names one child; later ones are not looked at
+                if (step.kind == JsonPath::StepKind::Key || step.kind == JsonPath::StepKind::Index) {
+                    parent.live &= ~(1ULL << p);
+                }
+                if (steps.size() == depth + 1) capture |= 1ULL << p;
+                else descend |= 1ULL << p;
+                if (depth < anchors[p]) finishes |= 1ULL << p;
+            }
+        }
+
+        if (capture) captures.push_back({capture, bufferOffset(i), stack.size()});
+        if (c == '{' || c == '[') {
+            Frame frame;
+            frame.object = c == '{';
+            frame.live = descend;
+            frame.finishes = finishes;
+            size_t depth = stack.size();
+            for (uint64_t live = descend; frame.object && live; live &= live - 1) {
+                const JsonPath::Step& step = (*paths)[__builtin_ctzll(live)]->getSteps()[depth];
+                if (step.kind == JsonPath::StepKind::Key) frame.keys = true;
+            }
+            stack.push_back(frame);
+        } else {
+            value_finishes = finishes;
+        }
+        return true;
+    }
+
+    // Scalar or string ending right before byte end
+    void endValue(size_t end) {
+        endCaptures(end);
+        done |= value_finishes;
+        afterValue();
+    }
+
+    // Closing bracket at byte i
+    void closeContainer(size_t i) {
+        uint64_t finishes = stack.back().finishes;
+        stack.pop_back();
+        endCaptures(i + 1);
+        done |= finishes;
+        afterValue();
+    }
+
+    void afterValue() {
+        if (stack.empty()) {
+            // The document is complete
+            done = all;
+            mode = Mode::Trailing;
+        } else {
+            mode = Mode::AfterValue;
+        }
+    }
+
+    // Copies out the values that end before byte end of the current piece
+    void endCaptures(size_t end) {
+        if (captures.empty() || captures.back().depth != stack.size()) return;
+        buffer.append(data + span_start, end - span_start);
+        span_start = end;
+        do {
+            const Capture& capture = captures.back();
+            for (uint64_t targets = capture.paths; targets; targets &= targets - 1) {
+                spans[__builtin_ctzll(targets)].push_back({capture.start, buffer.size() - capture.start});
+            }
+            captures.pop_back();
+        } while (!captures.empty() && captures.back().depth == stack.size());
+    }
+};
+
+const std::vector<JsonValue>* JsonStreamResult::find(const JsonPath* path) const {
+    if (!paths) return nullptr;
+    for (size_t p = 0; p < paths->size(); p++) {
+        if ((*paths)[p].get() == path) return &values[p];
+    }
+    return nullptr;
+}
+
+JsonStreamExtractor::JsonStreamExtractor(std::shared_ptr<const JsonPathSet> paths)
+    : state(new State(std::move(paths))) {}
+
+JsonStreamExtractor::~JsonStreamExtractor() = default;
+
+bool JsonStreamExtractor::feed(std::string_view chunk) {
+    return state->mode != State::Mode::Failed && state->feed(chunk.data(), chunk.size());
+}
+
+bool JsonStreamExtractor::done() const {
+    return state->done == state->all;
+}
+
+std::shared_ptr<const JsonStreamResult> JsonStreamExtractor::finish() {
+    // A number the document ends on is only complete once something follows
+    if (state->mode == State::Mode::Scalar) state->feed(" ", 1);
+
+    auto result = std::make_shared<JsonStreamResult>();
+    result->paths = state->paths;
+    result->valid = state->mode != State::Mode::Failed && done();
+    result->bytes = BodyBuffer(std::move(state->buffer));
+    std::string_view bytes = result->bytes.view();
+    result->values.resize(state->spans.size());
+    for (size_t p = 0; p < state->spans.size(); p++) {
+        for (const State::Span& span : state->spans[p]) {
+            JsonValue value;
+            value.raw = bytes.substr(span.start, span.length);
+            char c = value.raw[0];
+            if (c == '{') value.type = JsonType::Object;
+            else if (c == '[') value.type = JsonType::Array;
+            else if (c == '"') value.type = JsonType::String;
+            else if (c == 't' || c == 'f') value.type = JsonType::Bool;
+            else if (c == 'n') value.type = JsonType::Null;
+            else value.type = JsonType::Number;
+            result->values[p].push_back(value);
+        }
+    }
+    return result;
+}
+
+const char* jsonScannerKernel() {
+    return kernel().name;
+}
+
+bool setJsonScannerKernel(std::string_view name) {
+    if (name == "scalar") {
+        kernel() = {classifyScalar, "scalar"};
+        return true;
+    }
+#ifdef UNTANGLE_JSON_X86
+    if (name == "sse2") {
+        kernel() = {classifySse2, "sse2"};
+        return true;
+    }
+    __builtin_cpu_init();
+    if (name == "avx2" && __builtin_cpu_supports("avx2")) {
+        kernel() = {classifyAvx2, "avx2"};
+        return true;
+    }
+#endif
+    return false;
+}
@@ -0,0 +1,183 @@
+#include "latency_histogram.h"
+#include "execution_plan.h"
+#include "nodes.h"
+#include <algorithm>
+#include <cmath>
+
+int LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < 128) return static_cast<int>(value);
+    int exponent = (63 - __builtin_clzll(value)) - 6;
+    if (exponent > MAX_EXPONENT) return BUCKET_COUNT - 1;
+    return exponent * 64 + static_cast<int>(value >> exponent);
+}
+
+uint64_t LatencyHistogram::bucketValue(int index) {
+    if (index < 128) return static_cast<uint64_t>(index);
+    int exponent = index / 64 - 1;
+    uint64_t sub_bucket = static_cast<uint64_t>(index - exponent * 64);
+    return ((sub_bucket + 1) << exponent) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value_us) {
+    counts[bucketIndex(value_us)].fetch_add(1, std::memory_order_relaxed);
+    total_count.fetch_add(1, std::memory_order_relaxed);
+    total_sum.fetch_add(value_us, std::memory_order_relaxed);
+
+    uint64_t current = max_value.load(std::memory_order_relaxed);
+    while (value_us > current &&
+           !max_value.compare_exchange_weak(current, value_us, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        uint64_t n = other.counts[i].load(std::memory_order_relaxed);
+        if (n) counts[i].fetch_add(n, std::memory_order_relaxed);
+    }
+    total_count.fetch_add(other.total_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    total_sum.fetch_add(other.total_sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    uint64_t other_max = other.max_value.load(std::memory_order_relaxed);
+    uint64_t current = max_value.load(std::memory_order_relaxed);
+    while (other_max > current &&
+           !max_value.compare_exchange_weak(current, other_max, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (auto& count : counts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    total_count.store(0, std::memory_order_relaxed);
+    total_sum.store(0, std::memory_order_relaxed);
+    max_value.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::valueAtPercentile(double percentile) const {
+    // Sum the buckets instead of trusting total_count, which may be a step
+    // ahead of them while other threads are recording
+    uint64_t total = 0;
+    for (const auto& count : counts) {
+        total += count.load(std::memory_order_relaxed);
+    }
+    if (total == 0) return 0;
+
+    uint64_t target = static_cast<uint64_t>(std::ceil(percentile / 100.0 * total));
+    if (target < 1) target = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            return std::min(bucketValue(i), max());
+        }
+    }
+    return max();
+}
+
+LatencySummary LatencyHistogram::summary() const {
+    LatencySummary summary;
+    summary.count = count();
+    if (summary.count == 0) return summary;
+
+    summary.mean_us = double(total_sum.load(std::memory_order_relaxed)) / summary.count;
+    summary.p50_us = valueAtPercentile(50.0);
+    summary.p90_us = valueAtPercentile(90.0);
+    summary.p99_us = valueAtPercentile(99.0);
+    summary.p999_us = valueAtPercentile(99.9);
+    summary.max_us = max();
+    return summary;
+}
+
+void HttpPhaseStats::record(const HttpTimings& timings) {
+    dns_us.fetch_add(timings.dnsUs(), std::memory_order_relaxed);
+    connect_us.fetch_add(timings.connectUs(), std::memory_order_relaxed);
+    tls_us.fetch_add(timings.tlsUs(), std::memory_order_relaxed);
+    server_us.fetch_add(timings.serverUs(), std::memory_order_relaxed);
+    transfer_us.fetch_add(timings.transferUs(), std::memory_order_relaxed);
+    bytes_sent.fetch_add(timings.bytes_sent, std::memory_order_relaxed);
+    bytes_received.fetch_add(timings.bytes_received, std::memory_order_relaxed);
+    bytes_decoded.fetch_add(timings.bytes_decoded, std::memory_order_relaxed);
+    if (timings.connection_reused) reused.fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void HttpPhaseStats::reset() {
+    for (auto* total : {&count, &dns_us, &connect_us, &tls_us, &server_us, &transfer_us,
+                        &bytes_sent, &bytes_received, &bytes_decoded, &reused}) {
+        total->store(0, std::memory_order_relaxed);
+    }
+}
+
+HttpPhaseSummary HttpPhaseStats::summary() const {
+    HttpPhaseSummary summary;
+    summary.count = count.load(std::memory_order_relaxed);
+    if (summary.count == 0) return summary;
+
+    double n = static_cast<double>(summary.count);
+    summary.dns_us = dns_us.load(std::memory_order_relaxed) / n;
+    summary.connect_us = connect_us.load(std::memory_order_relaxed) / n;
+    summary.tls_us = tls_us.load(std::memory_order_relaxed) / n;
+    summary.server_us = server_us.load(std::memory_order_relaxed) / n;
+    summary.transfer_us = transfer_us.load(std::memory_order_relaxed) / n;
+    summary.bytes_sent = bytes_sent.load(std::memory_order_relaxed) / n;
+    summary.bytes_received = bytes_received.load(std::memory_order_relaxed) / n;
+    summary.bytes_decoded = bytes_decoded.load(std::memory_order_relaxed) / n;
+    summary.reused = reused.load(std::memory_order_relaxed) / n;
+    return summary;
+}
+
+PlanLatency LatencyRegistry::bind(const ExecutionPlan& plan) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto& entry = orchestrations[plan.getOrchestrationId()];
+    if (!entry) entry = std::make_unique<OrchestrationLatency>();
+
+    PlanLatency latency;
+    latency.orchestration = &entry->total;
+    latency.nodes.assign(plan.nodeCount(), nullptr);
+    latency.phases.assign(plan.nodeCount(), nullptr);
+    for (uint32_t i = 0; i < plan.nodeCount(); i++) {
+        const Node* node = plan.node(i);
+        if (node->getType().rfind("HTTP_", 0) != 0) continue;
+
+        auto& node_entry = entry->nodes[node->getId()];
+        if (!node_entry) node_entry = std::make_unique<NodeEntry>();
+        node_entry->type = node->getType();
+        latency.nodes[i] = &node_entry->histogram;
+        latency.phases[i] = &node_entry->phases;
+    }
+    return latency;
+}
+
+LatencySummary LatencyRegistry::orchestrationSummary(int orchestration_id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = orchestrations.find(orchestration_id);
+    return it != orchestrations.end() ? it->second->total.summary() : LatencySummary();
+}
+
+std::vector<NodeLatency> LatencyRegistry::nodeSummaries(int orchestration_id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<NodeLatency> result;
+    auto it = orchestrations.find(orchestration_id);
+    if (it == orchestrations.end()) return result;
+
+    for (const auto& [node_id, entry] : it->second->nodes) {
+        if (entry->histogram.count() == 0) continue;
+        result.push_back({node_id, entry->type, entry->histogram.summary(), entry->phases.summary()});
+    }
+    return result;
+}
+
+void LatencyRegistry::reset(int orchestration_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = orchestrations.find(orchestration_id);
+    if (it == orchestrations.end()) return;
+
+    // Zero in place; a running plan may still hold pointers to these
+    it->second->total.reset();
+    for (auto& [node_id, entry] : it->second->nodes) {
+        entry->histogram.reset();
+        entry->phases.reset();
+    }
+}
@@ -0,0 +1,403 @@
+#include "load_runner.h"
+#include "executor.h"
+#include "dag_scheduler.h"
+#include "async_http_client.h"
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <optional>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct VirtualUser {
+    HttpClient http_client;
+    ExecutionContext context;
+    InlineScheduler scheduler;
+    std::thread thread;
+    // Iteration latencies, merged once the run is over
+    LatencyHistogram latency;
+};
+
+// Event-driven counterpart of VirtualUser: no thread and no client of its own
+struct AsyncUser {
+    ExecutionContext context;
+    InlineScheduler scheduler;
+    Clock::time_point intended_start;
+};
+
+// Iteration budget and ArrivalRate schedule shared by both runners
+struct Schedule {
+    bool arrival_rate;
+    bool by_iterations;
+    int worker_count;
+    // ArrivalRate: slot k is due at started + k * interval
+    Clock::duration interval;
+    long long total_slots;
+
+    explicit Schedule(const LoadTestConfig& config) {
+        arrival_rate = config.mode == LoadMode::ArrivalRate;
+        by_iterations = config.iterations > 0;
+        worker_count = std::max(1, arrival_rate ? config.max_in_flight : config.virtual_users);
+
+        const double rate = config.arrival_rate > 0 ? config.arrival_rate : 1.0;
+        interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+        total_slots = by_iterations
+            ? config.iterations
+            : std::max(1LL, static_cast<long long>(config.duration_s * rate));
+    }
+};
+
+void resetIteration(ExecutionContext& context) {
+    context.clearVariables();
+    context.last_response_body.clear();
+    context.streamed_values.reset();
+    context.last_status_code = 0;
+}
+
+// Sleeps in short slices so a cancel is noticed quickly even when the next
+// slot is far away
+bool sleepUntil(Clock::time_point when, const std::atomic<bool>* cancel_flag) {
+    while (true) {
+        if (cancel_flag && cancel_flag->load(std::memory_order_relaxed)) return false;
+        auto remaining = when - Clock::now();
+        if (remaining <= Clock::duration::zero()) return true;
+        std::this_thread::sleep_for(std::min<Clock::duration>(remaining, std::chrono::milliseconds(20)));
+    }
+}
+
+} // namespace
+
+LoadRunner::LoadRunner(std::shared_ptr<const ExecutionPlan> plan, const LoadTestConfig& config,
+                       const std::atomic<bool>* cancel_flag, const PlanLatency* latency)
+    : plan(std::move(plan)), config(config), cancel_flag(cancel_flag), latency(latency) {}
+
+LoadTestStats LoadRunner::run(const std::function<void(const LoadTestStats&)>& on_progress) {
+    return config.io_threads > 0 ? runEventDriven(on_progress) : runThreaded(on_progress);
+}
+
+LoadTestStats LoadRunner::runThreaded(const std::function<void(const LoadTestStats&)>& on_progress) {
+    const Schedule schedule(config);
+    const bool arrival_rate = schedule.arrival_rate;
+    const bool by_iterations = schedule.by_iterations;
+    const int worker_count = schedule.worker_count;
+    const Clock::duration interval = schedule.interval;
+    const long long total_slots = schedule.total_slots;
+
+    std::atomic<long long> claimed{0};
+    std::atomic<long long> iterations{0};
+    std::atomic<long long> failed_iterations{0};
+    std::atomic<int> in_flight{0};
+    int workers_alive = 0;
+
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+
+    auto cancelled = [this] { return cancel_flag && cancel_flag->load(std::memory_order_relaxed); };
+
+    // Workers are fully set up on this thread before any of them starts
+    std::vector<std::unique_ptr<VirtualUser>> users;
+    users.reserve(worker_count);
+    for (int i = 0; i < worker_count; i++) {
+        auto user = std::make_unique<VirtualUser>();
+        user->http_client.setCancelFlag(cancel_flag);
+        user->http_client.setOptions(config.http);
+        user->context.http_client = &user->http_client;
+        user->context.cancel_flag = cancel_flag;
+        user->context.log_enabled = false;
+        user->context.latency = latency;
+        users.push_back(std::move(user));
+    }
+
+    const auto started = Clock::now();
+    const auto deadline = started + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(config.duration_s));
+
+    // Runs one iteration; latency is measured from intended_start
+    auto iterate = [&](VirtualUser* vu, Clock::time_point intended_start) {
+        resetIteration(vu->context);
+
+        in_flight.fetch_add(1, std::memory_order_relaxed);
+        bool success = vu->scheduler.run(*plan, vu->context);
+        in_flight.fetch_sub(1, std::memory_order_relaxed);
+
+        // A cancelled iteration is neither a success nor an error
+        if (cancelled()) return false;
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - intended_start);
+        vu->latency.record(static_cast<uint64_t>(elapsed.count()));
+        iterations.fetch_add(1, std::memory_order_relaxed);
+        if (!success) failed_iterations.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    };
+
+    auto closed_loop = [&](VirtualUser* vu) {
+        while (!cancelled()) {
+            if (by_iterations) {
+                if (claimed.fetch_add(1, std::memory_order_relaxed) >= config.iterations) break;
+            } else if (Clock::now() >= deadline) {
+                break;
+            }
+            if (!iterate(vu, Clock::now())) break;
+        }
+    };
+
+    auto open_loop = [&](VirtualUser* vu) {
+        while (true) {
+            long long slot = claimed.fetch_add(1, std::memory_order_relaxed);
+            if (slot >= total_slots) break;
+
+            Clock::time_point intended_start = started + interval * slot;
+            if (!sleepUntil(intended_start, cancel_flag)) break;
+            // Slots still waiting for a worker when the time is up are dropped
+            if (!by_iterations && Clock::now() >= deadline) break;
+            if (!iterate(vu, intended_start)) break;
+        }
+    };
+
+    workers_alive = worker_count;
+    for (auto& user : users) {
+        VirtualUser* vu = user.get();
+        vu->thread = std::thread([&, vu] {
+            if (arrival_rate) {
+                open_loop(vu);
+            } else {
+                closed_loop(vu);
+            }
+
+            std::lock_guard<std::mutex> lock(done_mutex);
+            workers_alive--;
+            done_cv.notify_all();
+        });
+    }
+
+    auto collect = [&] {
+        LoadTestStats stats;
+        stats.iterations = iterations.load(std::memory_order_relaxed);
+        stats.failed_iterations = failed_iterations.load(std::memory_order_relaxed);
+        for (const auto& user : users) {
+            stats.requests += user->context.requests_sent.load(std::memory_order_relaxed);
+            stats.failed_requests += user->context.requests_failed.load(std::memory_order_relaxed);
+        }
+        stats.active_users = in_flight.load(std::memory_order_relaxed);
+        stats.elapsed_s = std::chrono::duration<double>(Clock::now() - started).count();
+        return stats;
+    };
+
+    {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        while (workers_alive > 0) {
+            if (done_cv.wait_for(lock, std::chrono::seconds(1), [&] { return workers_alive == 0; })) break;
+            if (on_progress) {
+                lock.unlock();
+                on_progress(collect());
+                lock.lock();
+            }
+        }
+    }
+
+    for (auto& user : users) {
+        user->thread.join();
+    }
+
+    LoadTestStats stats = collect();
+    if (arrival_rate && !cancelled()) {
+        stats.dropped_iterations = total_slots - stats.iterations;
+    }
+
+    LatencyHistogram merged;
+    for (const auto& user : users) {
+        merged.merge(user->latency);
+    }
+    stats.latency = merged.summary();
+    if (latency && latency->orchestration) {
+        latency->orchestration->merge(merged);
+    }
+
+    if (on_progress) on_progress(stats);
+    return stats;
+}
+
+LoadTestStats LoadRunner::runEventDriven(const std::function<void(const LoadTestStats&)>& on_progress) {
+    const Schedule schedule(config);
+    const bool by_iterations = schedule.by_iterations;
+
+    std::atomic<long long> claimed{0};
+    std::atomic<long long> iterations{0};
+    std::atomic<long long> failed_iterations{0};
+    std::atomic<int> in_flight{0};
+    // Latency histograms are lock-free, so all users record into one
+    LatencyHistogram merged;
+
+    // Closed loop: users still chaining iterations. Arrival rate: the
+    // dispatcher plus every iteration it started that has not finished.
+    int workers_alive = 0;
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    auto workerDone = [&] {
+        std::lock_guard<std::mutex> lock(done_mutex);
+        workers_alive--;
+        done_cv.notify_all();
+    };
+
+    // ArrivalRate: users not running an iteration
+    std::vector<AsyncUser*> idle_users;
+    std::mutex idle_mutex;
+    std::condition_variable idle_cv;
+
+    auto cancelled = [this] { return cancel_flag && cancel_flag->load(std::memory_order_relaxed); };
+
+    // Reset explicitly once the run is over, see below
+    std::optional<AsyncHttpClient> client;
+    client.emplace(static_cast<size_t>(config.io_threads), config.http);
+
+    // Only used by nodes without an asynchronous path
+    HttpClient fallback_client;
+    fallback_client.setCancelFlag(cancel_flag);
+    fallback_client.setOptions(config.http);
+
+    std::vector<std::unique_ptr<AsyncUser>> users;
+    users.reserve(schedule.worker_count);
+    for (int i = 0; i < schedule.worker_count; i++) {
+        auto user = std::make_unique<AsyncUser>();
+        user->context.http_client = &fallback_client;
+        user->context.async_http = &*client;
+        user->context.cancel_flag = cancel_flag;
+        user->context.log_enabled = false;
+        user->context.latency = latency;
+        idle_users.push_back(user.get());
+        users.push_back(std::move(user));
+    }
+
+
+    const auto started = Clock::now();
+    const auto deadline = started + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(config.duration_s));
+
+    // Starts one iteration; finished is called on a loop thread with false
+    // when the iteration was cancelled
+    auto iterate = [&](AsyncUser* user, Clock::time_point intended_start, std::function<void(bool)> finished) {
+        resetIteration(user->context);
+        user->intended_start = intended_start;
+
+        in_flight.fetch_add(1, std::memory_order_relaxed);
+        user->scheduler.runAsync(*plan, user->context, [&, user, finished = std::move(finished)](bool success) {
+            in_flight.fetch_sub(1, std::memory_order_relaxed);
+            if (cancelled()) return finished(false);
+
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - user->intended_start);
+            merged.record(static_cast<uint64_t>(elapsed.count()));
+            iterations.fetch_add(1, std::memory_order_relaxed);
+            if (!success) failed_iterations.fetch_add(1, std::memory_order_relaxed);
+            finished(true);
+        });
+    };
+
+    // Closed loop: every user chains its next iteration through post(), so
+    // the stack unwinds between iterations even when nothing waits on I/O
+    std::function<void(AsyncUser*)> closed_loop = [&](AsyncUser* user) {
+        bool more = !cancelled();
+        if (more && by_iterations) {
+            more = claimed.fetch_add(1, std::memory_order_relaxed) < config.iterations;
+        } else if (more) {
+            more = Clock::now() < deadline;
+        }
+        if (!more) return workerDone();
+
+        iterate(user, Clock::now(), [&, user](bool keep_going) {
+            if (!keep_going) return workerDone();
+            client->post([&, user] { closed_loop(user); });
+        });
+    };
+
+    std::thread dispatcher;
+    if (!schedule.arrival_rate) {
+        workers_alive = schedule.worker_count;
+        for (auto& user : users) {
+            AsyncUser* raw = user.get();
+            client->post([&, raw] { closed_loop(raw); });
+        }
+    } else {
+        workers_alive = 1;
+        // Same schedule as the threaded runner, but a slot only needs an idle
+        // user rather than an idle thread
+        dispatcher = std::thread([&] {
+            for (long long slot = 0; slot < schedule.total_slots; slot++) {
+                Clock::time_point intended_start = started + schedule.interval * slot;
+                if (!sleepUntil(intended_start, cancel_flag)) break;
+                if (!by_iterations && Clock::now() >= deadline) break;
+
+                AsyncUser* user = nullptr;
+                {
+                    std::unique_lock<std::mutex> lock(idle_mutex);
+                    while (idle_users.empty()) {
+                        if (cancelled() || (!by_iterations && Clock::now() >= deadline)) break;
+                        idle_cv.wait_for(lock, std::chrono::milliseconds(20));
+                    }
+                    if (idle_users.empty()) break;
+                    user = idle_users.back();
+                    idle_users.pop_back();
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(done_mutex);
+                    workers_alive++;
+                }
+                iterate(user, intended_start, [&, user](bool) {
+                    {
+                        std::lock_guard<std::mutex> lock(idle_mutex);
+                        idle_users.push_back(user);
+                    }
+                    idle_cv.notify_one();
+                    workerDone();
+                });
+            }
+            workerDone();
+        });
+    }
+
+    auto collect = [&] {
+        LoadTestStats stats;
+        stats.iterations = iterations.load(std::memory_order_relaxed);
+        stats.failed_iterations = failed_iterations.load(std::memory_order_relaxed);
+        for (const auto& user : users) {
+            stats.requests += user->context.requests_sent.load(std::memory_order_relaxed);
+            stats.failed_requests += user->context.requests_failed.load(std::memory_order_relaxed);
+        }
+        stats.active_users = in_flight.load(std::memory_order_relaxed);
+        stats.elapsed_s = std::chrono::duration<double>(Clock::now() - started).count();
+        return stats;
+    };
+
+    {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        while (workers_alive > 0) {
+            if (done_cv.wait_for(lock, std::chrono::seconds(1), [&] { return workers_alive == 0; })) break;
+            if (on_progress) {
+                lock.unlock();
+                on_progress(collect());
+                lock.lock();
+            }
+        }
+    }
+    if (dispatcher.joinable()) dispatcher.join();
+    // The last callbacks may still be unwinding on the loop threads; join
+    // them before the users and closures they reference go away
+    client.reset();
+
+    LoadTestStats stats = collect();
+    if (schedule.arrival_rate && !cancelled()) {
+        stats.dropped_iterations = schedule.total_slots - stats.iterations;
+    }
+
+    stats.latency = merged.summary();
+    if (latency && latency->orchestration) {
+        latency->orchestration->merge(merged);
+    }
+
+    if (on_progress) on_progress(stats);
+    return stats;
+}
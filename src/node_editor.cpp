@@ -18,12 +18,14 @@ NodeEditor::~NodeEditor() {
 
 bool NodeEditor::initialize() {
   ImNodes::CreateContext();
+  engine.start();
   initialized = true;
   return true;
 }
 
 void NodeEditor::shutdown() {
   if (initialized) {
+    engine.stop();
     ImNodes::DestroyContext();
     initialized = false;
   }
@@ -54,13 +56,23 @@ void NodeEditor::render(const Sidebar& sidebar, Terminal* terminal) {
   OrchestrationData& data = getOrchestrationData(orchestration_id);
 
   ImGuiIO& io = ImGui::GetIO();
-  ImGui::SetCursorPos(ImVec2(io.DisplaySize.x - Sidebar::SIDEBAR_WIDTH - 240, 10));
+  ImGui::SetCursorPos(ImVec2(io.DisplaySize.x - Sidebar::SIDEBAR_WIDTH - 410, 10));
   
   ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.2f, 0.7f, 0.2f, 1.0f));
   ImGui::PushStyleColor(ImGuiCol_ButtonHovered, ImVec4(0.3f, 0.8f, 0.3f, 1.0f));
   ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4(0.1f, 0.6f, 0.1f, 1.0f));
   
-  if (ImGui::Button("Execute", ImVec2(100, 30))) {
+  bool busy = engine.isBusy();
+
+  if (busy) {
+    ImGui::PopStyleColor(3);
+    ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.7f, 0.2f, 0.2f, 1.0f));
+    ImGui::PushStyleColor(ImGuiCol_ButtonHovered, ImVec4(0.8f, 0.3f, 0.3f, 1.0f));
+    ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4(0.6f, 0.1f, 0.1f, 1.0f));
+    if (ImGui::Button("Cancel", ImVec2(100, 30))) {
+      cancelExecution();
+    }
+  } else if (ImGui::Button("Execute", ImVec2(100, 30))) {
     printf("Executing orchestration %d...\n", orchestration_id);
     executeOrchestration(orchestration_id, terminal);
   }
@@ -72,11 +84,24 @@ void NodeEditor::render(const Sidebar& sidebar, Terminal* terminal) {
   ImGui::PushStyleColor(ImGuiCol_ButtonHovered, ImVec4(0.8f, 0.6f, 0.3f, 1.0f));
   ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4(0.6f, 0.4f, 0.1f, 1.0f));
   
-  if (ImGui::Button("Execute Selected", ImVec2(120, 30))) {
+  if (ImGui::Button("Execute Selected", ImVec2(120, 30)) && !busy) {
     executeSelectedNode(terminal);
   }
   
   ImGui::PopStyleColor(3);
+
+  ImGui::SameLine();
+  if (ImGui::Button("Load Test", ImVec2(90, 30)) && !busy) {
+    ImGui::OpenPopup("LoadTestPopup");
+  }
+  drawLoadTestPopup(orchestration_id, terminal);
+
+  ImGui::SameLine();
+  if (ImGui::Button("HTTP", ImVec2(60, 30))) {
+    ImGui::OpenPopup("HttpSettingsPopup");
+  }
+  drawHttpSettingsPopup();
+  drawRunStatus();
   ImNodes::BeginNodeEditor();
 
   drawNodes(data);
@@ -88,7 +113,11 @@ void NodeEditor::render(const Sidebar& sidebar, Terminal* terminal) {
   ImNodes::EndNodeEditor();
 
   for(auto& node : data.nodes) {
+    ImVec2 position = node->getPosition();
     node->updatePosition();
+    if (node->getPosition().x != position.x || node->getPosition().y != position.y) {
+      data.nodeChanged(node->getId());
+    }
   }
 
   createLinks(data);
@@ -98,73 +127,25 @@ void NodeEditor::render(const Sidebar& sidebar, Terminal* terminal) {
 }
 
 void NodeEditor::createNode(const std::string& nodeType, ImVec2 position, OrchestrationData& data) {
-  std::unique_ptr<Node> newNode;
-
-  if (nodeType == "Start") {
-    newNode = std::make_unique<StartNode>(data.next_node_id);
-  } else if (nodeType == "HTTP_GET") {
-    newNode = std::make_unique<HttpGetNode>(data.next_node_id);
-  } else if (nodeType == "HTTP_POST") {
-    newNode = std::make_unique<HttpPostNode>(data.next_node_id);
-  } else if (nodeType == "HTTP_PUT") {
-    newNode = std::make_unique<HttpPutNode>(data.next_node_id);
-  } else if (nodeType == "HTTP_DELETE") {
-    newNode = std::make_unique<HttpDeleteNode>(data.next_node_id);
-  } else if (nodeType == "JSON_EXTRACT") {
-    newNode = std::make_unique<JsonExtractNode>(data.next_node_id);
-  } else if (nodeType == "SET_VARIABLE") {
-    newNode = std::make_unique<SetVariableNode>(data.next_node_id);
-  } else if (nodeType == "GET_VARIABLE") {
-    newNode = std::make_unique<GetVariableNode>(data.next_node_id);
-  } else if (nodeType == "IF_CONDITION") {
-    newNode = std::make_unique<IfConditionNode>(data.next_node_id);
-  } else if (nodeType == "DELAY") {
-    newNode = std::make_unique<DelayNode>(data.next_node_id);
-  } else if (nodeType == "ASSERT") {
-    newNode = std::make_unique<AssertNode>(data.next_node_id);
-  } else if (nodeType == "LOG") {
-    newNode = std::make_unique<LogNode>(data.next_node_id);
-  }
+  std::unique_ptr<Node> newNode = Node::create(nodeType, data.next_node_id);
 
   if (newNode) {
     newNode->setPosition(position);
+    data.nodeChanged(newNode->getId());
     data.nodes.push_back(std::move(newNode));
     data.next_node_id += 10;
+    data.revision++;
   }
 }
 
 void NodeEditor::createNodeWithId(int node_id, const std::string& nodeType, ImVec2 position, OrchestrationData& data) {
-  std::unique_ptr<Node> newNode;
-
-  if (nodeType == "Start") {
-    newNode = std::make_unique<StartNode>(node_id);
-  } else if (nodeType == "HTTP_GET") {
-    newNode = std::make_unique<HttpGetNode>(node_id);
-  } else if (nodeType == "HTTP_POST") {
-    newNode = std::make_unique<HttpPostNode>(node_id);
-  } else if (nodeType == "HTTP_PUT") {
-    newNode = std::make_unique<HttpPutNode>(node_id);
-  } else if (nodeType == "HTTP_DELETE") {
-    newNode = std::make_unique<HttpDeleteNode>(node_id);
-  } else if (nodeType == "JSON_EXTRACT") {
-    newNode = std::make_unique<JsonExtractNode>(node_id);
-  } else if (nodeType == "SET_VARIABLE") {
-    newNode = std::make_unique<SetVariableNode>(node_id);
-  } else if (nodeType == "GET_VARIABLE") {
-    newNode = std::make_unique<GetVariableNode>(node_id);
-  } else if (nodeType == "IF_CONDITION") {
-    newNode = std::make_unique<IfConditionNode>(node_id);
-  } else if (nodeType == "DELAY") {
-    newNode = std::make_unique<DelayNode>(node_id);
-  } else if (nodeType == "ASSERT") {
-    newNode = std::make_unique<AssertNode>(node_id);
-  } else if (nodeType == "LOG") {
-    newNode = std::make_unique<LogNode>(node_id);
-  }
+  std::unique_ptr<Node> newNode = Node::create(nodeType, node_id);
 
   if (newNode) {
     newNode->setPosition(position);
+    data.nodeChanged(node_id);
     data.nodes.push_back(std::move(newNode));
+    data.revision++;
     
     if (node_id >= data.next_node_id) {
       data.next_node_id = node_id + 10;
@@ -172,16 +153,23 @@ void NodeEditor::createNodeWithId(int node_id, const std::string& nodeType, ImVe
   }
 }
 
-void NodeEditor::drawNodes(const OrchestrationData& data) const {
+void NodeEditor::drawNodes(OrchestrationData& data) {
   for (auto const& n : data.nodes) {
+    unsigned int revision = n->getRevision();
     n->draw();
+    if (n->getRevision() != revision) {
+      data.nodeChanged(n->getId());
+      data.revision++;
+    }
   }
 }
 
 void NodeEditor::createLinks(OrchestrationData& data) {
   int start_attr, end_attr;
   if (ImNodes::IsLinkCreated(&start_attr, &end_attr)) {
+    data.linkChanged(data.next_link_id);
     data.links.push_back(std::make_unique<Link>(data.next_link_id++, start_attr, end_attr));
+    data.revision++;
   }
 }
 
@@ -287,6 +275,8 @@ void NodeEditor::deleteLinks(OrchestrationData& data) {
     return;
   }
   
+  size_t link_count = data.links.size();
+
   if (ImGui::IsKeyPressed(ImGuiKey_Delete) || ImGui::IsKeyPressed(ImGuiKey_Backspace)) {
     int num_selected = ImNodes::NumSelectedLinks();
     if (num_selected == 0) return;
@@ -296,6 +286,7 @@ void NodeEditor::deleteLinks(OrchestrationData& data) {
     ImNodes::GetSelectedLinks(selected_links.data());
 
     for (int selected_id : selected_links) {
+      data.linkRemoved(selected_id);
       data.links.erase(
           std::remove_if(data.links.begin(), data.links.end(),
             [selected_id](const std::unique_ptr<Link>& l) {
@@ -308,6 +299,7 @@ void NodeEditor::deleteLinks(OrchestrationData& data) {
 
   int link_id;
   if (ImNodes::IsLinkDestroyed(&link_id)) {
+    data.linkRemoved(link_id);
     data.links.erase(
         std::remove_if(data.links.begin(), data.links.end(),
           [link_id](const std::unique_ptr<Link>& l) {
@@ -316,6 +308,10 @@ void NodeEditor::deleteLinks(OrchestrationData& data) {
         data.links.end()
         );
   }
+
+  if (data.links.size() != link_count) {
+    data.revision++;
+  }
 }
 
 void NodeEditor::deleteNodes(OrchestrationData& data) {
@@ -324,6 +320,7 @@ void NodeEditor::deleteNodes(OrchestrationData& data) {
   }
   
   if (ImGui::IsKeyPressed(ImGuiKey_Delete) || ImGui::IsKeyPressed(ImGuiKey_Backspace)) {
+    size_t node_count = data.nodes.size();
     data.nodes.erase(
         std::remove_if(data.nodes.begin(), data.nodes.end(),
           [&](const std::unique_ptr<Node>& n) {
@@ -332,17 +329,26 @@ void NodeEditor::deleteNodes(OrchestrationData& data) {
           data.links.erase(
               std::remove_if(data.links.begin(), data.links.end(),
                 [&](const std::unique_ptr<Link>& l) {
-                return std::find(nodeAttributes.begin(), nodeAttributes.end(), l->start_attr) != nodeAttributes.end() ||
-                std::find(nodeAttributes.begin(), nodeAttributes.end(), l->end_attr) != nodeAttributes.end();
+                if (std::find(nodeAttributes.begin(), nodeAttributes.end(), l->start_attr) != nodeAttributes.end() ||
+                    std::find(nodeAttributes.begin(), nodeAttributes.end(), l->end_attr) != nodeAttributes.end()) {
+                  data.linkRemoved(l->id);
+                  return true;
+                }
+                return false;
                 }),
               data.links.end()
               );
+          data.nodeRemoved(n->getId());
           return true;
           }
           return false;
           }),
         data.nodes.end()
         );
+
+    if (data.nodes.size() != node_count) {
+      data.revision++;
+    }
   }
 }
 
@@ -384,6 +390,81 @@ std::vector<LinkData> NodeEditor::getAllLinksData() const {
   return result;
 }
 
+std::vector<NodeData> NodeEditor::getChangedNodesData() const {
+  std::vector<NodeData> result;
+
+  for (const auto& [orch_id, data] : orchestration_data) {
+    if (data->dirty_nodes.empty()) continue;
+    for (const auto& node : data->nodes) {
+      if (data->dirty_nodes.count(node->getId()) == 0) continue;
+      NodeData node_data;
+      node_data.id = node->getId();
+      node_data.orchestration_id = orch_id;
+      node_data.pos_x = node->getPosition().x;
+      node_data.pos_y = node->getPosition().y;
+      node_data.type = node->getType();
+      node_data.data = node->serializeData();
+
+      result.push_back(node_data);
+    }
+  }
+
+  return result;
+}
+
+std::vector<LinkData> NodeEditor::getChangedLinksData() const {
+  std::vector<LinkData> result;
+
+  for (const auto& [orch_id, data] : orchestration_data) {
+    if (data->dirty_links.empty()) continue;
+    for (const auto& link : data->links) {
+      if (data->dirty_links.count(link->id) == 0) continue;
+      LinkData link_data;
+      link_data.id = link->id;
+      link_data.orchestration_id = orch_id;
+      link_data.start_attr = link->start_attr;
+      link_data.end_attr = link->end_attr;
+
+      result.push_back(link_data);
+    }
+  }
+
+  return result;
+}
+
+std::vector<RowKey> NodeEditor::getRemovedNodes() const {
+  std::vector<RowKey> result;
+
+  for (const auto& [orch_id, data] : orchestration_data) {
+    for (int node_id : data->removed_nodes) {
+      result.push_back({node_id, orch_id});
+    }
+  }
+
+  return result;
+}
+
+std::vector<RowKey> NodeEditor::getRemovedLinks() const {
+  std::vector<RowKey> result;
+
+  for (const auto& [orch_id, data] : orchestration_data) {
+    for (int link_id : data->removed_links) {
+      result.push_back({link_id, orch_id});
+    }
+  }
+
+  return result;
+}
+
+void NodeEditor::markSaved() {
+  for (auto& [orch_id, data] : orchestration_data) {
+    data->dirty_nodes.clear();
+    data->removed_nodes.clear();
+    data->dirty_links.clear();
+    data->removed_links.clear();
+  }
+}
+
 void NodeEditor::loadNodesData(const std::vector<NodeData>& nodes_data) {
   for (const auto& node_data : nodes_data) {
     auto& data = getOrchestrationData(node_data.orchestration_id);
@@ -403,6 +484,8 @@ void NodeEditor::loadLinksData(const std::vector<LinkData>& links_data) {
     if (it != orchestration_data.end()) {
       auto& data = *it->second;
       data.links.push_back(std::make_unique<Link>(link_data.id, link_data.start_attr, link_data.end_attr));
+      data.linkChanged(link_data.id);
+      data.revision++;
       
       if (link_data.id >= data.next_link_id) {
         data.next_link_id = link_data.id + 1;
@@ -411,6 +494,163 @@ void NodeEditor::loadLinksData(const std::vector<LinkData>& links_data) {
   }
 }
 
+std::shared_ptr<const ExecutionPlan> NodeEditor::getPlan(int orchestration_id, OrchestrationData& data) {
+  if (!data.plan || data.plan_revision != data.revision) {
+    data.plan = ExecutionPlan::compile(orchestration_id, data.nodes, data.links);
+    data.plan_revision = data.revision;
+  }
+  return data.plan;
+}
+
+std::shared_ptr<const ExecutionPlan> NodeEditor::getPlan(int orchestration_id) {
+  auto it = orchestration_data.find(orchestration_id);
+  if (it == orchestration_data.end()) return nullptr;
+  return getPlan(orchestration_id, *it->second);
+}
+
+void NodeEditor::drawRunStatus() {
+  RunStatus status = engine.getStatus();
+  if (status.state == RunState::Idle) return;
+
+  ImGui::SameLine();
+  if (status.load_test) {
+    const LoadTestStats& stats = status.load_stats;
+    ImVec4 color = status.state == RunState::Running ? ImVec4(0.3f, 1.0f, 0.3f, 1.0f) : ImVec4(0.6f, 0.6f, 0.6f, 1.0f);
+    ImGui::TextColored(color, "Load test %s: %d in flight, %lld iterations (%.1f/s), %lld requests (%.1f/s, %.1f%% errors)",
+        runStateName(status.state), stats.active_users, stats.iterations, stats.iterationsPerSecond(),
+        stats.requests, stats.requestsPerSecond(), stats.requestErrorRate() * 100.0);
+    if (status.state != RunState::Running && stats.iterations > 0) {
+      ImGui::SameLine();
+      ImGui::TextDisabled("p50 %.1f ms, p99 %.1f ms, %lld dropped",
+          stats.latency.p50_us / 1000.0, stats.latency.p99_us / 1000.0, stats.dropped_iterations);
+    }
+  } else if (status.state == RunState::Running) {
+    ImGui::TextColored(ImVec4(0.3f, 1.0f, 0.3f, 1.0f), "Running: %d done, %d in flight (last started: %d)",
+        status.nodes_executed, status.nodes_running, status.current_node_id);
+  } else {
+    ImGui::TextDisabled("Last run: %s (%d nodes, %.0f ms)",
+        runStateName(status.state), status.nodes_executed, status.elapsed_ms);
+  }
+}
+
+void NodeEditor::drawLoadTestPopup(int orchestration_id, Terminal* terminal) {
+  if (!ImGui::BeginPopup("LoadTestPopup")) return;
+
+  ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f), "Load Test");
+  ImGui::Separator();
+
+  int mode = static_cast<int>(load_config.mode);
+  ImGui::RadioButton("Virtual users", &mode, static_cast<int>(LoadMode::ClosedLoop));
+  ImGui::SameLine();
+  ImGui::RadioButton("Arrival rate", &mode, static_cast<int>(LoadMode::ArrivalRate));
+  load_config.mode = static_cast<LoadMode>(mode);
+
+  // Event-driven runs keep users on a few curl multi loops instead of one
+  // thread each, so far more of them are allowed
+  ImGui::Checkbox("Event-driven", &load_event_driven);
+  if (load_event_driven) {
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(80);
+    ImGui::InputInt("I/O threads", &load_io_threads);
+    load_io_threads = std::clamp(load_io_threads, 1, 64);
+  }
+  const int concurrency_limit = load_event_driven ? 20000 : 1000;
+
+  ImGui::SetNextItemWidth(120);
+  if (load_config.mode == LoadMode::ArrivalRate) {
+    ImGui::InputDouble("Iterations/s", &load_config.arrival_rate, 10.0, 100.0, "%.1f");
+    if (load_config.arrival_rate < 0.1) load_config.arrival_rate = 0.1;
+    ImGui::SetNextItemWidth(120);
+    ImGui::InputInt("Max in flight", &load_config.max_in_flight);
+    load_config.max_in_flight = std::clamp(load_config.max_in_flight, 1, concurrency_limit);
+  } else {
+    ImGui::InputInt("Users", &load_config.virtual_users);
+    load_config.virtual_users = std::clamp(load_config.virtual_users, 1, concurrency_limit);
+  }
+
+  ImGui::Checkbox("Fixed iteration count", &load_by_iterations);
+  ImGui::SetNextItemWidth(120);
+  if (load_by_iterations) {
+    ImGui::InputScalar("Iterations", ImGuiDataType_S64, &load_iterations);
+    if (load_iterations < 1) load_iterations = 1;
+  } else {
+    ImGui::InputDouble("Duration (s)", &load_config.duration_s, 1.0, 10.0, "%.1f");
+    if (load_config.duration_s < 0.1) load_config.duration_s = 0.1;
+  }
+
+  ImGui::Spacing();
+  if (ImGui::Button("Run", ImVec2(80, 0))) {
+    executeLoadTest(orchestration_id, terminal);
+    ImGui::CloseCurrentPopup();
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Close", ImVec2(80, 0))) {
+    ImGui::CloseCurrentPopup();
+  }
+
+  ImGui::EndPopup();
+}
+
+void NodeEditor::drawHttpSettingsPopup() {
+  if (!ImGui::BeginPopup("HttpSettingsPopup")) return;
+
+  ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f), "HTTP");
+  ImGui::Separator();
+
+  // Applied from the next run on; the engine keeps the current run as is
+  HttpOptions options = engine.getHttpOptions();
+  int version = static_cast<int>(options.version);
+  const char* versions[] = {"HTTP/1.1", "HTTP/2 (TLS)", "HTTP/2 (prior knowledge)"};
+  ImGui::SetNextItemWidth(200);
+  ImGui::Combo("Protocol", &version, versions, IM_ARRAYSIZE(versions));
+  options.version = static_cast<HttpVersion>(version);
+
+  if (options.version != HttpVersion::Http1) {
+    int streams = static_cast<int>(options.max_concurrent_streams);
+    ImGui::SetNextItemWidth(120);
+    ImGui::InputInt("Max streams", &streams);
+    options.max_concurrent_streams = std::clamp(streams, 1, 1000);
+    ImGui::TextDisabled("Prior knowledge falls back to HTTP/1.1\nfor servers that do not speak HTTP/2");
+  }
+
+  ImGui::Checkbox("Compressed responses", &options.compression);
+
+  int spool_mb = static_cast<int>(options.spool_threshold >> 20);
+  ImGui::SetNextItemWidth(120);
+  ImGui::InputInt("Spool above (MB)", &spool_mb);
+  options.spool_threshold = static_cast<size_t>(std::clamp(spool_mb, 0, 4096)) << 20;
+  ImGui::TextDisabled("Larger bodies go to a mapped temp file; 0 keeps all in memory");
+
+  if (options != engine.getHttpOptions()) {
+    engine.setHttpOptions(options);
+  }
+
+  ImGui::EndPopup();
+}
+
+void NodeEditor::executeLoadTest(int orchestration_id, Terminal* terminal) {
+  auto it = orchestration_data.find(orchestration_id);
+  if (it == orchestration_data.end()) {
+    std::string msg = "Orchestration not found";
+    printf("%s\n", msg.c_str());
+    if (terminal) terminal->log(msg);
+    return;
+  }
+
+  RunRequest request;
+  request.plan = getPlan(orchestration_id, *it->second);
+  request.load_test = true;
+  request.load_config = load_config;
+  request.load_config.iterations = load_by_iterations ? load_iterations : 0;
+  request.load_config.io_threads = load_event_driven ? load_io_threads : 0;
+  request.terminal = terminal;
+  engine.submit(std::move(request));
+}
+
+void NodeEditor::cancelExecution() {
+  engine.cancel();
+}
+
 void NodeEditor::executeSelectedNode(Terminal* terminal) {
   std::vector<int> selected_nodes;
   selected_nodes.resize(ImNodes::NumSelectedNodes());
@@ -428,21 +668,11 @@ void NodeEditor::executeSelectedNode(Terminal* terminal) {
   for (auto& [orch_id, data] : orchestration_data) {
     for (auto& node : data->nodes) {
       if (node->getId() == selected_node_id) {
-        std::string msg = "\n=== Executing Single Node ===";
-        printf("%s\n", msg.c_str());
-        if (terminal) terminal->log(msg);
-        
-        execution_context.execution_log.clear();
-        execution_context.terminal = terminal;
-        bool success = NodeExecutor::execute(node.get(), execution_context);
-        
-        msg = "Execution " + std::string(success ? "SUCCESS" : "FAILED");
-        printf("%s\n", msg.c_str());
-        if (terminal) terminal->log(msg);
-        
-        msg = "=== End Execution ===\n";
-        printf("%s\n", msg.c_str());
-        if (terminal) terminal->log(msg);
+        RunRequest request;
+        request.plan = getPlan(orch_id, *data);
+        request.single_node_id = selected_node_id;
+        request.terminal = terminal;
+        engine.submit(std::move(request));
         return;
       }
     }
@@ -462,112 +692,8 @@ void NodeEditor::executeOrchestration(int orchestration_id, Terminal* terminal)
     return;
   }
   
-  auto& data = *it->second;
-  
-  std::string msg = "\n=== Executing Full Orchestration ===";
-  printf("%s\n", msg.c_str());
-  if (terminal) terminal->log(msg);
-  
-  execution_context.execution_log.clear();
-  execution_context.variables.clear();
-  execution_context.terminal = terminal;
-  
-  Node* start_node = nullptr;
-  for (auto& node : data.nodes) {
-    if (node->getType() == "Start") {
-      start_node = node.get();
-      break;
-    }
-  }
-  
-  if (!start_node) {
-    msg = "ERROR: No Start node found in orchestration";
-    printf("%s\n", msg.c_str());
-    if (terminal) terminal->log(msg);
-    return;
-  }
-  
-  if (!NodeExecutor::execute(start_node, execution_context)) {
-    msg = "Start node execution failed";
-    printf("%s\n", msg.c_str());
-    if (terminal) terminal->log(msg);
-    return;
-  }
-  
-  std::vector<Node*> execution_queue;
-  std::map<int, bool> executed_nodes;
-  
-  auto start_attrs = start_node->getAttributeIds();
-  if (start_attrs.empty()) {
-    msg = "Start node has no output";
-    printf("%s\n", msg.c_str());
-    if (terminal) terminal->log(msg);
-    return;
-  }
-  
-  int current_attr = start_attrs[0];
-  executed_nodes[start_node->getId()] = true;
-  
-  int max_iterations = 100;
-  int iterations = 0;
-  
-  while (iterations < max_iterations) {
-    iterations++;
-    
-    Link* next_link = nullptr;
-    for (auto& link : data.links) {
-      if (link->start_attr == current_attr) {
-        next_link = link.get();
-        break;
-      }
-    }
-    
-    if (!next_link) {
-      msg = "No more connected nodes, execution complete";
-      printf("%s\n", msg.c_str());
-      if (terminal) terminal->log(msg);
-      break;
-    }
-    
-    Node* next_node = nullptr;
-    for (auto& node : data.nodes) {
-      if (executed_nodes[node->getId()]) continue;
-      
-      auto attrs = node->getAttributeIds();
-      for (int attr : attrs) {
-        if (attr == next_link->end_attr) {
-          next_node = node.get();
-          break;
-        }
-      }
-      if (next_node) break;
-    }
-    
-    if (!next_node) {
-      msg = "Could not find next node in chain";
-      printf("%s\n", msg.c_str());
-      if (terminal) terminal->log(msg);
-      break;
-    }
-    
-    if (!NodeExecutor::execute(next_node, execution_context)) {
-      msg = "Node execution failed, stopping";
-      printf("%s\n", msg.c_str());
-      if (terminal) terminal->log(msg);
-      break;
-    }
-    
-    executed_nodes[next_node->getId()] = true;
-    
-    auto next_attrs = next_node->getAttributeIds();
-    if (!next_attrs.empty()) {
-      current_attr = next_attrs.back();
-    } else {
-      break;
-    }
-  }
-  
-  msg = "=== End Orchestration Execution ===\n";
-  printf("%s\n", msg.c_str());
-  if (terminal) terminal->log(msg);
+  RunRequest request;
+  request.plan = getPlan(orchestration_id, *it->second);
+  request.terminal = terminal;
+  engine.submit(std::move(request));
 }
@@ -1,4 +1,8 @@
 #include "nodes.h"
+#include "http_client.h"
+#include "request_template.h"
+#include "json_path.h"
+#include "expression.h"
 #include <string>
 #include <sstream>
 #include <cstring>
@@ -37,6 +41,31 @@ Node::~Node() {}
 
 int Node::getId() const { return id; }
 
+std::unique_ptr<Node> Node::create(const std::string& type, int nodeId) {
+  if (type == "Start") return std::make_unique<StartNode>(nodeId);
+  if (type == "HTTP_GET") return std::make_unique<HttpGetNode>(nodeId);
+  if (type == "HTTP_POST") return std::make_unique<HttpPostNode>(nodeId);
+  if (type == "HTTP_PUT") return std::make_unique<HttpPutNode>(nodeId);
+  if (type == "HTTP_DELETE") return std::make_unique<HttpDeleteNode>(nodeId);
+  if (type == "JSON_EXTRACT") return std::make_unique<JsonExtractNode>(nodeId);
+  if (type == "SET_VARIABLE") return std::make_unique<SetVariableNode>(nodeId);
+  if (type == "GET_VARIABLE") return std::make_unique<GetVariableNode>(nodeId);
+  if (type == "IF_CONDITION") return std::make_unique<IfConditionNode>(nodeId);
+  if (type == "DELAY") return std::make_unique<DelayNode>(nodeId);
+  if (type == "ASSERT") return std::make_unique<AssertNode>(nodeId);
+  if (type == "LOG") return std::make_unique<LogNode>(nodeId);
+  return nullptr;
+}
+
+std::unique_ptr<Node> Node::clone() const {
+  std::unique_ptr<Node> copy = create(getType(), id);
+  if (copy) {
+    copy->deserializeData(serializeData());
+    copy->position = position;
+  }
+  return copy;
+}
+
 void Node::setPosition(ImVec2 pos) {
   position = pos;
   ImNodes::SetNodeGridSpacePos(id, position);
@@ -76,7 +105,19 @@ void StartNode::draw() {
 }
 
 // -------------------- HttpGetNode --------------------
-HttpGetNode::HttpGetNode(int nodeId) : Node(nodeId, "HTTP GET") {}
+HttpGetNode::HttpGetNode(int nodeId) : Node(nodeId, "HTTP GET") {
+  updateRequestTemplate();
+}
+
+void HttpGetNode::updateRequestTemplate() {
+  request_template = std::make_shared<const RequestTemplate>("GET", url, headers, "");
+}
+
+void HttpGetNode::resolveVariables() {
+  auto resolved = std::make_shared<RequestTemplate>(*request_template);
+  resolved->resolveVariables();
+  request_template = std::move(resolved);
+}
 
 std::vector<int> HttpGetNode::getAttributeIds() const { 
   return {id + 1, id + 2, id + 3, id + 4}; 
@@ -98,10 +139,16 @@ void HttpGetNode::draw() {
 
   ImGui::PushItemWidth(200);
   ImGui::Text("URL:");
-  ImGui::InputText("##url", url, sizeof(url));
+  if (ImGui::InputText("##url", url, sizeof(url))) {
+    markModified();
+    updateRequestTemplate();
+  }
   
   ImGui::Text("Headers:");
-  ImGui::InputTextMultiline("##headers", headers, sizeof(headers), ImVec2(200, 40));
+  if (ImGui::InputTextMultiline("##headers", headers, sizeof(headers), ImVec2(200, 40))) {
+    markModified();
+    updateRequestTemplate();
+  }
   ImGui::PopItemWidth();
 
   ImNodes::BeginOutputAttribute(id + 2);
@@ -138,10 +185,23 @@ void HttpGetNode::deserializeData(const std::string& data) {
         strncpy(headers, headers_str.c_str(), sizeof(headers) - 1);
         headers[sizeof(headers) - 1] = '\0';
     }
+    updateRequestTemplate();
 }
 
 // -------------------- HttpPostNode --------------------
-HttpPostNode::HttpPostNode(int nodeId) : Node(nodeId, "HTTP POST") {}
+HttpPostNode::HttpPostNode(int nodeId) : Node(nodeId, "HTTP POST") {
+  updateRequestTemplate();
+}
+
+void HttpPostNode::updateRequestTemplate() {
+  request_template = std::make_shared<const RequestTemplate>("POST", url, headers, body);
+}
+
+void HttpPostNode::resolveVariables() {
+  auto resolved = std::make_shared<RequestTemplate>(*request_template);
+  resolved->resolveVariables();
+  request_template = std::move(resolved);
+}
 
 std::vector<int> HttpPostNode::getAttributeIds() const { 
   return {id + 1, id + 2, id + 3, id + 4, id + 5}; 
@@ -163,13 +223,22 @@ void HttpPostNode::draw() {
 
   ImGui::PushItemWidth(200);
   ImGui::Text("URL:");
-  ImGui::InputText("##url", url, sizeof(url));
+  if (ImGui::InputText("##url", url, sizeof(url))) {
+    markModified();
+    updateRequestTemplate();
+  }
   
   ImGui::Text("Headers:");
-  ImGui::InputTextMultiline("##headers", headers, sizeof(headers), ImVec2(200, 40));
+  if (ImGui::InputTextMultiline("##headers", headers, sizeof(headers), ImVec2(200, 40))) {
+    markModified();
+    updateRequestTemplate();
+  }
   
   ImGui::Text("Body:");
-  ImGui::InputTextMultiline("##body", body, sizeof(body), ImVec2(200, 60));
+  if (ImGui::InputTextMultiline("##body", body, sizeof(body), ImVec2(200, 60))) {
+    markModified();
+    updateRequestTemplate();
+  }
   ImGui::PopItemWidth();
 
   ImNodes::BeginInputAttribute(id + 2);
@@ -222,10 +291,23 @@ void HttpPostNode::deserializeData(const std::string& data) {
     
     strncpy(body, body_str.c_str(), sizeof(body) - 1);
     body[sizeof(body) - 1] = '\0';
+    updateRequestTemplate();
 }
 
 // -------------------- HttpPutNode --------------------
-HttpPutNode::HttpPutNode(int nodeId) : Node(nodeId, "HTTP PUT") {}
+HttpPutNode::HttpPutNode(int nodeId) : Node(nodeId, "HTTP PUT") {
+  updateRequestTemplate();
+}
+
+void HttpPutNode::updateRequestTemplate() {
+  request_template = std::make_shared<const RequestTemplate>("PUT", url, headers, body);
+}
+
+void HttpPutNode::resolveVariables() {
+  auto resolved = std::make_shared<RequestTemplate>(*request_template);
+  resolved->resolveVariables();
+  request_template = std::move(resolved);
+}
 
 std::vector<int> HttpPutNode::getAttributeIds() const { 
   return {id + 1, id + 2, id + 3, id + 4, id + 5}; 
@@ -247,13 +329,22 @@ void HttpPutNode::draw() {
 
   ImGui::PushItemWidth(200);
   ImGui::Text("URL:");
-  ImGui::InputText("##url", url, sizeof(url));
+  if (ImGui::InputText("##url", url, sizeof(url))) {
+    markModified();
+    updateRequestTemplate();
+  }
   
   ImGui::Text("Headers:");
-  ImGui::InputTextMultiline("##headers", headers, sizeof(headers), ImVec2(200, 40));
+  if (ImGui::InputTextMultiline("##headers", headers, sizeof(headers), ImVec2(200, 40))) {
+    markModified();
+    updateRequestTemplate();
+  }
   
   ImGui::Text("Body:");
-  ImGui::InputTextMultiline("##body", body, sizeof(body), ImVec2(200, 60));
+  if (ImGui::InputTextMultiline("##body", body, sizeof(body), ImVec2(200, 60))) {
+    markModified();
+    updateRequestTemplate();
+  }
   ImGui::PopItemWidth();
 
   ImNodes::BeginInputAttribute(id + 2);
@@ -303,10 +394,23 @@ void HttpPutNode::deserializeData(const std::string& data) {
     
     strncpy(body, body_str.c_str(), sizeof(body) - 1);
     body[sizeof(body) - 1] = '\0';
+    updateRequestTemplate();
 }
 
 // -------------------- HttpDeleteNode --------------------
-HttpDeleteNode::HttpDeleteNode(int nodeId) : Node(nodeId, "HTTP DELETE") {}
+HttpDeleteNode::HttpDeleteNode(int nodeId) : Node(nodeId, "HTTP DELETE") {
+  updateRequestTemplate();
+}
+
+void HttpDeleteNode::updateRequestTemplate() {
+  request_template = std::make_shared<const RequestTemplate>("DELETE", url, headers, "");
+}
+
+void HttpDeleteNode::resolveVariables() {
+  auto resolved = std::make_shared<RequestTemplate>(*request_template);
+  resolved->resolveVariables();
+  request_template = std::move(resolved);
+}
 
 std::vector<int> HttpDeleteNode::getAttributeIds() const { 
   return {id + 1, id + 2, id + 3, id + 4}; 
@@ -328,10 +432,16 @@ void HttpDeleteNode::draw() {
 
   ImGui::PushItemWidth(200);
   ImGui::Text("URL:");
-  ImGui::InputText("##url", url, sizeof(url));
+  if (ImGui::InputText("##url", url, sizeof(url))) {
+    markModified();
+    updateRequestTemplate();
+  }
   
   ImGui::Text("Headers:");
-  ImGui::InputTextMultiline("##headers", headers, sizeof(headers), ImVec2(200, 40));
+  if (ImGui::InputTextMultiline("##headers", headers, sizeof(headers), ImVec2(200, 40))) {
+    markModified();
+    updateRequestTemplate();
+  }
   ImGui::PopItemWidth();
 
   ImNodes::BeginOutputAttribute(id + 2);
@@ -368,10 +478,23 @@ void HttpDeleteNode::deserializeData(const std::string& data) {
         strncpy(headers, headers_str.c_str(), sizeof(headers) - 1);
         headers[sizeof(headers) - 1] = '\0';
     }
+    updateRequestTemplate();
 }
 
 // -------------------- JsonExtractNode --------------------
-JsonExtractNode::JsonExtractNode(int nodeId) : Node(nodeId, "JSON Extract") {}
+JsonExtractNode::JsonExtractNode(int nodeId) : Node(nodeId, "JSON Extract") {
+  compilePath();
+}
+
+void JsonExtractNode::compilePath() {
+  auto path = std::make_shared<JsonPath>();
+  if (path->compile(json_path, path_error)) {
+    compiled_path = std::move(path);
+    path_error.clear();
+  } else {
+    compiled_path.reset();
+  }
+}
 
 std::vector<int> JsonExtractNode::getAttributeIds() const { 
   return {id + 1, id + 2}; 
@@ -393,8 +516,15 @@ void JsonExtractNode::draw() {
 
   ImGui::PushItemWidth(200);
   ImGui::Text("Path (JSONPath):");
-  ImGui::InputText("##path", json_path, sizeof(json_path));
-  ImGui::TextDisabled("e.g., $.data.id or $.users[0].name");
+  if (ImGui::InputText("##path", json_path, sizeof(json_path))) {
+    markModified();
+    compilePath();
+  }
+  if (path_error.empty()) {
+    ImGui::TextDisabled("e.g., $.data.id or $.users[*].name");
+  } else {
+    ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", path_error.c_str());
+  }
   ImGui::PopItemWidth();
 
   ImNodes::BeginOutputAttribute(id + 2);
@@ -415,11 +545,16 @@ void JsonExtractNode::deserializeData(const std::string& data) {
     std::string path_str = unescape_string(data);
     strncpy(json_path, path_str.c_str(), sizeof(json_path) - 1);
     json_path[sizeof(json_path) - 1] = '\0';
+    compilePath();
 }
 
 // -------------------- SetVariableNode --------------------
 SetVariableNode::SetVariableNode(int nodeId) : Node(nodeId, "Set Variable") {}
 
+void SetVariableNode::resolveVariables() {
+  var_slot = VariableNames::instance().intern(var_name);
+}
+
 std::vector<int> SetVariableNode::getAttributeIds() const { 
   return {id + 1, id + 2}; 
 }
@@ -440,7 +575,7 @@ void SetVariableNode::draw() {
 
   ImGui::PushItemWidth(200);
   ImGui::Text("Variable Name:");
-  ImGui::InputText("##varname", var_name, sizeof(var_name));
+  if (ImGui::InputText("##varname", var_name, sizeof(var_name))) markModified();
   ImGui::PopItemWidth();
 
   ImNodes::BeginOutputAttribute(id + 2);
@@ -466,6 +601,10 @@ void SetVariableNode::deserializeData(const std::string& data) {
 // -------------------- GetVariableNode --------------------
 GetVariableNode::GetVariableNode(int nodeId) : Node(nodeId, "Get Variable") {}
 
+void GetVariableNode::resolveVariables() {
+  var_slot = VariableNames::instance().intern(var_name);
+}
+
 std::vector<int> GetVariableNode::getAttributeIds() const { 
   return {id + 1}; 
 }
@@ -482,7 +621,7 @@ void GetVariableNode::draw() {
 
   ImGui::PushItemWidth(200);
   ImGui::Text("Variable Name:");
-  ImGui::InputText("##varname", var_name, sizeof(var_name));
+  if (ImGui::InputText("##varname", var_name, sizeof(var_name))) markModified();
   ImGui::PopItemWidth();
 
   ImNodes::BeginOutputAttribute(id + 1);
@@ -506,7 +645,26 @@ void GetVariableNode::deserializeData(const std::string& data) {
 }
 
 // -------------------- IfConditionNode --------------------
-IfConditionNode::IfConditionNode(int nodeId) : Node(nodeId, "If Condition") {}
+IfConditionNode::IfConditionNode(int nodeId) : Node(nodeId, "If Condition") {
+  compileCondition();
+}
+
+void IfConditionNode::compileCondition() {
+  auto expression = std::make_shared<Expression>();
+  if (expression->compile(condition, condition_error)) {
+    compiled_condition = std::move(expression);
+    condition_error.clear();
+  } else {
+    compiled_condition.reset();
+  }
+}
+
+void IfConditionNode::resolveVariables() {
+  if (!compiled_condition) return;
+  auto resolved = std::make_shared<Expression>(*compiled_condition);
+  resolved->resolveVariables();
+  compiled_condition = std::move(resolved);
+}
 
 std::vector<int> IfConditionNode::getAttributeIds() const { 
   return {id + 1, id + 2, id + 3}; 
@@ -528,8 +686,15 @@ void IfConditionNode::draw() {
 
   ImGui::PushItemWidth(200);
   ImGui::Text("Condition:");
-  ImGui::InputText("##condition", condition, sizeof(condition));
-  ImGui::TextDisabled("e.g., status_code == 200");
+  if (ImGui::InputText("##condition", condition, sizeof(condition))) {
+    markModified();
+    compileCondition();
+  }
+  if (condition_error.empty()) {
+    ImGui::TextDisabled("e.g., status_code == 200");
+  } else {
+    ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", condition_error.c_str());
+  }
   ImGui::PopItemWidth();
 
   ImNodes::BeginOutputAttribute(id + 2);
@@ -554,6 +719,7 @@ void IfConditionNode::deserializeData(const std::string& data) {
     std::string cond_str = unescape_string(data);
     strncpy(condition, cond_str.c_str(), sizeof(condition) - 1);
     condition[sizeof(condition) - 1] = '\0';
+    compileCondition();
 }
 
 // -------------------- DelayNode --------------------
@@ -579,7 +745,7 @@ void DelayNode::draw() {
 
   ImGui::PushItemWidth(200);
   ImGui::Text("Delay (ms):");
-  ImGui::InputText("##delay", delay_ms, sizeof(delay_ms));
+  if (ImGui::InputText("##delay", delay_ms, sizeof(delay_ms))) markModified();
   ImGui::PopItemWidth();
 
   ImNodes::BeginOutputAttribute(id + 2);
@@ -603,7 +769,26 @@ void DelayNode::deserializeData(const std::string& data) {
 }
 
 // -------------------- AssertNode --------------------
-AssertNode::AssertNode(int nodeId) : Node(nodeId, "Assert") {}
+AssertNode::AssertNode(int nodeId) : Node(nodeId, "Assert") {
+  compileAssertion();
+}
+
+void AssertNode::compileAssertion() {
+  auto expression = std::make_shared<Expression>();
+  if (expression->compile(assertion, assertion_error)) {
+    compiled_assertion = std::move(expression);
+    assertion_error.clear();
+  } else {
+    compiled_assertion.reset();
+  }
+}
+
+void AssertNode::resolveVariables() {
+  if (!compiled_assertion) return;
+  auto resolved = std::make_shared<Expression>(*compiled_assertion);
+  resolved->resolveVariables();
+  compiled_assertion = std::move(resolved);
+}
 
 std::vector<int> AssertNode::getAttributeIds() const { 
   return {id + 1, id + 2, id + 3}; 
@@ -625,8 +810,15 @@ void AssertNode::draw() {
 
   ImGui::PushItemWidth(200);
   ImGui::Text("Assertion:");
-  ImGui::InputText("##assertion", assertion, sizeof(assertion));
-  ImGui::TextDisabled("e.g., status_code == 200");
+  if (ImGui::InputText("##assertion", assertion, sizeof(assertion))) {
+    markModified();
+    compileAssertion();
+  }
+  if (assertion_error.empty()) {
+    ImGui::TextDisabled("e.g., status_code == 200");
+  } else {
+    ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", assertion_error.c_str());
+  }
   ImGui::PopItemWidth();
 
   ImNodes::BeginOutputAttribute(id + 2);
@@ -651,6 +843,7 @@ void AssertNode::deserializeData(const std::string& data) {
     std::string assert_str = unescape_string(data);
     strncpy(assertion, assert_str.c_str(), sizeof(assertion) - 1);
     assertion[sizeof(assertion) - 1] = '\0';
+    compileAssertion();
 }
 
 // -------------------- LogNode --------------------
@@ -676,7 +869,7 @@ void LogNode::draw() {
 
   ImGui::PushItemWidth(200);
   ImGui::Text("Message:");
-  ImGui::InputText("##message", message, sizeof(message));
+  if (ImGui::InputText("##message", message, sizeof(message))) markModified();
   ImGui::PopItemWidth();
 
   ImNodes::BeginOutputAttribute(id + 2);
@@ -23,6 +23,7 @@ void Project::addOrchestrationWithId(int id, const std::string& name) {
 }
 
 void Project::removeOrchestration(int orchestration_id) {
+  removed_orchestrations.push_back(orchestration_id);
   orchestrations.erase(
       std::remove_if(orchestrations.begin(), orchestrations.end(),
         [orchestration_id](const std::unique_ptr<Orchestration>& o) {
@@ -41,6 +42,14 @@ Orchestration* Project::getOrchestration(int orchestration_id) {
   return nullptr;
 }
 
+void Project::markSaved() {
+  dirty = false;
+  removed_orchestrations.clear();
+  for (auto& orch : orchestrations) {
+    orch->dirty = false;
+  }
+}
+
 // -------------------- ProjectManager --------------------
 ProjectManager::ProjectManager() {}
 
@@ -58,6 +67,7 @@ void ProjectManager::addProjectWithId(int id, const std::string& name) {
 }
 
 void ProjectManager::removeProject(int project_id) {
+  removed_projects.push_back(project_id);
   projects.erase(
       std::remove_if(projects.begin(), projects.end(),
         [project_id](const std::unique_ptr<Project>& p) {
@@ -75,3 +85,10 @@ Project* ProjectManager::getProject(int project_id) {
   }
   return nullptr;
 }
+
+void ProjectManager::markSaved() {
+  removed_projects.clear();
+  for (auto& proj : projects) {
+    proj->markSaved();
+  }
+}
@@ -0,0 +1,137 @@
+#include "request_template.h"
+#include "executor.h"
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+bool isNameStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool isNameChar(char c) {
+    return isNameStart(c) || (c >= '0' && c <= '9');
+}
+
+// Text of a value; numbers and bools are formatted into digits
+std::string_view valueText(const VariableValue& value, char (&digits)[32]) {
+    if (const BodyBuffer* text = std::get_if<BodyBuffer>(&value)) return text->view();
+    if (const JsonText* json = std::get_if<JsonText>(&value)) return json->bytes.view();
+    if (const bool* boolean = std::get_if<bool>(&value)) return *boolean ? "true" : "false";
+
+    std::to_chars_result result{digits, std::errc()};
+    if (const int64_t* integer = std::get_if<int64_t>(&value)) {
+        result = std::to_chars(digits, digits + sizeof(digits), *integer);
+    } else if (const double* number = std::get_if<double>(&value)) {
+        result = std::to_chars(digits, digits + sizeof(digits), *number);
+    }
+    return std::string_view(digits, result.ptr - digits);
+}
+
+} // namespace
+
+TextTemplate::TextTemplate(std::string_view source) : text(source) {
+    size_t literal_start = 0;
+    size_t position = 0;
+    while ((position = text.find("{{", position)) != std::string::npos) {
+        // {{ name }}, spaces around the name allowed
+        size_t start = position + 2;
+        while (start < text.size() && text[start] == ' ') start++;
+        size_t end = start;
+        if (end < text.size() && isNameStart(text[end])) {
+            while (end < text.size() && isNameChar(text[end])) end++;
+        }
+        size_t close = end;
+        while (close < text.size() && text[close] == ' ') close++;
+        if (end == start || text.compare(close, 2, "}}") != 0) {
+            position++;
+            continue;
+        }
+
+        if (position > literal_start) {
+            segments.push_back({uint32_t(literal_start), uint32_t(position - literal_start), VariableNames::npos});
+            literal_length += position - literal_start;
+        }
+        std::string_view name(text.data() + start, end - start);
+        uint32_t index = 0;
+        while (index < names.size() && names[index] != name) index++;
+        if (index == names.size()) names.emplace_back(name);
+        segments.push_back({uint32_t(start), uint32_t(end - start), index});
+
+        position = close + 2;
+        literal_start = position;
+    }
+    if (literal_start < text.size()) {
+        segments.push_back({uint32_t(literal_start), uint32_t(text.size() - literal_start), VariableNames::npos});
+        literal_length += text.size() - literal_start;
+    }
+}
+
+void TextTemplate::resolveVariables() {
+    slots.clear();
+    for (const std::string& name : names) {
+        slots.push_back(VariableNames::instance().intern(name));
+    }
+}
+
+void TextTemplate::render(ExecutionContext& context, std::vector<VariableValue>& values, std::string& out) const {
+    if (names.empty()) {
+        out.assign(text);
+        return;
+    }
+
+    // Values are read once, so both passes see the same ones even if a
+    // parallel branch sets a variable meanwhile
+    values.clear();
+    size_t length = literal_length;
+    char digits[32];
+    for (const Segment& segment : segments) {
+        if (segment.variable == VariableNames::npos) continue;
+        uint32_t slot = slots.empty() ? VariableNames::instance().find(names[segment.variable]) : slots[segment.variable];
+        values.push_back(slot != VariableNames::npos ? context.getVariable(slot) : VariableValue());
+        length += valueText(values.back(), digits).size();
+    }
+
+    out.resize(length);
+    char* cursor = out.data();
+    size_t next_value = 0;
+    for (const Segment& segment : segments) {
+        std::string_view piece = segment.variable == VariableNames::npos
+            ? std::string_view(text.data() + segment.offset, segment.length)
+            : valueText(values[next_value++], digits);
+        memcpy(cursor, piece.data(), piece.size());
+        cursor += piece.size();
+    }
+}
+
+RequestTemplate::RequestTemplate(std::string request_method, std::string_view url, std::string_view headers,
+                                 std::string_view body)
+    : method(std::move(request_method)), url_template(url), headers_template(headers), body_template(body) {
+    if (!headers_template.hasVariables()) {
+        header_list = std::make_shared<const HeaderList>(headers_template.getText());
+    }
+}
+
+void RequestTemplate::resolveVariables() {
+    url_template.resolveVariables();
+    headers_template.resolveVariables();
+    body_template.resolveVariables();
+}
+
+void RequestTemplate::render(ExecutionContext& context, HttpRequest& request) const {
+    // Scratch for the variable values, kept per thread like the request
+    static thread_local std::vector<VariableValue> values;
+    request.method = method;
+    url_template.render(context, values, request.url);
+    body_template.render(context, values, request.body);
+    request.headers.clear();
+    if (header_list) {
+        request.header_list = header_list;
+    } else {
+        std::string headers;
+        headers_template.render(context, values, headers);
+        request.header_list = std::make_shared<const HeaderList>(headers);
+    }
+    // The last values may hold response bytes; do not keep them alive
+    values.clear();
+}
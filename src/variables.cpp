@@ -0,0 +1,43 @@
+#include "variables.h"
+#include <charconv>
+
+VariableNames& VariableNames::instance() {
+    static VariableNames global;
+    return global;
+}
+
+uint32_t VariableNames::intern(std::string_view name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = slots.find(std::string(name));
+    if (it != slots.end()) return it->second;
+    uint32_t slot = static_cast<uint32_t>(names.size());
+    names.emplace_back(name);
+    slots.emplace(names.back(), slot);
+    return slot;
+}
+
+uint32_t VariableNames::find(std::string_view name) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = slots.find(std::string(name));
+    return it != slots.end() ? it->second : npos;
+}
+
+std::string VariableNames::name(uint32_t slot) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return slot < names.size() ? names[slot] : std::string();
+}
+
+BodyBuffer variableText(const VariableValue& value) {
+    if (const BodyBuffer* text = std::get_if<BodyBuffer>(&value)) return *text;
+    if (const JsonText* json = std::get_if<JsonText>(&value)) return json->bytes;
+    if (const bool* boolean = std::get_if<bool>(&value)) return BodyBuffer(*boolean ? "true" : "false");
+
+    char digits[32];
+    std::to_chars_result result{digits, std::errc()};
+    if (const int64_t* integer = std::get_if<int64_t>(&value)) {
+        result = std::to_chars(digits, digits + sizeof(digits), *integer);
+    } else if (const double* number = std::get_if<double>(&value)) {
+        result = std::to_chars(digits, digits + sizeof(digits), *number);
+    }
+    return BodyBuffer(std::string(digits, result.ptr));
+}
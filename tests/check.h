@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdio>
+#include <string>
+
+// Minimal checks for the test programs: a failure is printed with its
+// location and counted, and main returns checkFailures() so that CTest sees
+// a nonzero exit status.
+inline int& checkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            checkFailures()++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        const std::string check_actual(actual); \
+        const std::string check_expected(expected); \
+        if (check_actual != check_expected) { \
+            printf("%s:%d: %s is \"%s\", expected \"%s\"\n", __FILE__, __LINE__, #actual, \
+                   check_actual.c_str(), check_expected.c_str()); \
+            checkFailures()++; \
+        } \
+    } while (0)
@@ -0,0 +1,184 @@
+#include "check.h"
+#include "executor.h"
+#include "expression.h"
+#include <string>
+
+// Table-driven checks of If/Assert conditions: each expression is compiled
+// and evaluated against a fixed response and set of variables, and its
+// result compared as text (see Expression::evaluateToString).
+
+namespace {
+
+struct Case {
+    const char* expression;
+    const char* expected;
+};
+
+const Case RESULTS[] = {
+    // Arithmetic: * / % before + -, left to right
+    {"1 + 2 * 3", "7"},
+    {"(1 + 2) * 3", "9"},
+    {"10 - 4 - 3", "3"},
+    {"8 / 2 / 2", "2"},
+    {"2 * 3 % 4", "2"},
+    {"7 % 4 + 1", "4"},
+    {"1 / 0", "null"},
+    {"-3 + 1", "-2"},
+    {"- $.total", "-10"},
+    {"-(2 * 3)", "-6"},
+
+    // Comparisons before equality, equality before && before ||
+    {"1 + 2 < 4", "true"},
+    {"2 > 1 == 3 > 2", "true"},
+    {"1 < 2 == false", "false"},
+    {"1 == 1 && 2 == 3 || true", "true"},
+    {"true || false && false", "true"},
+    {"(true || false) && false", "false"},
+    {"false || true && false", "false"},
+    {"!false && false", "false"},
+    {"!(false && false)", "true"},
+    {"not 1 < 2", "false"},
+    {"1 <= 1 and 2 >= 3 or 4 != 4", "false"},
+    {"status_code >= 200 && status_code < 300 || status_code == 304", "true"},
+
+    // && and || short-circuit and always produce a bool
+    {"1 && 2", "true"},
+    {"1 && 2 && 0", "false"},
+    {"0 || ''", "false"},
+    {"0 || 'x'", "true"},
+    {"false && unset_var == null", "false"},
+    {"true || unset_var", "true"},
+
+    // Numeric strings compare and calculate as numbers; + concatenates
+    // two strings, or a non-numeric string and a value
+    {"user_id == 17", "true"},
+    {"user_id + 1", "18"},
+    {"'10' > '9'", "true"},
+    {"'b' > 'a'", "true"},
+    {"'1' + '2'", "12"},
+    {"'1' + 2", "3"},
+    {"'a' + 1", "a1"},
+    {"upper(name) + '!'", "ALICE!"},
+    {"str(12) + 'x'", "12x"},
+    {"num('4.5') * 2", "9"},
+
+    // Null and unset variables
+    {"unset_var", "null"},
+    {"unset_var == null", "true"},
+    {"!unset_var", "true"},
+    {"null == false", "false"},
+    {"$.missing", "null"},
+    {"$.missing == null", "true"},
+    {"exists($.none)", "false"},
+    {"exists($.ok)", "true"},
+    {"exists(unset_var)", "false"},
+
+    // Response built-ins, paths and functions
+    {"status_code == 200", "true"},
+    {"$.data.id == user_id", "true"},
+    {"$.data.name", "Bob \"B\""},
+    {"$.total - $.used >= 7", "true"},
+    {"count($.data.tags[*])", "3"},
+    {"count($.data.tags[?(@ != 'b')])", "2"},
+    {"$['data'].tags[1] == \"b\"", "true"},
+    {"contains(body, 'tags')", "true"},
+    {"starts_with(name, 'al') and ends_with(name, 'ce')", "true"},
+    {"len(name)", "5"},
+    {"lower('AbC')", "abc"},
+    {"response_time_ms", "0"},
+};
+
+const char* const ERRORS[] = {
+    "",
+    "(1",
+    "1)",
+    "((1 + 2)",
+    "1 +",
+    "* 2",
+    "status_code = 200",
+    "foo(1)",
+    "len(1, 2)",
+    "contains('a')",
+    "exists()",
+    "count(1)",
+    "'abc",
+    "$.a[1",
+    "$.a..b",
+    "and",
+    "true and",
+    "1 2",
+};
+
+std::string evaluate(ExecutionContext& context, const std::string& text) {
+    Expression expression;
+    std::string error;
+    if (!expression.compile(text, error)) return "error: " + error;
+    return expression.evaluateToString(context);
+}
+
+bool compiles(const std::string& text) {
+    Expression expression;
+    std::string error;
+    return expression.compile(text, error);
+}
+
+} // namespace
+
+int main() {
+    ExecutionContext context;
+    context.log_enabled = false;
+    context.last_status_code = 200;
+    context.last_response_body = BodyBuffer(std::string(
+        R"({"data":{"id":17,"name":"Bob \"B\"","tags":["a","b","c"]},"total":10,"used":3,"ok":true,"none":null})"));
+    context.setVariable("user_id", BodyBuffer(std::string("17")));
+    context.setVariable("name", BodyBuffer(std::string("alice")));
+
+    for (const Case& test : RESULTS) {
+        if (evaluate(context, test.expression) != test.expected) printf("expression %s:\n", test.expression);
+        CHECK_EQ(evaluate(context, test.expression), test.expected);
+    }
+
+    for (const char* text : ERRORS) {
+        if (compiles(text)) printf("expression %s compiled\n", text);
+        CHECK(!compiles(text));
+    }
+
+    // Resolved slots give the same results as lookups by name
+    for (const Case& test : RESULTS) {
+        Expression expression;
+        std::string error;
+        CHECK(expression.compile(test.expression, error));
+        expression.resolveVariables();
+        CHECK_EQ(expression.evaluateToString(context), test.expected);
+    }
+
+    // The right side of && runs only when the left one is truthy: the jump
+    // lands past it
+    Expression expression;
+    std::string error;
+    CHECK(expression.compile("a && b", error));
+    CHECK(expression.program().size() == 4);
+    CHECK(expression.program()[1].op == Expression::Op::And);
+    CHECK(expression.program()[1].operand == 4);
+    CHECK(expression.test(context) == false);
+
+    // A failed compile leaves the expression empty
+    CHECK(!expression.compile("foo(1)", error));
+    CHECK(error.find("unknown function") != std::string::npos);
+    CHECK(expression.program().empty());
+
+    // Each level of parentheses on the right of + keeps one more value on
+    // the stack: MAX_DEPTH values fit, one more does not
+    std::string nested = "1";
+    for (int i = 0; i < Expression::MAX_DEPTH - 1; i++) nested = "1 + (" + nested + ")";
+    CHECK(compiles(nested));
+    CHECK_EQ(evaluate(context, nested), std::to_string(Expression::MAX_DEPTH));
+    CHECK(!compiles("1 + (" + nested + ")"));
+
+    // Nesting that does not deepen the stack is still bounded
+    CHECK(compiles(std::string(100, '(') + "1" + std::string(100, ')')));
+    CHECK(!compiles(std::string(100000, '(') + "1" + std::string(100000, ')')));
+    CHECK(!compiles(std::string(100000, '!') + "1"));
+
+    return checkFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+#include "check.h"
+#include "json_path.h"
+#include "json_scanner.h"
+#include <string>
+#include <vector>
+
+// Table-driven checks of JsonPath compilation and matching
+
+namespace {
+
+const std::string DOCUMENT = R"({
+  "users": [
+    {"name": "ann", "age": 31, "tags": ["a", "b"]},
+    {"name": "bob", "age": 17},
+    {"name": "cy", "age": 18, "admin": true},
+    {"name": "dee", "age": 40, "admin": false}
+  ],
+  "items": [0, 1, 2, 3, 4, 5, 6, 7, 8, 9],
+  "odd key": {"x": 1, "y\"z": "q\"uote"},
+  "nested": {"a": {"b": {"c": "deep"}}},
+  "empty": [],
+  "none": null
+})";
+
+// Raw values the path selects, comma separated, or the compile error
+std::string select(const std::string& json, const std::string& text) {
+    JsonPath path;
+    std::string error;
+    if (!path.compile(text, error)) return "error: " + error;
+
+    std::vector<JsonValue> values;
+    if (!extractJsonAll(json, path, values)) return "malformed";
+    std::string result;
+    for (const JsonValue& value : values) {
+        if (!result.empty()) result += ",";
+        result += std::string(value.raw);
+    }
+    return result;
+}
+
+bool compiles(const std::string& text) {
+    JsonPath path;
+    std::string error;
+    return path.compile(text, error);
+}
+
+struct Case {
+    const char* path;
+    const char* expected;
+};
+
+const Case MATCHES[] = {
+    // Keys and indices
+    {"$.items[0]", "0"},
+    {"$.items[9]", "9"},
+    {"$.items[10]", ""},
+    {"$.users[1].name", "\"bob\""},
+    {"users[1].name", "\"bob\""},
+    {"$['odd key'].x", "1"},
+    {"$[\"odd key\"]['x']", "1"},
+    {"$['odd key']['y\\\"z']", "\"q\\\"uote\""},
+    {"$.nested.a.b.c", "\"deep\""},
+    {"$.missing.key", ""},
+    {"$.none", "null"},
+
+    // Wildcards
+    {"$.users[*].name", "\"ann\",\"bob\",\"cy\",\"dee\""},
+    {"$.users.*.age", "31,17,18,40"},
+    {"$.nested.*", "{\"b\": {\"c\": \"deep\"}}"},
+    {"$.empty[*]", ""},
+    {"$.users[*].tags[*]", "\"a\",\"b\""},
+
+    // Slices: start, end and step, each optional; end past the array is fine
+    {"$.items[2:5]", "2,3,4"},
+    {"$.items[:3]", "0,1,2"},
+    {"$.items[7:]", "7,8,9"},
+    {"$.items[1:8:3]", "1,4,7"},
+    {"$.items[::4]", "0,4,8"},
+    {"$.items[8:100]", "8,9"},
+    {"$.items[0:10:20]", "0"},
+    {"$.items[5:5]", ""},
+    {"$.items[6:2]", ""},
+    {"$.users[1:3].name", "\"bob\",\"cy\""},
+
+    // Filters: comparisons, && before ||, !, parentheses, literal first
+    {"$.users[?(@.age >= 18)].name", "\"ann\",\"cy\",\"dee\""},
+    {"$.users[?(@.age < 18 || @.name == 'dee')].name", "\"bob\",\"dee\""},
+    {"$.users[?(@.age > 30 || @.age < 18 && @.name == 'x')].name", "\"ann\",\"dee\""},
+    {"$.users[?((@.age > 30 || @.age < 18) && @.name == 'bob')].name", "\"bob\""},
+    {"$.users[?(!(@.age >= 18))].name", "\"bob\""},
+    {"$.users[?(18 <= @.age)].name", "\"ann\",\"cy\",\"dee\""},
+    {"$.users[?(@.name != \"ann\" && @.age != 40)].name", "\"bob\",\"cy\""},
+    {"$.users[?(@.admin == true)].name", "\"cy\""},
+    {"$.users[?(@.tags[1] == 'b')].name", "\"ann\""},
+    {"$.items[?(@ > 6)]", "7,8,9"},
+    {"$.items[?@ == 3]", "3"},
+
+    // A bare @ path tests for existence, whatever the value
+    {"$.users[?(@.admin)].name", "\"cy\",\"dee\""},
+    {"$.users[?(!@.admin)].name", "\"ann\",\"bob\""},
+    {"$.users[?(@.tags)].name", "\"ann\""},
+    {"$.users[?(@.tags[1])].name", "\"ann\""},
+    {"$.users[?(@.tags[2])].name", ""},
+};
+
+const char* const ERRORS[] = {
+    "",
+    "$..name",
+    "$.users..name",
+    "$.items[-1]",
+    "$.items[-2:]",
+    "$.items[1:-1]",
+    "$.items[::0]",
+    "$.items[1",
+    "$.items[a]",
+    "$['unterminated",
+    "$.users[?(@.*)]",
+    "$.users[?(@.* == 1)]",
+    "$.users[?(@[*])]",
+    "$.users[?(@[1:2])]",
+    "$.users[?(@..name)]",
+    "$.users[?(@.age > )]",
+    "$.users[?(1 == 2)]",
+    "$.users[?(@.a == @.b)]",
+    "$.users[?('x')]",
+    "$.users[?(@.a && )]",
+    "$.users[?((@.a)]",
+};
+
+} // namespace
+
+int main() {
+    for (const Case& test : MATCHES) {
+        if (select(DOCUMENT, test.path) != test.expected) printf("path %s:\n", test.path);
+        CHECK_EQ(select(DOCUMENT, test.path), test.expected);
+    }
+
+    for (const char* text : ERRORS) {
+        if (compiles(text)) printf("path %s compiled\n", text);
+        CHECK(!compiles(text));
+    }
+
+    // A failed compile leaves the path empty, with its text kept
+    JsonPath path;
+    std::string error;
+    CHECK(!path.compile("$.items[-1]", error));
+    CHECK(error.find("negative") != std::string::npos);
+    CHECK(path.getSteps().empty());
+    CHECK_EQ(path.getText(), "$.items[-1]");
+
+    CHECK(path.compile("$.nested.a['b']", error) && path.isSingular() && !path.hasFilters());
+    CHECK(path.compile("$.items[0:2]", error) && !path.isSingular());
+    CHECK(path.compile("$.users[?(@.age)]", error) && !path.isSingular() && path.hasFilters());
+
+    // Each level of parentheses on the right of || keeps one more value on
+    // the filter's stack
+    std::string nested = "@.a";
+    for (int i = 0; i < JsonPath::MAX_FILTER_DEPTH - 1; i++) nested = "@.a || (" + nested + ")";
+    CHECK(compiles("$[?(" + nested + ")]"));
+    nested = "@.a || (" + nested + ")";
+    CHECK(!compiles("$[?(" + nested + ")]"));
+
+    return checkFailures() == 0 ? 0 : 1;
+}
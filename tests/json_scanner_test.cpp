@@ -0,0 +1,234 @@
+#include "check.h"
+#include "json_path.h"
+#include "json_scanner.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Runs the same lookups under every block classifier this build and CPU
+// have, and checks that they agree with each other and, where the answer
+// is known, with it. Documents are shifted byte by byte so that strings,
+// escapes and brackets land on every position of a 64-byte block.
+
+namespace {
+
+const char* const KERNELS[] = {"scalar", "sse2", "avx2"};
+
+// Small deterministic generator, so failures reproduce
+struct Random {
+    uint64_t state;
+    explicit Random(uint64_t seed) : state(seed) {}
+    uint64_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+    int below(int bound) { return static_cast<int>(next() % static_cast<uint64_t>(bound)); }
+};
+
+std::string describe(bool found, const std::vector<JsonValue>& values) {
+    std::string result = found ? "ok" : "fail";
+    for (const JsonValue& value : values) {
+        result += "|" + std::to_string(static_cast<int>(value.type)) + ":" + std::string(value.raw);
+    }
+    return result;
+}
+
+// Every value path selects, directly and through an index
+std::string lookup(const std::string& json, const std::string& path_text) {
+    JsonPath path;
+    std::string error;
+    if (!path.compile(path_text, error)) return "bad path: " + error;
+
+    std::vector<JsonValue> values;
+    bool found = extractJsonAll(json, path, values);
+    std::string result = describe(found, values);
+
+    JsonIndex index(json);
+    values.clear();
+    found = extractJsonAll(index, path, values);
+    std::string indexed = describe(found, values);
+    if (indexed != result) result += " / indexed " + indexed;
+
+    JsonValue first;
+    if (extractJson(json, path, first)) result += " / first " + std::string(first.raw);
+    return result;
+}
+
+std::string randomString(Random& random) {
+    static const char* const PIECES[] = {"a", "b", " ", "{", "}", "[", "]", ":", ",", "\\\"", "\\\\", "\\n",
+                                         "\\u00e9", "x\\\\\\\"y", "\\\\\\\\"};
+    std::string text = "\"";
+    int length = random.below(8) == 0 ? 40 + random.below(150) : random.below(12);
+    for (int i = 0; i < length; i++) {
+        text += PIECES[random.below(sizeof(PIECES) / sizeof(PIECES[0]))];
+    }
+    return text + "\"";
+}
+
+std::string randomValue(Random& random, int depth) {
+    int kind = random.below(depth > 3 ? 4 : 7);
+    switch (kind) {
+        case 0: return std::to_string(random.below(100000) - 500);
+        case 1: return randomString(random);
+        case 2: return random.below(2) ? "true" : "null";
+        case 3: return "-1.5e3";
+        case 4:
+        case 5: {
+            std::string text = "{";
+            int count = random.below(5);
+            for (int i = 0; i < count; i++) {
+                if (i) text += ",";
+                text += std::string(random.below(3), ' ');
+                text += random.below(4) ? std::string("\"") + char('a' + random.below(3)) + "\"" : randomString(random);
+                text += ":" + std::string(random.below(2), ' ') + randomValue(random, depth + 1);
+            }
+            return text + "}";
+        }
+        default: {
+            std::string text = "[";
+            int count = random.below(6);
+            for (int i = 0; i < count; i++) {
+                if (i) text += random.below(3) ? "," : " , ";
+                text += randomValue(random, depth + 1);
+            }
+            return text + "]";
+        }
+    }
+}
+
+// Deletes, duplicates or replaces a few bytes
+std::string damage(Random& random, std::string json) {
+    static const char NOISE[] = "\"\\{}[]:, a1";
+    int edits = 1 + random.below(3);
+    for (int i = 0; i < edits && !json.empty(); i++) {
+        size_t at = static_cast<size_t>(random.below(static_cast<int>(json.size())));
+        switch (random.below(3)) {
+            case 0: json.erase(at, 1); break;
+            case 1: json.insert(at, 1, json[at]); break;
+            default: json[at] = NOISE[random.below(sizeof(NOISE) - 1)]; break;
+        }
+    }
+    return json;
+}
+
+// Known answers, checked under each kernel
+void checkBoundaries(const char* kernel) {
+    // A string holding escaped quotes and backslashes and structural
+    // characters, moved across every position of two blocks
+    const std::string content = R"(a\"b\\\"{[,:]}\\)";
+    const std::string unescaped = "a\"b\\\"{[,:]}\\";
+    int failures = checkFailures();
+    for (int shift = 0; shift < 140; shift++) {
+        std::string json = "[" + std::string(shift, ' ') + "\"" + content + "\",1,{\"k\":\"" + content + "\"}]";
+        std::vector<JsonValue> values;
+        JsonPath path;
+        std::string error;
+        CHECK(path.compile("$[*]", error));
+        CHECK(extractJsonAll(json, path, values));
+        CHECK(values.size() == 3);
+        if (values.size() == 3) {
+            CHECK_EQ(values[0].text(), unescaped);
+            CHECK_EQ(values[1].raw, "1");
+        }
+        CHECK_EQ(lookup(json, "$[2].k"), lookup(json, "$[2]['k']"));
+        JsonValue value;
+        CHECK(path.compile("$[2].k", error) && extractJson(json, path, value));
+        CHECK_EQ(value.text(), unescaped);
+        if (checkFailures() != failures) {
+            printf("  kernel %s, shift %d\n", kernel, shift);
+            return;
+        }
+    }
+
+    // A backslash as the last byte of a block escapes the first byte of the
+    // next one; an even run of backslashes there does not
+    for (int run = 1; run <= 4; run++) {
+        for (int shift = 50; shift < 70; shift++) {
+            std::string key(shift, 'x');
+            std::string json = "{\"" + key + std::string(run, '\\') + "\"\":1,\"after\":2}";
+            JsonPath path;
+            std::string error;
+            CHECK(path.compile("$.after", error));
+            JsonValue value;
+            // An odd run escapes the first quote, so the key ends at the
+            // second; an even run ends it at the first and leaves a stray quote
+            bool found = extractJson(json, path, value);
+            if (run % 2 == 1) {
+                CHECK(found && value.raw == "2");
+            } else {
+                CHECK(!found || value.raw != "2");
+            }
+        }
+    }
+
+    // Strings much longer than a block, with brackets inside
+    std::string long_string = "\"" + std::string(300, '{') + "\\\"" + std::string(300, ']') + "\"";
+    std::string json = "{\"s\":" + long_string + ",\"n\":[1,2,3]}";
+    CHECK_EQ(lookup(json, "$.n[2]"), "ok|3:3 / first 3");
+    CHECK_EQ(lookup(json, "$.s"), "ok|4:" + long_string + " / first " + long_string);
+
+    // Malformed along the path
+    const char* const MALFORMED[] = {
+        "{\"a\":\"unterminated",
+        "{\"a\":[1,2}",
+        "{\"a\":",
+        "[1,2,",
+        "{\"a\" 1}",
+        "\"\\\"",
+    };
+    for (const char* text : MALFORMED) {
+        for (int shift = 0; shift < 70; shift += 3) {
+            std::string padded = std::string(shift, ' ') + text;
+            CHECK(lookup(padded, "$.a[*]").compare(0, 4, "fail") == 0);
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    std::vector<const char*> kernels;
+    for (const char* name : KERNELS) {
+        if (setJsonScannerKernel(name)) kernels.push_back(name);
+    }
+    CHECK(kernels.size() >= 1);
+
+    const char* const PATHS[] = {"$", "$.a", "$.a.b", "$.b[0]", "$[*]", "$.*", "$.*.*", "$[1:6:2]",
+                                 "$.c[*].a", "$[?(@.a)]", "$[?(@ == 1)]"};
+
+    // Fuzzed documents, valid and damaged, shifted across block positions
+    std::vector<std::string> documents;
+    Random random(0x5eed);
+    for (int i = 0; i < 3000; i++) {
+        std::string json = std::string(random.below(70), ' ') + randomValue(random, 0);
+        if (random.below(4) == 0) json = damage(random, json);
+        documents.push_back(json);
+    }
+
+    std::vector<std::string> reference;
+    for (const char* kernel : kernels) {
+        CHECK(setJsonScannerKernel(kernel));
+        CHECK_EQ(jsonScannerKernel(), kernel);
+        checkBoundaries(kernel);
+
+        size_t n = 0;
+        for (const std::string& json : documents) {
+            for (const char* path : PATHS) {
+                std::string result = lookup(json, path);
+                if (reference.size() <= n) {
+                    reference.push_back(result);
+                } else if (result != reference[n]) {
+                    printf("kernel %s disagrees with %s on %s over:\n%s\n  %s\n  %s\n", kernel, kernels[0], path,
+                           json.c_str(), result.c_str(), reference[n].c_str());
+                    checkFailures()++;
+                }
+                n++;
+            }
+        }
+        printf("%s: %zu lookups\n", kernel, n);
+    }
+
+    return checkFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#include "check.h"
+#include "json_path.h"
+#include "json_scanner.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Feeds documents to JsonStreamExtractor in pieces of several sizes and
+// checks that it selects exactly what extractJsonAll does on the whole
+// document.
+
+namespace {
+
+const std::string DOCUMENT = R"({
+  "users": [
+    {"name": "ann", "age": 31, "tags": ["a", "b"]},
+    {"name": "bob", "age": 17},
+    {"name": "cy", "age": 18, "admin": true},
+    {"name": "dee", "age": 40, "admin": false}
+  ],
+  "items": [0, 1, 2, 3, 4, 5, 6, 7, 8, 9],
+  "odd key": {"x": 1, "y\"z": "q\"uote"},
+  "nested": {"a": {"b": {"c": "deep"}}},
+  "empty": [],
+  "none": null
+})";
+
+// Paths the stream extractor evaluates at once; no filters
+const char* const STREAM_PATHS[] = {
+    "$.users[*].name", "$.items[1:8:3]", "$['odd key']", "$.nested.*", "$.users[2].admin",
+    "$.empty[*]", "$.none", "$.items", "$.missing",
+};
+
+void checkStream(const std::string& json) {
+    auto paths = std::make_shared<JsonPathSet>();
+    for (const char* text : STREAM_PATHS) {
+        auto path = std::make_shared<JsonPath>();
+        std::string error;
+        CHECK(path->compile(text, error));
+        paths->push_back(path);
+    }
+
+    for (size_t chunk : {size_t(1), size_t(3), size_t(7), size_t(64)}) {
+        JsonStreamExtractor extractor(paths);
+        for (size_t offset = 0; offset < json.size(); offset += chunk) {
+            CHECK(extractor.feed(std::string_view(json).substr(offset, chunk)));
+        }
+        std::shared_ptr<const JsonStreamResult> result = extractor.finish();
+        CHECK(result->valid);
+
+        for (const auto& path : *paths) {
+            std::vector<JsonValue> expected;
+            CHECK(extractJsonAll(json, *path, expected));
+            const std::vector<JsonValue>* streamed = result->find(path.get());
+            CHECK(streamed != nullptr);
+            if (!streamed) continue;
+
+            std::string want, got;
+            for (const JsonValue& value : expected) want += std::string(value.raw) + ";";
+            for (const JsonValue& value : *streamed) got += std::string(value.raw) + ";";
+            if (got != want) {
+                printf("chunks of %zu, %s:\n", chunk, path->getText().c_str());
+            }
+            CHECK_EQ(got, want);
+            for (size_t i = 0; i < expected.size() && i < streamed->size(); i++) {
+                CHECK(expected[i].type == (*streamed)[i].type);
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    checkStream(DOCUMENT);
+    // Escapes and brackets inside strings split across pieces
+    checkStream(R"({"users": [{"name": "a\\\"}]{[,"}, {"name": "\u00e9\\"}], "items": [[1, {"x": "]"}], 2],
+                   "odd key": "\"", "nested": {"k": [{}, []]}, "none": null, "empty": []})");
+
+    return checkFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+#include "check.h"
+#include "async_http_client.h"
+#include "executor.h"
+#include "request_template.h"
+#include <string>
+
+// Rendering {{variable}} templates, and reuse of the request they render
+// into: again on the same thread, and after a round trip through the
+// event-driven client
+
+int main() {
+    ExecutionContext context;
+    context.log_enabled = false;
+    context.setVariable("user_id", BodyBuffer(std::string("17")));
+    context.setVariable("count", int64_t(3));
+
+    RequestTemplate request_template("POST", "http://127.0.0.1:1/users/{{user_id}}/items?limit={{count}}",
+                                     "Content-Type: application/json",
+                                     R"({"user": "{{user_id}}", "missing": "{{unset}}", "kept": "{{ x"})");
+    HttpRequest request;
+    request_template.render(context, request);
+    CHECK_EQ(request.method, "POST");
+    CHECK_EQ(request.url, "http://127.0.0.1:1/users/17/items?limit=3");
+    CHECK_EQ(request.body, R"({"user": "17", "missing": "", "kept": "{{ x"})");
+    CHECK(request.header_list != nullptr);
+
+    // Rendering the same template again writes into the same storage
+    const char* url_data = request.url.data();
+    size_t url_capacity = request.url.capacity();
+    const char* body_data = request.body.data();
+    size_t body_capacity = request.body.capacity();
+    request_template.render(context, request);
+    CHECK(request.url.data() == url_data && request.url.capacity() == url_capacity);
+    CHECK(request.body.data() == body_data && request.body.capacity() == body_capacity);
+    CHECK_EQ(request.url, "http://127.0.0.1:1/users/17/items?limit=3");
+
+    // Resolved slots render the same
+    request_template.resolveVariables();
+    request_template.render(context, request);
+    CHECK(request.url.data() == url_data && request.url.capacity() == url_capacity);
+    CHECK_EQ(request.body, R"({"user": "17", "missing": "", "kept": "{{ x"})");
+
+    // A request handed to the event-driven client comes back through
+    // reuseRequest once its transfer is over, with the same storage. Port 1
+    // refuses the connection, which still completes the transfer.
+    AsyncHttpClient client;
+    HttpRequest spare;
+    client.reuseRequest(spare);
+    CHECK(spare.url.empty() && spare.url.capacity() == HttpRequest().url.capacity());
+
+    HttpResponse response = client.submit(std::move(request)).get();
+    CHECK(!response.success);
+    client.reuseRequest(request);
+    CHECK(request.url.data() == url_data && request.url.capacity() == url_capacity);
+    CHECK(request.body.data() == body_data && request.body.capacity() == body_capacity);
+    CHECK(request.header_list == nullptr);
+
+    request_template.render(context, request);
+    CHECK(request.url.data() == url_data && request.body.data() == body_data);
+
+    return checkFailures() == 0 ? 0 : 1;
+}